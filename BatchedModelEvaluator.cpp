@@ -0,0 +1,424 @@
+
+#include "BatchedModelEvaluator.h"
+#include "PreprocessFolding.h"
+#include <algorithm>
+#include <stdio.h>
+#include <math.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    BatchedModelEvaluator::BatchedModelEvaluator()
+    {
+    }
+
+    BatchedModelEvaluator::~BatchedModelEvaluator()
+    {
+    }
+
+
+    bool BatchedModelEvaluator::build(std::vector< whiteice::bayesian_nnetwork<> >& bnns,
+				      const std::vector< whiteice::dataset<> >& data,
+				      unsigned int numInputs, unsigned int numStates)
+    {
+      clear();
+
+      if(bnns.size() != data.size()) return false;
+      if(numInputs == 0 || numInputs > MAX_OUTPUTS || numStates == 0) return false;
+
+      E = numInputs;
+      S = numStates;
+      Y = numInputs; // models predict change of EEG values
+
+      models.resize(bnns.size());
+
+      std::vector< std::vector<float> > first(bnns.size());
+
+#pragma omp parallel for schedule(dynamic)
+      for(unsigned int i=0;i<bnns.size();i++){
+	if(extract(bnns[i], data[i], models[i], first[i]) == false){
+	  models[i] = model();
+	  first[i].clear();
+	}
+      }
+
+      // packs first layers of all models into a single matrix
+      unsigned long long total = 0;
+
+      for(unsigned int i=0;i<models.size();i++){
+	models[i].offset = total;
+	total += first[i].size();
+      }
+
+      layer0.resize(total);
+
+#pragma omp parallel for schedule(dynamic)
+      for(unsigned int i=0;i<models.size();i++){
+	if(first[i].size() > 0)
+	  std::copy(first[i].begin(), first[i].end(), layer0.begin() + models[i].offset);
+
+	std::vector<float>().swap(first[i]);
+      }
+
+      // checks batched results against bayesian_nnetwork::calculate()
+#pragma omp parallel for schedule(dynamic)
+      for(unsigned int i=0;i<models.size();i++){
+	if(models[i].batched)
+	  models[i].batched = verify(i, bnns[i], data[i]);
+      }
+
+      numBatched = 0;
+      for(const auto& md : models)
+	if(md.batched) numBatched++;
+
+      {
+	char buffer[128];
+	snprintf(buffer, 128, "BatchedModelEvaluator: %d/%d models batched",
+		 numBatched, (unsigned int)models.size());
+	logging.info(buffer);
+      }
+
+      return true;
+    }
+
+
+    void BatchedModelEvaluator::clear()
+    {
+      E = 0;
+      S = 0;
+      Y = 0;
+      numBatched = 0;
+      models.clear();
+      layer0.clear();
+    }
+
+
+    bool BatchedModelEvaluator::calculate(const std::vector<float>& eeg, unsigned int state,
+					  std::vector<float>& m, std::vector<float>& cov,
+					  std::vector<char>& valid,
+					  const std::vector<char>* skip) const
+    {
+      if(eeg.size() != E || state >= S) return false;
+
+      m.resize(models.size()*Y);
+      cov.resize(models.size()*Y*Y);
+      valid.resize(models.size());
+
+#pragma omp parallel
+      {
+	std::vector<float> buffer;
+
+#pragma omp for schedule(dynamic)
+	for(unsigned int i=0;i<models.size();i++){
+	  valid[i] = 0;
+
+	  if(models[i].batched == false) continue;
+	  if(skip != nullptr && i < skip->size() && (*skip)[i]) continue;
+
+	  if(calculate(models[i], &(eeg[0]), state, &(m[i*Y]), &(cov[i*Y*Y]), buffer))
+	    valid[i] = 1;
+	}
+      }
+
+      return true;
+    }
+
+
+    bool BatchedModelEvaluator::calculate(unsigned int index, const std::vector<float>& eeg,
+					  unsigned int state, float* m, float* cov) const
+    {
+      if(index >= models.size() || models[index].batched == false) return false;
+      if(eeg.size() != E || state >= S) return false;
+
+      std::vector<float> buffer;
+
+      return calculate(models[index], &(eeg[0]), state, m, cov, buffer);
+    }
+
+
+    bool BatchedModelEvaluator::extract(whiteice::bayesian_nnetwork<>& bnn,
+					const whiteice::dataset<>& data,
+					model& md, std::vector<float>& first) const
+    {
+      const unsigned int I = E + S;
+
+      md = model();
+      first.clear();
+
+      if(data.getNumberOfClusters() != 2) return false;
+      if(bnn.inputSize() != I || bnn.outputSize() != Y) return false;
+
+      whiteice::nnetwork<> nn;
+      std::vector< math::vertex<> > samples;
+
+      if(bnn.exportSamples(nn, samples) == false) return false;
+      if(samples.size() == 0) return false;
+
+      nn.getArchitecture(md.arch);
+
+      if(md.arch.size() < 2) return false;
+
+      const unsigned int L = md.arch.size() - 1; // number of layers
+
+      if(md.arch[0] != I || md.arch[L] != Y) return false;
+
+      md.rectifier.resize(L);
+      md.residual.resize(L);
+
+      for(unsigned int l=0;l<L;l++){
+	const auto nl = nn.getNonlinearity(l);
+
+	if(nl == whiteice::nnetwork<>::rectifier) md.rectifier[l] = 1;
+	else if(nl == whiteice::nnetwork<>::pureLinear) md.rectifier[l] = 0;
+	else return false; // not supported
+
+	md.residual[l] = (nn.getResidual() && l > 0 && md.arch[l] == md.arch[l+1]);
+      }
+
+      // input preprocessing x' = A*x + c and output inverse preprocessing y = B*y' + d
+      std::vector<float> A, c;
+
+      if(getPreprocessTransform(data, 0, false, A, c) == false || c.size() != I) return false;
+      if(getPreprocessTransform(data, 1, true, md.B, md.d) == false || md.d.size() != Y) return false;
+
+      md.samples = samples.size();
+      md.hidden = md.arch[1];
+
+      const unsigned int R = md.samples*md.hidden;
+
+      first.resize(R*(I+1));
+
+      md.sampleParams = 0;
+      for(unsigned int l=1;l<L;l++)
+	md.sampleParams += md.arch[l+1]*md.arch[l] + md.arch[l+1];
+
+      md.params.resize(md.samples*md.sampleParams);
+
+      math::matrix<> W;
+      math::vertex<> b;
+
+      for(unsigned int k=0;k<md.samples;k++){
+	if(nn.importdata(samples[k]) == false) return false;
+
+	if(nn.getWeights(W, 0) == false || nn.getBias(b, 0) == false) return false;
+	if(W.ysize() != md.hidden || W.xsize() != I || b.size() != md.hidden) return false;
+
+	// folds input preprocessing into the first layer: W*A and b + W*c
+	for(unsigned int r=0;r<md.hidden;r++){
+	  const unsigned int row = k*md.hidden + r;
+
+	  for(unsigned int j=0;j<I;j++){
+	    float s = 0.0f;
+	    for(unsigned int i=0;i<I;i++)
+	      s += W(r,i).c[0]*A[i*I + j];
+	    first[j*R + row] = s;
+	  }
+
+	  float s = b[r].c[0];
+	  for(unsigned int i=0;i<I;i++)
+	    s += W(r,i).c[0]*c[i];
+	  first[I*R + row] = s;
+	}
+
+	float* p = md.params.data() + k*md.sampleParams;
+
+	for(unsigned int l=1;l<L;l++){
+	  if(nn.getWeights(W, l) == false || nn.getBias(b, l) == false) return false;
+	  if(W.ysize() != md.arch[l+1] || W.xsize() != md.arch[l] || b.size() != md.arch[l+1])
+	    return false;
+
+	  for(unsigned int i=0;i<W.ysize();i++)
+	    for(unsigned int j=0;j<W.xsize();j++, p++)
+	      *p = W(i,j).c[0];
+
+	  for(unsigned int i=0;i<b.size();i++, p++)
+	    *p = b[i].c[0];
+	}
+      }
+
+      md.batched = true;
+
+      return true;
+    }
+
+
+    bool BatchedModelEvaluator::calculate(const model& md, const float* eeg, unsigned int state,
+					  float* m, float* cov, std::vector<float>& buffer) const
+    {
+      const unsigned int I = E + S;
+      const unsigned int R = md.samples*md.hidden;
+      const unsigned int L = md.arch.size() - 1;
+
+      unsigned int width = 0;
+      for(const auto& a : md.arch)
+	if(a > width) width = a;
+
+      if(buffer.size() < R + 2*width)
+	buffer.resize(R + 2*width);
+
+      // first layer: bias + one-hot state column + EEG columns (axpy)
+      float* h = &(buffer[0]);
+      const float* block = &(layer0[md.offset]);
+
+      {
+	const float* bias = block + I*R;
+	const float* scol = block + (E + state)*R;
+
+	for(unsigned int r=0;r<R;r++)
+	  h[r] = bias[r] + scol[r];
+
+	for(unsigned int j=0;j<E;j++){
+	  const float xj = eeg[j];
+	  const float* col = block + j*R;
+
+	  for(unsigned int r=0;r<R;r++)
+	    h[r] += xj*col[r];
+	}
+      }
+
+      double msum[MAX_OUTPUTS];
+      double csum[MAX_OUTPUTS*MAX_OUTPUTS];
+
+      for(unsigned int i=0;i<Y;i++) msum[i] = 0.0;
+      for(unsigned int i=0;i<Y*Y;i++) csum[i] = 0.0;
+
+      for(unsigned int k=0;k<md.samples;k++){
+	float* a = &(buffer[R]);
+	float* o = &(buffer[R + width]);
+
+	for(unsigned int i=0;i<md.hidden;i++){
+	  const float v = h[k*md.hidden + i];
+	  a[i] = (md.rectifier[0] && v < 0.0f) ? RECTIFIER_LEAK*v : v;
+	}
+
+	const float* p = md.params.data() + k*md.sampleParams;
+
+	for(unsigned int l=1;l<L;l++){
+	  const unsigned int in = md.arch[l];
+	  const unsigned int out = md.arch[l+1];
+	  const float* bias = p + out*in;
+
+	  for(unsigned int i=0;i<out;i++){
+	    const float* w = p + i*in;
+	    float s = bias[i];
+
+	    for(unsigned int j=0;j<in;j++)
+	      s += w[j]*a[j];
+
+	    if(md.rectifier[l] && s < 0.0f) s *= RECTIFIER_LEAK;
+	    if(md.residual[l]) s += a[i];
+
+	    o[i] = s;
+	  }
+
+	  p += out*in + out;
+	  std::swap(a, o);
+	}
+
+	for(unsigned int i=0;i<Y;i++){
+	  msum[i] += a[i];
+	  for(unsigned int j=0;j<=i;j++)
+	    csum[i*Y + j] += a[i]*a[j];
+	}
+      }
+
+      // mean and covariance of samples in model's output space
+      float mm[MAX_OUTPUTS];
+      float cc[MAX_OUTPUTS*MAX_OUTPUTS];
+
+      for(unsigned int i=0;i<Y;i++)
+	mm[i] = (float)(msum[i]/md.samples);
+
+      for(unsigned int i=0;i<Y;i++){
+	for(unsigned int j=0;j<=i;j++){
+	  const float v = (float)(csum[i*Y + j]/md.samples) - mm[i]*mm[j];
+	  cc[i*Y + j] = v;
+	  cc[j*Y + i] = v;
+	}
+      }
+
+      // output inverse preprocessing: m = B*mm + d, cov = B*cc*B^t
+      float bc[MAX_OUTPUTS*MAX_OUTPUTS];
+
+      for(unsigned int i=0;i<Y;i++){
+	float s = md.d[i];
+	for(unsigned int j=0;j<Y;j++)
+	  s += md.B[i*Y + j]*mm[j];
+	m[i] = s;
+
+	for(unsigned int j=0;j<Y;j++){
+	  float t = 0.0f;
+	  for(unsigned int k=0;k<Y;k++)
+	    t += md.B[i*Y + k]*cc[k*Y + j];
+	  bc[i*Y + j] = t;
+	}
+      }
+
+      for(unsigned int i=0;i<Y;i++){
+	for(unsigned int j=0;j<Y;j++){
+	  float s = 0.0f;
+	  for(unsigned int k=0;k<Y;k++)
+	    s += bc[i*Y + k]*md.B[j*Y + k];
+	  cov[i*Y + j] = s;
+	}
+      }
+
+      for(unsigned int i=0;i<Y;i++){
+	if(isnan(m[i]) || isinf(m[i])) return false;
+      }
+
+      return true;
+    }
+
+
+    bool BatchedModelEvaluator::verify(unsigned int index,
+				       whiteice::bayesian_nnetwork<>& bnn,
+				       const whiteice::dataset<>& data) const
+    {
+      const unsigned int I = E + S;
+
+      std::vector<float> eeg(E);
+      std::vector<float> buffer;
+      float m[MAX_OUTPUTS];
+      float cov[MAX_OUTPUTS*MAX_OUTPUTS];
+
+      for(unsigned int state=0;state<S;state+=(S > 1 ? S-1 : 1)){
+	math::vertex<> x(I);
+
+	for(unsigned int i=0;i<E;i++){
+	  eeg[i] = 0.25f + 0.5f*((float)i)/((float)E);
+	  x[i] = eeg[i];
+	}
+
+	for(unsigned int i=0;i<S;i++)
+	  x[E+i] = (i == state) ? 1.0f : 0.0f;
+
+	math::vertex<> mx;
+	math::matrix<> cx;
+
+	if(data.preprocess(0, x) == false) return false;
+	if(bnn.calculate(x, mx, cx, 1, 0) == false) return false;
+	if(data.invpreprocess(1, mx, cx) == false) return false;
+
+	if(calculate(models[index], &(eeg[0]), state, m, cov, buffer) == false)
+	  return false;
+
+	if(mx.size() != Y || cx.ysize() != Y || cx.xsize() != Y) return false;
+
+	for(unsigned int i=0;i<Y;i++){
+	  const float e = mx[i].c[0];
+	  if(fabsf(e - m[i]) > 1e-3f*(1.0f + fabsf(e))) return false;
+
+	  const float v = cx(i,i).c[0];
+	  if(fabsf(v - cov[i*Y + i]) > 1e-3f*(1.0f + fabsf(v))) return false;
+	}
+      }
+
+      return true;
+    }
+
+  };
+};
@@ -0,0 +1,109 @@
+/*
+ * BatchedModelEvaluator
+ *
+ * evaluates all per-stimulus bayesian_nnetwork models at once for the
+ * same input (EEG values + one-hot HMM state). first layer weights of all
+ * models and samples are packed into a single column-major matrix so that
+ * the HMM one-hot part of the input is a column gather. dataset<>
+ * preprocessing of inputs and outputs is folded into the packed weights.
+ *
+ * models which cannot be handled (unsupported non-linearity or results
+ * don't match bayesian_nnetwork::calculate()) are marked as not batched
+ * and must be computed using the original code path.
+ */
+
+#ifndef BatchedModelEvaluator_h
+#define BatchedModelEvaluator_h
+
+#include <dinrhiw.h>
+#include <vector>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class BatchedModelEvaluator
+    {
+    public:
+
+      static const unsigned int MAX_OUTPUTS = 16;
+
+      BatchedModelEvaluator();
+      ~BatchedModelEvaluator();
+
+      // packs models. data[i] is model i's training dataset (input/output preprocessing)
+      // numInputs is number of EEG signals and numStates number of HMM states
+      bool build(std::vector< whiteice::bayesian_nnetwork<> >& models,
+		 const std::vector< whiteice::dataset<> >& data,
+		 unsigned int numInputs, unsigned int numStates);
+
+      void clear();
+
+      unsigned int size() const { return models.size(); }
+
+      unsigned int getNumberOfBatched() const { return numBatched; }
+
+      bool isBatched(unsigned int index) const {
+	if(index >= models.size()) return false;
+	return models[index].batched;
+      }
+
+      // calculates output mean m[i*Y..] and covariance cov[i*Y*Y..] (row-major)
+      // of all models in the original output space (dataset<> invpreprocess()).
+      // valid[i] is false if model i was not batched or skip[i] is set
+      bool calculate(const std::vector<float>& eeg, unsigned int state,
+		     std::vector<float>& m, std::vector<float>& cov,
+		     std::vector<char>& valid,
+		     const std::vector<char>* skip = nullptr) const;
+
+      // calculates mean m[Y] and covariance cov[Y*Y] of a single batched model
+      bool calculate(unsigned int index, const std::vector<float>& eeg, unsigned int state,
+		     float* m, float* cov) const;
+
+    private:
+
+      struct model {
+	bool batched = false;
+	unsigned int samples = 0;
+	unsigned int hidden = 0;      // number of first layer neurons per sample
+	unsigned long long offset = 0; // start of model's first layer in layer0
+
+	std::vector<unsigned int> arch;  // layer sizes (arch[0] = inputs)
+	std::vector<char> rectifier;     // 1 = leaky rectifier, 0 = linear
+	std::vector<char> residual;      // adds layer input to output
+
+	unsigned int sampleParams = 0;
+	std::vector<float> params; // layers 1.. of each sample: W (row-major) and b
+
+	std::vector<float> B, d; // output invpreprocess: y = B*y' + d
+      };
+
+      bool extract(whiteice::bayesian_nnetwork<>& bnn,
+		   const whiteice::dataset<>& data,
+		   model& md, std::vector<float>& first) const;
+
+      bool calculate(const model& md, const float* eeg, unsigned int state,
+		     float* m, float* cov, std::vector<float>& buffer) const;
+
+      bool verify(unsigned int index,
+		  whiteice::bayesian_nnetwork<>& bnn,
+		  const whiteice::dataset<>& data) const;
+
+      unsigned int E = 0, S = 0, Y = 0; // EEG inputs, HMM states, outputs
+      unsigned int numBatched = 0;
+
+      std::vector<model> models;
+
+      // first layer of all models: per model column-major block of
+      // (samples*hidden) rows and E+S+1 columns (the last column is bias)
+      std::vector<float> layer0;
+
+      const float RECTIFIER_LEAK = 0.01f; // negative slope of nnetwork<>::rectifier
+
+    };
+
+  };
+};
+
+
+#endif
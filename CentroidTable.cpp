@@ -0,0 +1,224 @@
+
+#include "CentroidTable.h"
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CENTROID_AVX2_KERNEL
+#endif
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    // ccols has dimensions rows and extra bias row (0 for clusters, +inf for padding)
+
+    static unsigned int centroid_nearest_scalar(const float* ccols, unsigned int E,
+						unsigned int K, unsigned int stride,
+						const float* x, float& distance)
+    {
+      unsigned int best = 0;
+      float bestd = std::numeric_limits<float>::infinity();
+
+      for(unsigned int k=0;k<K;k++){
+	float d2 = 0.0f;
+
+	for(unsigned int i=0;i<E;i++){
+	  const float t = x[i] - ccols[i*stride + k];
+	  d2 += t*t;
+	}
+
+	if(d2 < bestd){
+	  bestd = d2;
+	  best = k;
+	}
+      }
+
+      distance = bestd;
+
+      return best;
+    }
+
+
+#ifdef CENTROID_AVX2_KERNEL
+
+    __attribute__((target("avx2,fma")))
+    static unsigned int centroid_nearest_avx2(const float* ccols, unsigned int E,
+					      unsigned int K, unsigned int stride,
+					      const float* x, float& distance)
+    {
+      const float* bias = ccols + E*stride;
+
+      __m256 bestd = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+      __m256i besti = _mm256_set1_epi32(-1);
+      __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+      const __m256i eight = _mm256_set1_epi32(8);
+
+      for(unsigned int k=0;k<stride;k+=8){
+	__m256 d2 = _mm256_loadu_ps(bias + k);
+
+	for(unsigned int i=0;i<E;i++){
+	  const __m256 t = _mm256_sub_ps(_mm256_set1_ps(x[i]), _mm256_loadu_ps(ccols + i*stride + k));
+	  d2 = _mm256_fmadd_ps(t, t, d2);
+	}
+
+	// keeps first (smallest index) cluster of each lane if distances are equal
+	const __m256 smaller = _mm256_cmp_ps(d2, bestd, _CMP_LT_OQ);
+
+	bestd = _mm256_blendv_ps(bestd, d2, smaller);
+	besti = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(besti),
+						     _mm256_castsi256_ps(index), smaller));
+	index = _mm256_add_epi32(index, eight);
+      }
+
+      float d[8];
+      int b[8];
+
+      _mm256_storeu_ps(d, bestd);
+      _mm256_storeu_si256((__m256i*)b, besti);
+
+      int best = -1;
+      float dbest = std::numeric_limits<float>::infinity();
+
+      for(unsigned int j=0;j<8;j++){
+	if(b[j] < 0) continue;
+
+	if(best < 0 || d[j] < dbest || (d[j] == dbest && b[j] < best)){
+	  best = b[j];
+	  dbest = d[j];
+	}
+      }
+
+      if(best < 0) // distances are not finite
+	return centroid_nearest_scalar(ccols, E, K, stride, x, distance);
+
+      distance = dbest;
+
+      return (unsigned int)best;
+    }
+
+#endif
+
+
+    CentroidTable::CentroidTable()
+    {
+    }
+
+
+    CentroidTable::~CentroidTable()
+    {
+    }
+
+
+    bool CentroidTable::build(const whiteice::KMeans<>& kmeans)
+    {
+      if(kmeans.size() == 0){
+	clear();
+	return false;
+      }
+
+      const unsigned int clusters = kmeans.size();
+      const unsigned int dim = kmeans[0].size();
+
+      std::vector<float> c(clusters*dim);
+
+      for(unsigned int k=0;k<clusters;k++){
+	if(kmeans[k].size() != dim){
+	  clear();
+	  return false;
+	}
+
+	for(unsigned int i=0;i<dim;i++)
+	  c[k*dim + i] = kmeans[k][i].c[0];
+      }
+
+      return build(c, clusters, dim);
+    }
+
+
+    bool CentroidTable::build(const std::vector<float>& centroids,
+			      unsigned int clusters, unsigned int dim)
+    {
+      clear();
+
+      if(clusters == 0 || dim == 0 || centroids.size() != clusters*dim)
+	return false;
+
+      K = clusters;
+      E = dim;
+      stride = ((K + 7)/8)*8;
+
+      ccols.resize((E+1)*stride, 0.0f);
+
+      for(unsigned int k=0;k<K;k++)
+	for(unsigned int i=0;i<E;i++)
+	  ccols[i*stride + k] = centroids[k*E + i];
+
+      for(unsigned int k=K;k<stride;k++)
+	ccols[E*stride + k] = std::numeric_limits<float>::infinity();
+
+      return true;
+    }
+
+
+    void CentroidTable::clear()
+    {
+      E = 0;
+      K = 0;
+      stride = 0;
+      ccols.clear();
+    }
+
+
+    unsigned int CentroidTable::nearest(const float* x, float* distance) const
+    {
+      if(K == 0){
+	if(distance) *distance = 0.0f;
+	return 0;
+      }
+
+      float d = 0.0f;
+      unsigned int k = 0;
+
+#ifdef CENTROID_AVX2_KERNEL
+      if(hasSIMD())
+	k = centroid_nearest_avx2(ccols.data(), E, K, stride, x, d);
+      else
+	k = centroid_nearest_scalar(ccols.data(), E, K, stride, x, d);
+#else
+      k = centroid_nearest_scalar(ccols.data(), E, K, stride, x, d);
+#endif
+
+      if(distance) *distance = d;
+
+      return k;
+    }
+
+
+    bool CentroidTable::assign(const float* X, unsigned int N, unsigned int xstride,
+			       unsigned int* indices, float* distances) const
+    {
+      if(K == 0 || xstride < E || indices == nullptr)
+	return false;
+
+      for(unsigned int n=0;n<N;n++)
+	indices[n] = nearest(X + n*xstride, distances ? (distances + n) : nullptr);
+
+      return true;
+    }
+
+
+    bool CentroidTable::hasSIMD()
+    {
+#ifdef CENTROID_AVX2_KERNEL
+      static const bool avx2 = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+      return avx2;
+#else
+      return false;
+#endif
+    }
+
+  };
+};
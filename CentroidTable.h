@@ -0,0 +1,64 @@
+/*
+ * CentroidTable
+ *
+ * packed float copy of K-Means cluster centers used to classify EEG
+ * measurements on the real-time path. centroids are stored dimension by
+ * dimension (padded to multiple of 8 clusters) so that nearest cluster search
+ * compares 8 clusters at a time using AVX2 kernel (if CPU supports it) or
+ * a scalar fallback. gives the same cluster as KMeans::getClusterIndex()
+ * (up to float rounding of nearly equal distances)
+ */
+
+#ifndef CentroidTable_h
+#define CentroidTable_h
+
+#include <dinrhiw/dinrhiw.h>
+#include <vector>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class CentroidTable
+    {
+    public:
+
+      CentroidTable();
+      ~CentroidTable();
+
+      // copies cluster centers from K-Means model
+      bool build(const whiteice::KMeans<>& kmeans);
+
+      // centroids[k*dimension + i] is i:th coordinate of k:th cluster
+      bool build(const std::vector<float>& centroids, unsigned int clusters, unsigned int dimension);
+
+      void clear();
+
+      unsigned int size() const { return K; }
+      unsigned int dimension() const { return E; }
+
+      // nearest cluster of x (dimension() floats), returns 0 if table is empty.
+      // squared distance to the cluster is written to distance if it is not null
+      unsigned int nearest(const float* x, float* distance = nullptr) const;
+
+      // classifies N samples, sample n is X[n*stride ... n*stride + dimension()-1].
+      // distances may be null
+      bool assign(const float* X, unsigned int N, unsigned int stride,
+		  unsigned int* indices, float* distances = nullptr) const;
+
+      // AVX2 kernel is used
+      static bool hasSIMD();
+
+    private:
+
+      unsigned int E = 0, K = 0;
+      unsigned int stride = 0;  // K padded to multiple of 8
+      std::vector<float> ccols; // ccols[i*stride + k]
+
+    };
+
+  };
+};
+
+
+#endif
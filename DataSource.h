@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <string>
+#include <chrono>
 
 class DataSource {
 public:
@@ -33,6 +34,28 @@ public:
   virtual bool getSignalNames(std::vector<std::string>& names) const = 0;
 
   virtual unsigned int getNumberOfSignals() const = 0;
+  
+  /**
+   * timestamped sample stream (steady_clock time of the measurement):
+   * appends every sample measured since cursor (number of the next sample
+   * to read) and moves cursor past them. returns false if data source
+   * doesn't support sample streams
+   */
+  virtual bool readSince(unsigned long long& cursor,
+			 std::vector<std::chrono::steady_clock::time_point>& times,
+			 std::vector< std::vector<float> >& samples) const { return false; }
+  
+  /**
+   * number of the next sample to be measured (cursor to read only new samples)
+   */
+  virtual unsigned long long getSampleCursor() const { return 0; }
+  
+  /**
+   * waits until sample number cursor has been measured, returns false
+   * after deadline or if data source doesn't support sample streams
+   */
+  virtual bool waitForSample(unsigned long long cursor,
+			     std::chrono::steady_clock::time_point deadline) const { return false; }
 };
 
 #endif /* DATASOURCE_H_ */
@@ -0,0 +1,258 @@
+
+#include "EEGRetention.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    static const char RETENTION_MAGIC[8] = { 'R','Z','R','E','T','N','T','1' };
+
+    const unsigned int EEGRetention::COMPACT_SLACK;
+
+
+    EEGRetention::EEGRetention()
+    {
+    }
+
+
+    bool EEGRetention::setPolicy(Policy policy_, unsigned int maxRows_, double halfLife_)
+    {
+      if(policy_ != KEEP_ALL && maxRows_ == 0) return false;
+      if(halfLife_ < 0.0) return false;
+
+      policy = policy_;
+      maxRows = maxRows_;
+      halfLife = halfLife_;
+
+      return true;
+    }
+
+
+    bool EEGRetention::parsePolicy(const std::string& name, Policy& policy)
+    {
+      if(name == "all") policy = KEEP_ALL;
+      else if(name == "max-rows") policy = MAX_ROWS;
+      else if(name == "reservoir") policy = DECAYED_RESERVOIR;
+      else if(name == "sessions") policy = SESSION_STRATIFIED;
+      else return false;
+
+      return true;
+    }
+
+
+    void EEGRetention::reset(unsigned int N)
+    {
+      const double now = (double)time(0);
+
+      rows.resize(N);
+
+      for(auto& r : rows){
+	r.time = now;
+	r.session = 0;
+	r.key = randomKey();
+      }
+
+      session = 0;
+    }
+
+
+    void EEGRetention::startSession()
+    {
+      session++;
+    }
+
+
+    void EEGRetention::add()
+    {
+      Row r;
+      r.time = (double)time(0);
+      r.session = session;
+      r.key = randomKey();
+
+      rows.push_back(r);
+    }
+
+
+    bool EEGRetention::needsCompaction() const
+    {
+      if(policy == KEEP_ALL) return false;
+
+      return (rows.size() > maxRows + maxRows/COMPACT_SLACK);
+    }
+
+
+    bool EEGRetention::select(std::vector<unsigned int>& keep)
+    {
+      keep.clear();
+
+      if(policy == KEEP_ALL || rows.size() <= maxRows) return false;
+
+      const unsigned int N = rows.size();
+
+      if(policy == MAX_ROWS){
+	for(unsigned int i=N-maxRows;i<N;i++)
+	  keep.push_back(i);
+      }
+      else if(policy == DECAYED_RESERVOIR){
+	// weighted sampling without replacement (Efraimidis-Spirakis):
+	// keeps rows with largest key^(1/weight), compared in log-log domain
+	double newest = rows[0].time;
+	for(const auto& r : rows) newest = std::max(newest, r.time);
+
+	std::vector<double> score(N);
+
+	for(unsigned int i=0;i<N;i++){
+	  const double logw = (halfLife > 0.0) ? log(2.0)*(rows[i].time - newest)/halfLife : 0.0;
+	  score[i] = logw - log(-log((double)rows[i].key));
+	}
+
+	std::vector<unsigned int> order(N);
+	for(unsigned int i=0;i<N;i++) order[i] = i;
+
+	std::nth_element(order.begin(), order.begin() + maxRows, order.end(),
+			 [&](unsigned int a, unsigned int b){ return score[a] > score[b]; });
+
+	keep.assign(order.begin(), order.begin() + maxRows);
+      }
+      else if(policy == SESSION_STRATIFIED){
+	std::map< unsigned int, std::vector<unsigned int> > sessions;
+
+	for(unsigned int i=0;i<N;i++)
+	  sessions[rows[i].session].push_back(i);
+
+	// small sessions first so that rows they don't need go to larger sessions
+	std::vector< std::vector<unsigned int>* > groups;
+	for(auto& s : sessions) groups.push_back(&s.second);
+
+	std::sort(groups.begin(), groups.end(),
+		  [](const std::vector<unsigned int>* a, const std::vector<unsigned int>* b)
+		  { return a->size() < b->size(); });
+
+	unsigned int remaining = maxRows;
+
+	for(unsigned int g=0;g<groups.size();g++){
+	  std::vector<unsigned int>& group = *groups[g];
+	  const unsigned int quota = remaining / (groups.size() - g);
+
+	  if(group.size() > quota){
+	    // uniform sample within session
+	    std::nth_element(group.begin(), group.begin() + quota, group.end(),
+			     [&](unsigned int a, unsigned int b){ return rows[a].key > rows[b].key; });
+	    group.resize(quota);
+	  }
+
+	  keep.insert(keep.end(), group.begin(), group.end());
+	  remaining -= group.size();
+	}
+      }
+
+      std::sort(keep.begin(), keep.end());
+
+      std::vector<Row> kept(keep.size());
+
+      for(unsigned int i=0;i<keep.size();i++)
+	kept[i] = rows[keep[i]];
+
+      rows.swap(kept);
+
+      return true;
+    }
+
+
+    bool EEGRetention::load(const std::string& filename)
+    {
+      FILE* handle = fopen(filename.c_str(), "rb");
+      if(handle == NULL) return false;
+
+      char magic[sizeof(RETENTION_MAGIC)];
+      unsigned int s = 0;
+      unsigned long long N = 0;
+
+      bool ok = (fread(magic, 1, sizeof(magic), handle) == sizeof(magic) &&
+		 memcmp(magic, RETENTION_MAGIC, sizeof(magic)) == 0 &&
+		 fread(&s, sizeof(s), 1, handle) == 1 &&
+		 fread(&N, sizeof(N), 1, handle) == 1);
+
+      std::vector<Row> r;
+
+      if(ok){
+	r.resize(N);
+
+	for(unsigned long long i=0;i<N && ok;i++){
+	  ok = (fread(&r[i].time, sizeof(r[i].time), 1, handle) == 1 &&
+		fread(&r[i].session, sizeof(r[i].session), 1, handle) == 1 &&
+		fread(&r[i].key, sizeof(r[i].key), 1, handle) == 1);
+	}
+      }
+
+      fclose(handle);
+
+      if(ok == false) return false;
+
+      rows.swap(r);
+      session = s;
+
+      return true;
+    }
+
+
+    bool EEGRetention::save(const std::string& filename) const
+    {
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* handle = fopen(tmpname.c_str(), "wb");
+      if(handle == NULL) return false;
+
+      const unsigned long long N = rows.size();
+
+      bool ok = (fwrite(RETENTION_MAGIC, 1, sizeof(RETENTION_MAGIC), handle) == sizeof(RETENTION_MAGIC) &&
+		 fwrite(&session, sizeof(session), 1, handle) == 1 &&
+		 fwrite(&N, sizeof(N), 1, handle) == 1);
+
+      for(unsigned int i=0;i<rows.size() && ok;i++){
+	ok = (fwrite(&rows[i].time, sizeof(rows[i].time), 1, handle) == 1 &&
+	      fwrite(&rows[i].session, sizeof(rows[i].session), 1, handle) == 1 &&
+	      fwrite(&rows[i].key, sizeof(rows[i].key), 1, handle) == 1);
+      }
+
+      if(fclose(handle) != 0) ok = false;
+
+      if(ok == false){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+#ifdef _WIN32
+      remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return true;
+    }
+
+
+    float EEGRetention::randomKey() const
+    {
+      float u = rng.uniform().c[0];
+
+      // key must be inside (0,1) for log(-log(key))
+      if(u <= 0.0f) u = 1e-7f;
+      if(u >= 1.0f) u = 1.0f - 1e-7f;
+
+      return u;
+    }
+
+  };
+};
@@ -0,0 +1,99 @@
+/*
+ * EEGRetention
+ *
+ * retention policy of the EEG stream dataset (used to train K-Means and
+ * HMM brain state models) so that it doesn't grow without limit. keeps
+ * time and session of each stream row and selects rows to keep when
+ * stream has grown past the row limit:
+ *
+ * KEEP_ALL            - nothing is removed
+ * MAX_ROWS            - keeps the latest rows
+ * DECAYED_RESERVOIR   - weighted reservoir sample, weight of a row halves
+ *                       every halfLife seconds (old rows are kept less likely)
+ * SESSION_STRATIFIED  - every measurement session gets equal share of rows
+ *                       (sessions with fewer rows keep all), uniform sample
+ *                       within session
+ *
+ * each row has a fixed random key so that repeated compactions keep the
+ * same sample. kept rows stay in their time order
+ */
+
+#ifndef EEGRetention_h
+#define EEGRetention_h
+
+#include <dinrhiw/dinrhiw.h>
+#include <string>
+#include <vector>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class EEGRetention
+    {
+    public:
+
+      enum Policy { KEEP_ALL = 0, MAX_ROWS = 1, DECAYED_RESERVOIR = 2, SESSION_STRATIFIED = 3 };
+
+      EEGRetention();
+
+      bool setPolicy(Policy policy, unsigned int maxRows, double halfLife);
+
+      Policy getPolicy() const { return policy; }
+      unsigned int getMaxRows() const { return maxRows; }
+      double getHalfLife() const { return halfLife; } // seconds
+
+      // parses policy name (all, max-rows, reservoir, sessions)
+      static bool parsePolicy(const std::string& name, Policy& policy);
+
+      // stream has rows of unknown origin (belong to session 0 and current time)
+      void reset(unsigned int rows);
+
+      // rows added after this belong to a new session
+      void startSession();
+
+      // row was appended to stream now
+      void add();
+
+      unsigned int size() const { return rows.size(); }
+
+      // stream has grown enough over the limit to be compacted
+      bool needsCompaction() const;
+
+      // selects rows to keep (ascending row indices) and forgets the others.
+      // returns false if no rows are removed
+      bool select(std::vector<unsigned int>& keep);
+
+      bool load(const std::string& filename);
+      bool save(const std::string& filename) const; // writes temporary file and renames it
+
+    private:
+
+      struct Row
+      {
+	double time;          // seconds since epoch
+	unsigned int session;
+	float key;            // uniform random value in (0,1)
+      };
+
+      Policy policy = KEEP_ALL;
+      unsigned int maxRows = 0;
+      double halfLife = 0.0;
+
+      std::vector<Row> rows;
+      unsigned int session = 0;
+
+      whiteice::RNG<> rng;
+
+      float randomKey() const;
+
+      // compacts only after stream has grown maxRows/COMPACT_SLACK rows over the limit
+      static const unsigned int COMPACT_SLACK = 10;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -0,0 +1,299 @@
+
+#include "HMMStateTracker.h"
+#include <chrono>
+#include <functional>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    const unsigned int HMMStateTracker::POLL_MS;
+    const unsigned int HMMStateTracker::WAIT_MS;
+    
+
+    HMMStateTracker::HMMStateTracker(const whiteice::KMeans<>& kmeans,
+				     const whiteice::HMM& hmm,
+				     DataSource* const& eeg_,
+				     std::mutex& eeg_mutex_,
+				     std::mutex& eeg_wait_mutex_,
+				     unsigned int initialState) :
+      eeg(eeg_), eeg_mutex(eeg_mutex_), eeg_wait_mutex(eeg_wait_mutex_)
+    {
+      sequence = 0;
+      publishedState = 0;
+      updates = 0;
+
+      for(unsigned int i=0;i<MAX_STATES;i++)
+	publishedPosterior[i] = 0.0f;
+
+      K = kmeans.size();
+      S = hmm.getNumHiddenStates();
+
+      if(K == 0 || S == 0 || S > MAX_STATES || hmm.getNumVisibleStates() != K)
+	return;
+
+      if(centroids.build(kmeans) == false) return;
+
+      E = centroids.dimension();
+
+      const auto& a = hmm.getA();
+      const auto& b = hmm.getB();
+      const auto& pi = hmm.getPI();
+
+      if(a.size() != S || b.size() != S || pi.size() != S) return;
+
+      A.resize(S*S);
+      B.resize(S*S*K);
+      alpha.resize(S);
+
+      for(unsigned int i=0;i<S;i++){
+	if(a[i].size() != S || b[i].size() != S) return;
+
+	for(unsigned int j=0;j<S;j++){
+	  A[i*S + j] = a[i][j].getDouble();
+
+	  if(b[i][j].size() != K) return;
+
+	  for(unsigned int k=0;k<K;k++)
+	    B[(i*S + j)*K + k] = b[i][j][k].getDouble();
+	}
+      }
+
+      // starts from the given state (or from initial distribution)
+      for(unsigned int i=0;i<S;i++){
+	if(initialState < S) alpha[i] = (i == initialState) ? 1.0 : 0.0;
+	else alpha[i] = pi[i].getDouble();
+      }
+
+      valid = true;
+
+      publish();
+    }
+
+
+    HMMStateTracker::~HMMStateTracker()
+    {
+      this->stop();
+    }
+
+
+    bool HMMStateTracker::start()
+    {
+      if(valid == false) return false;
+
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running){
+	return false; // thread is already running
+      }
+
+      try{
+	thread_running = true;
+	if(tracker_thread){ delete tracker_thread; tracker_thread = nullptr; }
+	tracker_thread = new std::thread(std::bind(&HMMStateTracker::tracker_loop, this));
+      }
+      catch(std::exception& e){
+	thread_running = false;
+	tracker_thread = nullptr;
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool HMMStateTracker::isRunning()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running && tracker_thread != nullptr)
+	return true;
+      else
+	return false;
+    }
+
+
+    bool HMMStateTracker::stop()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running == false)
+	return false;
+
+      thread_running = false;
+
+      if(tracker_thread){
+	tracker_thread->join();
+	delete tracker_thread;
+      }
+
+      tracker_thread = nullptr;
+
+      return true;
+    }
+
+
+    unsigned int HMMStateTracker::getState() const
+    {
+      return publishedState.load(std::memory_order_acquire);
+    }
+
+
+    bool HMMStateTracker::getPosterior(std::vector<float>& posterior, unsigned int& state) const
+    {
+      if(valid == false) return false;
+
+      posterior.resize(S);
+
+      while(true){
+	const unsigned int s1 = sequence.load(std::memory_order_acquire);
+
+	if(s1 & 1){ // writer is updating values
+	  std::this_thread::yield();
+	  continue;
+	}
+
+	for(unsigned int i=0;i<S;i++)
+	  posterior[i] = publishedPosterior[i].load(std::memory_order_relaxed);
+
+	state = publishedState.load(std::memory_order_relaxed);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if(sequence.load(std::memory_order_relaxed) == s1)
+	  return true;
+      }
+    }
+
+
+    void HMMStateTracker::publish()
+    {
+      unsigned int best = 0;
+
+      for(unsigned int i=1;i<S;i++)
+	if(alpha[i] > alpha[best]) best = i;
+
+      const unsigned int s = sequence.load(std::memory_order_relaxed);
+
+      sequence.store(s+1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      for(unsigned int i=0;i<S;i++)
+	publishedPosterior[i].store((float)alpha[i], std::memory_order_relaxed);
+
+      publishedState.store(best, std::memory_order_relaxed);
+
+      sequence.store(s+2, std::memory_order_release);
+    }
+
+
+    bool HMMStateTracker::update(const std::vector<float>& x)
+    {
+      if(x.size() != E) return false;
+
+      // nearest K-Means cluster is the visible state
+      const unsigned int obs = centroids.nearest(x.data());
+
+      // forward filtering: alpha'(j) ~ sum_i alpha(i) A(i,j) B(i,j,obs)
+      std::vector<double> next(S, 0.0);
+      double sum = 0.0;
+
+      for(unsigned int j=0;j<S;j++){
+	double p = 0.0;
+	for(unsigned int i=0;i<S;i++)
+	  p += alpha[i]*A[i*S + j]*B[(i*S + j)*K + obs];
+
+	next[j] = p;
+	sum += p;
+      }
+
+      if(sum <= 0.0 || sum != sum){
+	// observation is impossible in the model: only uses transitions
+	sum = 0.0;
+
+	for(unsigned int j=0;j<S;j++){
+	  double p = 0.0;
+	  for(unsigned int i=0;i<S;i++)
+	    p += alpha[i]*A[i*S + j];
+
+	  next[j] = p;
+	  sum += p;
+	}
+
+	if(sum <= 0.0) return false;
+      }
+
+      for(unsigned int j=0;j<S;j++)
+	alpha[j] = next[j]/sum;
+
+      updates++;
+
+      return true;
+    }
+
+
+    void HMMStateTracker::tracker_loop()
+    {
+      const DataSource* source = nullptr;
+      unsigned long long cursor = 0;
+
+      std::vector<std::chrono::steady_clock::time_point> times;
+      std::vector< std::vector<float> > samples;
+
+      while(thread_running){
+	bool stream = false;
+
+	times.clear();
+	samples.clear();
+
+	{
+	  std::lock_guard<std::mutex> lock(eeg_mutex);
+
+	  if(eeg != nullptr){
+	    if(eeg != source){ // device has changed
+	      source = eeg;
+	      cursor = eeg->getSampleCursor();
+	    }
+
+	    stream = eeg->readSince(cursor, times, samples);
+
+	    if(stream == false){
+	      std::vector<float> x;
+	      if(eeg->data(x)) samples.push_back(x);
+	    }
+	  }
+	  else source = nullptr;
+	}
+
+	if(stream && samples.size() == 0){
+	  // waits without eeg_mutex so that engine's ticks are not delayed,
+	  // eeg_wait_mutex keeps the device from being deleted meanwhile
+	  std::lock_guard<std::mutex> lock(eeg_wait_mutex);
+
+	  if(eeg == source){
+	    const auto deadline = std::chrono::steady_clock::now() +
+	      std::chrono::milliseconds(WAIT_MS);
+
+	    if(source->waitForSample(cursor, deadline))
+	      source->readSince(cursor, times, samples);
+	  }
+	}
+
+	bool changed = false;
+
+	for(const auto& x : samples)
+	  if(update(x)) changed = true;
+
+	if(changed) publish();
+
+	if(stream == false){
+	  // polls latest value at fixed rate
+	  std::this_thread::sleep_for(std::chrono::milliseconds(source ? POLL_MS : WAIT_MS));
+	}
+      }
+    }
+
+  };
+};
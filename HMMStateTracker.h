@@ -0,0 +1,105 @@
+/*
+ * HMMStateTracker
+ *
+ * tracks HMM brain state in its own thread. consumes every EEG sample from
+ * data source's sample stream (or polls latest value if the device has no
+ * stream), classifies it using K-Means and updates HMM forward filtering
+ * posterior p(state | measurements). the most probable state and posterior
+ * are published through a sequence lock so readers never block the tracker.
+ * models are copied when the tracker is created
+ */
+
+#ifndef HMMStateTracker_h
+#define HMMStateTracker_h
+
+#include <dinrhiw/dinrhiw.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+#include "DataSource.h"
+#include "CentroidTable.h"
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class HMMStateTracker
+    {
+    public:
+
+      static const unsigned int MAX_STATES = 64;
+
+      // eeg is pointer to engine's current device and is accessed holding eeg_mutex.
+      // device is also kept alive holding eeg_wait_mutex (waiting for samples
+      // without eeg_mutex), the engine holds both when changing the device
+      HMMStateTracker(const whiteice::KMeans<>& kmeans,
+		      const whiteice::HMM& hmm,
+		      DataSource* const& eeg,
+		      std::mutex& eeg_mutex,
+		      std::mutex& eeg_wait_mutex,
+		      unsigned int initialState);
+
+      ~HMMStateTracker();
+
+      // models were valid and copied successfully
+      bool isValid() const { return valid; }
+
+      bool start();
+
+      bool isRunning();
+
+      bool stop();
+
+      // most probable current HMM state
+      unsigned int getState() const;
+
+      // posterior probabilities of HMM states and the most probable state
+      bool getPosterior(std::vector<float>& posterior, unsigned int& state) const;
+
+      // number of processed EEG samples
+      unsigned long long getUpdates() const { return updates; }
+
+    private:
+
+      void tracker_loop();
+
+      // forward filtering step with a new EEG sample
+      bool update(const std::vector<float>& x);
+
+      void publish();
+
+      static const unsigned int POLL_MS = 200; // polling interval of devices without sample stream
+      static const unsigned int WAIT_MS = 20;  // maximum time waiting for a sample
+
+      std::mutex thread_mutex;
+      std::atomic<bool> thread_running { false };
+      std::thread* tracker_thread = nullptr;
+
+      DataSource* const& eeg;
+      std::mutex& eeg_mutex;
+      std::mutex& eeg_wait_mutex;
+
+      bool valid = false;
+
+      unsigned int E = 0, K = 0, S = 0; // EEG dimensions, clusters, states
+      CentroidTable centroids;
+      std::vector<double> A;            // A[i*S + j] = p(j | i)
+      std::vector<double> B;            // B[(i*S + j)*K + k] = p(k | i -> j)
+      std::vector<double> alpha;        // posterior (tracker thread only)
+
+      // sequence lock: odd while writing
+      std::atomic<unsigned int> sequence;
+      std::atomic<unsigned int> publishedState;
+      std::atomic<float> publishedPosterior[MAX_STATES];
+
+      std::atomic<unsigned long long> updates;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -87,95 +87,110 @@ namespace whiteice
       return true;
     }
 
-    void HMMStateUpdatorThread::updator_loop()
+    bool HMMStateUpdatorThread::classify(const whiteice::dataset<>& data,
+					 const CentroidTable& centroids,
+					 std::vector<unsigned int>& clusters) const
     {
+      // K-Means clusters of EEG part of all rows as a single batch
+      const unsigned int N = data.size(0);
+      const unsigned int E = centroids.dimension();
 
-      // pictureData
-      for(unsigned int p=0;p<pictureData->size();p++, processingPicIndex++)
-      {
-	auto& pic = (*pictureData)[p];
+      std::vector<float> X(N*E);
+      clusters.resize(N);
+
+      for(unsigned int i=0;i<N;i++){
+	const auto& v = data.access(0, i);
+	if(v.size() < E) return false;
 	
-	std::vector< whiteice::dataset<>::data_normalization > norms;
+	for(unsigned int j=0;j<E;j++)
+	  X[i*E + j] = v[j].c[0];
+      }
 
-	pic.getPreprocessings(0, norms);
-	pic.convert(0);
+      return centroids.assign(X.data(), N, E, clusters.data());
+    }
+    
 
-	unsigned int HMMstate = hmm->sample(hmm->getPI());
-	
-	for(unsigned int i=0;i<pic.size(0);i++){
-	  auto v = pic.access(0, i);
+    bool HMMStateUpdatorThread::relabel(whiteice::dataset<>& data,
+					const CentroidTable& centroids,
+					whiteice::HMM& model,
+					std::vector<unsigned int>& clusters) const
+    {
+      std::vector< whiteice::dataset<>::data_normalization > norms;
 
-	  whiteice::math::vertex<> eeg;
-	  eeg.resize(v.size() - hmm->getNumHiddenStates());
+      data.getPreprocessings(0, norms);
+      data.convert(0);
 
-	  for(unsigned int j=0;j<eeg.size();j++){
-	    eeg[j] = v[j];
-	  }
+      // EEG dimensions don't match K-Means model: keeps old states
+      const bool classified = classify(data, centroids, clusters);
 
-	  unsigned int kcluster = kmeans->getClusterIndex(eeg);
+      if(classified){
+	const unsigned int E = centroids.dimension();
+	unsigned int HMMstate = model.sample(model.getPI());
+	
+	for(unsigned int i=0;i<data.size(0);i++){
 	  unsigned int nextState = 0;
-	  hmm->next_state(HMMstate, nextState, kcluster);
+	  model.next_state(HMMstate, nextState, clusters[i]);
 	  HMMstate = nextState;
 
-	  for(unsigned int j=eeg.size();j<v.size();j++){
-	    unsigned int index = j-eeg.size();
+	  // only rewrites one-hot HMM state columns of the row
+	  auto& v = data.access(0, i);
 
-	    if(index == HMMstate) v[j] = 1.0f;
+	  for(unsigned int j=E;j<v.size();j++){
+	    if(j-E == HMMstate) v[j] = 1.0f;
 	    else v[j] = 0.0f;
 	  }
-
-	  pic.access(0, i) = v;
 	}
-
-	for(const auto& p : norms)
-	  pic.preprocess(0, p);
-
-	pic.preprocess(0); // always do mean-variance normalization
       }
 
-      // keywordData
-      for(unsigned int p=0;p<keywordData->size();p++, processingKeyIndex++)
-      {
-	auto& key = (*keywordData)[p];
+      // statistics are recomputed once per preprocessing
+      bool meanvariance = false;
 
-	std::vector< whiteice::dataset<>::data_normalization > norms;
-	
-	key.getPreprocessings(0, norms);
-	key.convert(0);
+      for(const auto& p : norms){
+	data.preprocess(0, p);
+	if(p == whiteice::dataset<>::dnMeanVarianceNormalization) meanvariance = true;
+      }
 
-	unsigned int HMMstate = hmm->sample(hmm->getPI());
-	
-	for(unsigned int i=0;i<key.size(0);i++){
-	  auto v = key.access(0, i);
+      if(meanvariance == false)
+	data.preprocess(0); // always do mean-variance normalization
 
-	  whiteice::math::vertex<> eeg;
-	  eeg.resize(v.size() - hmm->getNumHiddenStates());
+      return classified;
+    }
+    
 
-	  for(unsigned int j=0;j<eeg.size();j++){
-	    eeg[j] = v[j];
-	  }
+    void HMMStateUpdatorThread::updator_loop()
+    {
+      CentroidTable centroids;
 
-	  unsigned int kcluster = kmeans->getClusterIndex(eeg);
-	  unsigned int nextState = 0;
-	  hmm->next_state(HMMstate, nextState, kcluster);
-	  HMMstate = nextState;
+      if(centroids.build(*kmeans) == false){
+	thread_running = false;
+	return;
+      }
 
-	  for(unsigned int j=eeg.size();j<v.size();j++){
-	    unsigned int index = j-eeg.size();
+      // datasets are independent so they are relabelled in parallel
+      const int P = (int)pictureData->size();
+      const int N = P + (int)keywordData->size();
 
-	    if(index == HMMstate) v[j] = 1.0f;
-	    else v[j] = 0.0f;
+#pragma omp parallel
+      {
+	// each thread samples states from its own copy of the model
+	whiteice::HMM model(*hmm);
+
+#pragma omp for schedule(dynamic)
+	for(int p=0;p<N;p++){
+	  if(thread_running == false) continue; // stop() was called
+
+	  std::vector<unsigned int> clusters;
+	  
+	  if(p < P){
+	    relabel((*pictureData)[p], centroids, model, clusters);
+	    processingPicIndex++;
+	  }
+	  else{
+	    relabel((*keywordData)[p-P], centroids, model, clusters);
+	    processingKeyIndex++;
 	  }
-
-	  key.access(0, i) = v;
 	}
-	
-	for(const auto& p : norms)
-	  key.preprocess(0, p);
-
-	key.preprocess(0); // always do mean-variance normalization
       }
-
       
       thread_running = false;
     }
@@ -1,7 +1,8 @@
 /*
  * HMMStateUpdatorThread
  *
- * reclassifies dataset<> classification field using K-Means and HMM model
+ * reclassifies dataset<> classification field using K-Means and HMM model.
+ * datasets are processed in parallel and only HMM state columns are rewritten
  */
 
 #ifndef HMMStateUpdator_h
@@ -10,6 +11,10 @@
 #include <dinrhiw/dinrhiw.h>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <vector>
+
+#include "CentroidTable.h"
 
 namespace whiteice {
   namespace resonanz {
@@ -38,9 +43,21 @@ namespace whiteice {
     private:
       
       void updator_loop();
+
+      // nearest K-Means cluster of each row of the dataset (cluster 0, converted)
+      bool classify(const whiteice::dataset<>& data,
+		    const CentroidTable& centroids,
+		    std::vector<unsigned int>& clusters) const;
+
+      // removes preprocessings, rewrites HMM states of rows and preprocesses again.
+      // model is the calling thread's own copy of hmm (HMM sampling uses its internal RNG)
+      bool relabel(whiteice::dataset<>& data,
+		   const CentroidTable& centroids,
+		   whiteice::HMM& model,
+		   std::vector<unsigned int>& clusters) const;
       
       std::mutex thread_mutex;
-      bool thread_running = false;
+      std::atomic<bool> thread_running { false };
       std::thread* updator_thread = nullptr;
       
       whiteice::KMeans<>* kmeans;
@@ -48,7 +65,7 @@ namespace whiteice {
       std::vector< whiteice::dataset<> >* pictureData;
       std::vector< whiteice::dataset<> >* keywordData;
 
-      unsigned int processingPicIndex = 0, processingKeyIndex = 0;
+      std::atomic<unsigned int> processingPicIndex { 0 }, processingKeyIndex { 0 };
       
     };
     
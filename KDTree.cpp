@@ -0,0 +1,271 @@
+
+#include "KDTree.h"
+#include <algorithm>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    KDTree::KDTree()
+    {
+      dim = 0;
+      numPoints = 0;
+    }
+
+    KDTree::~KDTree()
+    {
+    }
+
+
+    bool KDTree::build(const whiteice::dataset<>& data, unsigned int cluster)
+    {
+      if(cluster >= data.getNumberOfClusters()){
+	clear();
+	return false;
+      }
+
+      const unsigned int N = data.size(cluster);
+      const unsigned int D = data.dimension(cluster);
+
+      std::vector<float> pts;
+      pts.resize(N*D);
+
+      for(unsigned int i=0;i<N;i++){
+	const auto& v = data.access(cluster, i);
+
+	for(unsigned int j=0;j<D && j<v.size();j++)
+	  pts[i*D + j] = v[j].c[0];
+      }
+
+      return build(pts, D);
+    }
+
+
+    bool KDTree::build(const std::vector<float>& pts, unsigned int d)
+    {
+      clear();
+
+      if(d == 0) return false;
+      if((pts.size() % d) != 0) return false;
+
+      dim = d;
+      numPoints = pts.size() / d;
+      points = pts;
+
+      order.resize(numPoints);
+      for(unsigned int i=0;i<numPoints;i++)
+	order[i] = i;
+
+      if(numPoints > 0){
+	nodes.reserve(2*(numPoints/LEAF_SIZE + 1));
+	build_node(0, numPoints, 0);
+      }
+
+      return true;
+    }
+
+
+    void KDTree::clear()
+    {
+      dim = 0;
+      numPoints = 0;
+      points.clear();
+      order.clear();
+      nodes.clear();
+    }
+
+
+    int KDTree::build_node(unsigned int begin, unsigned int end, unsigned int depth)
+    {
+      const int index = (int)nodes.size();
+
+      node n;
+      n.begin = begin;
+      n.end = end;
+      n.splitDim = 0;
+      n.splitValue = 0.0f;
+      n.left = -1;
+      n.right = -1;
+
+      nodes.push_back(n);
+
+      if(end - begin <= LEAF_SIZE || depth >= 64)
+	return index;
+
+      // splits along the dimension with the largest spread
+      unsigned int splitDim = 0;
+      float spread = 0.0f;
+
+      for(unsigned int j=0;j<dim;j++){
+	float minv = points[order[begin]*dim + j];
+	float maxv = minv;
+
+	for(unsigned int i=begin+1;i<end;i++){
+	  const float v = points[order[i]*dim + j];
+	  if(v < minv) minv = v;
+	  if(v > maxv) maxv = v;
+	}
+
+	if(maxv - minv > spread){
+	  spread = maxv - minv;
+	  splitDim = j;
+	}
+      }
+
+      if(spread <= 0.0f)
+	return index; // all points are the same => leaf
+
+      const unsigned int median = begin + (end - begin)/2;
+
+      std::nth_element(order.begin() + begin, order.begin() + median, order.begin() + end,
+		       [&](unsigned int a, unsigned int b){
+			 return (points[a*dim + splitDim] < points[b*dim + splitDim]);
+		       });
+
+      const float splitValue = points[order[median]*dim + splitDim];
+
+      const int left  = build_node(begin, median, depth+1);
+      const int right = build_node(median, end, depth+1);
+
+      nodes[index].splitDim = splitDim;
+      nodes[index].splitValue = splitValue;
+      nodes[index].left = left;
+      nodes[index].right = right;
+
+      return index;
+    }
+
+
+    bool KDTree::knearest(const float* x, unsigned int k, float epsilon,
+			  std::vector<unsigned int>& indices,
+			  std::vector<float>& distances) const
+    {
+      indices.clear();
+      distances.clear();
+
+      if(x == nullptr || k == 0) return false;
+      if(numPoints == 0) return true;
+
+      std::vector< std::pair<float, unsigned int> > heap; // max-heap of k best
+      heap.resize(k);
+
+      const unsigned int found = knearest(x, k, epsilon, &(heap[0]));
+
+      indices.resize(found);
+      distances.resize(found);
+
+      for(unsigned int i=0;i<found;i++){
+	distances[i] = heap[i].first;
+	indices[i] = heap[i].second;
+      }
+
+      return true;
+    }
+
+
+    unsigned int KDTree::knearest(const float* x, unsigned int k, float epsilon,
+				  std::pair<float, unsigned int>* heap) const
+    {
+      if(x == nullptr || heap == nullptr || k == 0) return 0;
+      if(numPoints == 0) return 0;
+
+      if(epsilon < 0.0f) epsilon = 0.0f;
+      const float scale = (1.0f + epsilon)*(1.0f + epsilon);
+
+      unsigned int heapSize = 0;
+
+      search_knn(0, x, k, scale, heap, heapSize);
+
+      std::sort_heap(heap, heap + heapSize);
+
+      return heapSize;
+    }
+
+
+    bool KDTree::radius(const float* x, float r,
+			std::vector<unsigned int>& indices,
+			std::vector<float>& distances) const
+    {
+      indices.clear();
+      distances.clear();
+
+      if(x == nullptr || r < 0.0f) return false;
+      if(numPoints == 0) return true;
+
+      search_radius(0, x, r*r, indices, distances);
+
+      return true;
+    }
+
+
+    void KDTree::search_knn(int n, const float* x, unsigned int k, float scale,
+			    std::pair<float, unsigned int>* heap, unsigned int& heapSize) const
+    {
+      const node& nd = nodes[n];
+
+      if(nd.left < 0){ // leaf node
+	for(unsigned int i=nd.begin;i<nd.end;i++){
+	  const float d = distance2(x, order[i]);
+
+	  if(heapSize < k){
+	    heap[heapSize] = std::make_pair(d, order[i]);
+	    heapSize++;
+	    std::push_heap(heap, heap + heapSize);
+	  }
+	  else if(d < heap[0].first){
+	    std::pop_heap(heap, heap + heapSize);
+	    heap[heapSize-1] = std::make_pair(d, order[i]);
+	    std::push_heap(heap, heap + heapSize);
+	  }
+	}
+
+	return;
+      }
+
+      const float diff = x[nd.splitDim] - nd.splitValue;
+      const int nearNode = (diff < 0.0f) ? nd.left : nd.right;
+      const int farNode  = (diff < 0.0f) ? nd.right : nd.left;
+
+      search_knn(nearNode, x, k, scale, heap, heapSize);
+
+      // visits the other side only if it can contain (1+epsilon) closer points
+      if(heapSize < k || diff*diff*scale < heap[0].first)
+	search_knn(farNode, x, k, scale, heap, heapSize);
+    }
+
+
+    void KDTree::search_radius(int n, const float* x, float r2,
+			       std::vector<unsigned int>& indices,
+			       std::vector<float>& distances) const
+    {
+      const node& nd = nodes[n];
+
+      if(nd.left < 0){ // leaf node
+	for(unsigned int i=nd.begin;i<nd.end;i++){
+	  const float d = distance2(x, order[i]);
+
+	  if(d <= r2){
+	    indices.push_back(order[i]);
+	    distances.push_back(d);
+	  }
+	}
+
+	return;
+      }
+
+      const float diff = x[nd.splitDim] - nd.splitValue;
+
+      if(diff < 0.0f){
+	search_radius(nd.left, x, r2, indices, distances);
+	if(diff*diff <= r2) search_radius(nd.right, x, r2, indices, distances);
+      }
+      else{
+	search_radius(nd.right, x, r2, indices, distances);
+	if(diff*diff <= r2) search_radius(nd.left, x, r2, indices, distances);
+      }
+    }
+
+  };
+};
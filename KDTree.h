@@ -0,0 +1,97 @@
+/*
+ * KDTree
+ *
+ * spatial index of dataset<> input vectors used by the RBF (nearest
+ * neighbourhood) response predictor so that execute doesn't need
+ * to scan all measurements of a stimulus on every tick
+ */
+
+#ifndef KDTree_h
+#define KDTree_h
+
+#include <dinrhiw.h>
+#include <vector>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class KDTree
+    {
+    public:
+
+      KDTree();
+      ~KDTree();
+
+      // builds index from cluster's (preprocessed) vectors
+      bool build(const whiteice::dataset<>& data, unsigned int cluster = 0);
+
+      // builds index from N row-major dim-dimensional points
+      bool build(const std::vector<float>& points, unsigned int dim);
+
+      void clear();
+
+      unsigned int size() const { return numPoints; }
+      unsigned int dimension() const { return dim; }
+
+      // finds k nearest points to x (squared distances are returned
+      // in increasing order). epsilon > 0 gives approximate results where
+      // every returned distance is within (1+epsilon) of the true k-th nearest
+      bool knearest(const float* x, unsigned int k, float epsilon,
+		    std::vector<unsigned int>& indices,
+		    std::vector<float>& distances) const;
+
+      // allocation free version of knearest(): heap must have space for k
+      // elements, returns number of (squared distance, index) pairs found
+      unsigned int knearest(const float* x, unsigned int k, float epsilon,
+			    std::pair<float, unsigned int>* heap) const;
+
+      // finds all points within radius from x (squared distances)
+      bool radius(const float* x, float radius,
+		  std::vector<unsigned int>& indices,
+		  std::vector<float>& distances) const;
+
+    private:
+
+      struct node {
+	unsigned int begin, end; // range in order[]
+	unsigned int splitDim;
+	float splitValue;
+	int left, right; // child nodes (-1 = leaf)
+      };
+
+      int build_node(unsigned int begin, unsigned int end, unsigned int depth);
+
+      void search_knn(int n, const float* x, unsigned int k, float scale,
+		      std::pair<float, unsigned int>* heap, unsigned int& heapSize) const;
+
+      void search_radius(int n, const float* x, float r2,
+			 std::vector<unsigned int>& indices,
+			 std::vector<float>& distances) const;
+
+      inline float distance2(const float* x, unsigned int index) const {
+	const float* p = &points[index*dim];
+	float d = 0.0f;
+	for(unsigned int i=0;i<dim;i++){
+	  const float t = x[i] - p[i];
+	  d += t*t;
+	}
+	return d;
+      }
+
+      static const unsigned int LEAF_SIZE = 8;
+
+      unsigned int dim = 0;
+      unsigned int numPoints = 0;
+
+      std::vector<float> points; // row-major copy of the points
+      std::vector<unsigned int> order; // permutation of points (leaves are ranges)
+      std::vector<node> nodes;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -24,7 +24,7 @@
 namespace whiteice {
 namespace resonanz {
 
-LightstoneDevice::LightstoneDevice() {
+LightstoneDevice::LightstoneDevice() : samples(2) {
 	// starts a thread that does all the hard work
 
 	running = true;
@@ -90,6 +90,28 @@ bool LightstoneDevice::data(std::vector<float>& x) const
 	}
 }
 
+bool LightstoneDevice::readSince(unsigned long long& cursor,
+		std::vector<std::chrono::steady_clock::time_point>& times,
+		std::vector< std::vector<float> >& x) const
+{
+	samples.readSince(cursor, times, x);
+	return true;
+}
+
+
+unsigned long long LightstoneDevice::getSampleCursor() const
+{
+	return samples.getCursor();
+}
+
+
+bool LightstoneDevice::waitForSample(unsigned long long cursor,
+		std::chrono::steady_clock::time_point deadline) const
+{
+	return samples.waitForSample(cursor, deadline);
+}
+
+
 bool LightstoneDevice::getSignalNames(std::vector<std::string>& names) const
 {
 	names.resize(2);
@@ -187,6 +209,8 @@ void LightstoneDevice::lightstone_loop()
 			x[1] = u;
 			this->value = x;
 
+			samples.push(std::chrono::steady_clock::now(), x);
+
 			auto duration1 = std::chrono::system_clock::now().time_since_epoch();
 			latest_data_point_added =
 					std::chrono::duration_cast<std::chrono::milliseconds>(duration1).count();
@@ -9,6 +9,7 @@
 #define LIGHTSTONEDEVICE_H_
 
 #include "DataSource.h"
+#include "SampleRing.h"
 
 #include <thread>
 #include <mutex>
@@ -44,6 +45,15 @@ public:
 
 	  virtual unsigned int getNumberOfSignals() const;
 
+	  virtual bool readSince(unsigned long long& cursor,
+			  std::vector<std::chrono::steady_clock::time_point>& times,
+			  std::vector< std::vector<float> >& samples) const;
+
+	  virtual unsigned long long getSampleCursor() const;
+
+	  virtual bool waitForSample(unsigned long long cursor,
+			  std::chrono::steady_clock::time_point deadline) const;
+
 private:
 	  void lightstone_loop(); // worker thread loop
 
@@ -62,6 +72,8 @@ private:
 	  std::vector<float> value; // current sensor value
 	  mutable std::mutex data_mutex;
 	  long long latest_data_point_added; // milliseconds since epoch
+
+	  SampleRing samples; // every measured value
 };
 
 } /* namespace resonanz */
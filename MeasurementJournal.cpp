@@ -0,0 +1,596 @@
+
+#include "MeasurementJournal.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    static const char JOURNAL_MAGIC[8] = { 'R','Z','J','O','U','R','N','1' };
+
+    // magic, EEG signals, synth parameters, epoch
+    static const long JOURNAL_HEADER_BYTES =
+      sizeof(JOURNAL_MAGIC) + 2*sizeof(unsigned int) + sizeof(unsigned long long);
+
+    const unsigned int MeasurementJournal::SYNC_RECORDS;
+    const unsigned int MeasurementJournal::SYNC_MS;
+
+
+    // FNV-1a
+    static unsigned int checksum(const unsigned char* data, unsigned int bytes)
+    {
+      unsigned int h = 2166136261U;
+
+      for(unsigned int i=0;i<bytes;i++){
+	h ^= data[i];
+	h *= 16777619U;
+      }
+
+      return h;
+    }
+
+
+    // directory of the file
+    static std::string directory(const std::string& path)
+    {
+      const size_t i = path.find_last_of("/\\");
+
+      if(i == std::string::npos) return ".";
+      if(i == 0) return path.substr(0, 1);
+
+      return path.substr(0, i);
+    }
+
+
+    // fold mark: epoch and number of records of journal saved to files
+    static bool writeMark(const std::string& filename, unsigned long long epoch,
+			  unsigned int folded, const std::vector<std::string>& files)
+    {
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* handle = fopen(tmpname.c_str(), "wt");
+      if(handle == NULL) return false;
+
+      bool ok = (fprintf(handle, "epoch %llx\nfolded %u\n", epoch, folded) > 0);
+
+      for(const auto& f : files)
+	if(fprintf(handle, "file %s\n", f.c_str()) <= 0) ok = false;
+
+      if(fclose(handle) != 0) ok = false;
+
+      if(ok) ok = MeasurementJournal::syncFile(tmpname);
+
+#ifdef _WIN32
+      if(ok) remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(ok == false || rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return MeasurementJournal::syncDirectory(directory(filename));
+    }
+
+
+    static bool readMark(const std::string& filename, unsigned long long& epoch,
+			 unsigned int& folded, std::vector<std::string>& files)
+    {
+      FILE* handle = fopen(filename.c_str(), "rt");
+      if(handle == NULL) return false;
+
+      bool hasEpoch = false, hasFolded = false;
+      files.clear();
+
+      char line[4096];
+
+      while(fgets(line, sizeof(line), handle) != NULL){
+	unsigned long long e = 0;
+	unsigned int n = 0;
+	int offset = 0;
+
+	if(sscanf(line, "epoch %llx", &e) == 1){ epoch = e; hasEpoch = true; }
+	else if(sscanf(line, "folded %u", &n) == 1){ folded = n; hasFolded = true; }
+	else if(sscanf(line, "file %n", &offset) == 0 && offset > 0){
+	  std::string name = line + offset;
+
+	  while(name.size() > 0 && (name.back() == '\n' || name.back() == '\r'))
+	    name.pop_back();
+
+	  if(name.size() > 0) files.push_back(name);
+	}
+      }
+
+      fclose(handle);
+
+      return (hasEpoch && hasFolded);
+    }
+
+
+    MeasurementJournal::MeasurementJournal()
+    {
+    }
+
+
+    MeasurementJournal::~MeasurementJournal()
+    {
+      this->close();
+    }
+
+
+    bool MeasurementJournal::open(const std::string& filename_,
+				  unsigned int eegSignals,
+				  unsigned int synthParameters)
+    {
+      this->close();
+
+      std::vector<Record> existing;
+      bool rewrite = false;
+      bool exists = false;
+
+      FILE* f = fopen(filename_.c_str(), "rb");
+
+      if(f != NULL){
+	exists = true;
+
+	unsigned int e = 0, p = 0;
+	const bool valid = readHeader(f, e, p, epoch);
+
+	fseek(f, 0, SEEK_END);
+	const long bytes = ftell(f);
+	fclose(f);
+
+	if(valid == false || e != eegSignals || p != synthParameters){
+	  // keeps journal which cannot be replayed with current devices
+	  const std::string bad = filename_ + ".bad";
+	  remove(bad.c_str());
+	  if(rename(filename_.c_str(), bad.c_str()) != 0) return false;
+	  exists = false;
+	}
+	else if(read(filename_, eegSignals, synthParameters, existing)){
+	  const long expected = JOURNAL_HEADER_BYTES +
+	    (long)existing.size()*recordSize(eegSignals, synthParameters);
+
+	  if(bytes != expected) rewrite = true; // torn record at the end
+	}
+	else return false;
+      }
+
+      E = eegSignals;
+      P = synthParameters;
+      filename = filename_;
+
+      // writes valid records to a new file and replaces journal with it
+      if(rewrite && writeRecords(filename, E, P, epoch, existing, 0) == false)
+	return false;
+
+      handle = fopen(filename.c_str(), "ab");
+      if(handle == NULL) return false;
+
+      if(exists == false){
+	epoch = nextEpoch(epoch);
+
+	if(writeHeader(handle, E, P, epoch) == false){
+	  fclose(handle);
+	  handle = NULL;
+	  return false;
+	}
+      }
+
+      records = existing.size();
+      unsynced = 0;
+      lastSync = std::chrono::steady_clock::now();
+
+      return sync();
+    }
+
+
+    bool MeasurementJournal::append(const Record& r)
+    {
+      if(handle == NULL) return false;
+
+      if(encode(r, E, P, buffer) == false) return false;
+
+      if(fwrite(buffer.data(), 1, buffer.size(), handle) != buffer.size())
+	return false;
+
+      records++;
+      unsynced++;
+
+      const auto now = std::chrono::steady_clock::now();
+
+      if(unsynced >= SYNC_RECORDS || now - lastSync >= std::chrono::milliseconds(SYNC_MS))
+	return sync();
+
+      return true;
+    }
+
+
+    bool MeasurementJournal::sync()
+    {
+      if(handle == NULL) return false;
+
+      if(fflush(handle) != 0) return false;
+
+#ifdef _WIN32
+      if(_commit(_fileno(handle)) != 0) return false;
+#else
+      if(fsync(fileno(handle)) != 0) return false;
+#endif
+
+      unsynced = 0;
+      lastSync = std::chrono::steady_clock::now();
+
+      return true;
+    }
+
+
+    void MeasurementJournal::close()
+    {
+      if(handle == NULL) return;
+
+      sync();
+      fclose(handle);
+      handle = NULL;
+    }
+
+
+    bool MeasurementJournal::clear()
+    {
+      if(handle == NULL) return false;
+
+      fclose(handle);
+
+      handle = fopen(filename.c_str(), "wb");
+      if(handle == NULL) return false;
+
+      records = 0;
+      epoch = nextEpoch(epoch);
+
+      if(writeHeader(handle, E, P, epoch) == false){
+	fclose(handle);
+	handle = NULL;
+	return false;
+      }
+
+      return sync();
+    }
+
+
+    bool MeasurementJournal::read(const std::string& filename,
+				  unsigned int eegSignals,
+				  unsigned int synthParameters,
+				  std::vector<Record>& records)
+    {
+      records.clear();
+
+      FILE* f = fopen(filename.c_str(), "rb");
+      if(f == NULL) return false;
+
+      unsigned int e = 0, p = 0;
+      unsigned long long epoch = 0;
+
+      if(readHeader(f, e, p, epoch) == false || e != eegSignals || p != synthParameters){
+	fclose(f);
+	return false;
+      }
+
+      std::vector<unsigned char> buffer(recordSize(e, p));
+      Record r;
+
+      while(fread(buffer.data(), 1, buffer.size(), f) == buffer.size()){
+	if(decode(buffer, e, p, r) == false) break;
+	records.push_back(r);
+      }
+
+      fclose(f);
+
+      return true;
+    }
+
+
+    bool MeasurementJournal::commit(const std::vector<std::string>& files)
+    {
+      for(const auto& f : files)
+	if(syncFile(newName(f)) == false) return false;
+
+      // files have all records of journal: they are used after this even if we crash
+      if(handle != NULL){
+	if(writeMark(markName(filename), epoch, records, files) == false)
+	  return false;
+      }
+
+      bool ok = true;
+
+      for(const auto& f : files){
+#ifdef _WIN32
+	remove(f.c_str()); // rename() doesn't replace files on windows
+#endif
+	if(rename(newName(f).c_str(), f.c_str()) != 0) ok = false;
+      }
+
+      if(ok && files.size() > 0) ok = syncDirectory(directory(files[0]));
+
+      if(ok == false) return false; // recover() renames the files
+
+      if(handle != NULL){
+	if(clear() == false) return false;
+	remove(markName(filename).c_str());
+      }
+
+      return true;
+    }
+
+
+    bool MeasurementJournal::recover(const std::string& filename)
+    {
+      unsigned long long markEpoch = 0;
+      unsigned int folded = 0;
+      std::vector<std::string> files;
+
+      if(readMark(markName(filename), markEpoch, folded, files) == false)
+	return true; // no interrupted commit
+
+      unsigned int e = 0, p = 0;
+      unsigned long long epoch = 0;
+      bool valid = false;
+
+      FILE* f = fopen(filename.c_str(), "rb");
+
+      if(f != NULL){
+	valid = readHeader(f, e, p, epoch);
+	fclose(f);
+      }
+
+      if(valid == false || epoch != markEpoch){
+	// journal was already cleared (or removed): files were renamed
+	remove(markName(filename).c_str());
+	return true;
+      }
+
+      for(const auto& file : files){
+	FILE* t = fopen(newName(file).c_str(), "rb");
+	if(t == NULL) continue; // renamed before the crash
+	fclose(t);
+
+#ifdef _WIN32
+	remove(file.c_str()); // rename() doesn't replace files on windows
+#endif
+	if(rename(newName(file).c_str(), file.c_str()) != 0) return false;
+      }
+
+      if(files.size() > 0 && syncDirectory(directory(files[0])) == false)
+	return false;
+
+      // keeps records measured after the files were saved
+      std::vector<Record> records;
+
+      if(read(filename, e, p, records) == false) return false;
+
+      if(folded > records.size()) folded = records.size();
+
+      if(writeRecords(filename, e, p, nextEpoch(epoch), records, folded) == false)
+	return false;
+
+      remove(markName(filename).c_str());
+
+      return true;
+    }
+
+
+    bool MeasurementJournal::syncFile(const std::string& filename)
+    {
+#ifdef _WIN32
+      FILE* handle = fopen(filename.c_str(), "r+b");
+      if(handle == NULL) return false;
+
+      const bool ok = (_commit(_fileno(handle)) == 0);
+      fclose(handle);
+#else
+      const int fd = ::open(filename.c_str(), O_RDONLY);
+      if(fd < 0) return false;
+
+      const bool ok = (fsync(fd) == 0);
+      ::close(fd);
+#endif
+
+      return ok;
+    }
+
+
+    bool MeasurementJournal::syncDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+      return true; // directories cannot be synced on windows
+#else
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      if(fd < 0) return false;
+
+      const bool ok = (fsync(fd) == 0);
+      ::close(fd);
+
+      return ok;
+#endif
+    }
+
+
+    unsigned long long MeasurementJournal::hash(const std::string& name)
+    {
+      unsigned long long h = 14695981039346656037ULL;
+
+      for(const char c : name){
+	h ^= (unsigned char)c;
+	h *= 1099511628211ULL;
+      }
+
+      return (h != 0) ? h : 1;
+    }
+
+
+    unsigned int MeasurementJournal::recordSize(unsigned int eegSignals, unsigned int synthParameters)
+    {
+      // picture, keyword, HMM state, values, checksum
+      return 2*sizeof(unsigned long long) + sizeof(unsigned int) +
+	(2*eegSignals + 2*synthParameters)*sizeof(float) + sizeof(unsigned int);
+    }
+
+
+    bool MeasurementJournal::readHeader(FILE* handle, unsigned int& eegSignals, unsigned int& synthParameters,
+					unsigned long long& epoch)
+    {
+      char magic[sizeof(JOURNAL_MAGIC)];
+
+      if(fread(magic, 1, sizeof(magic), handle) != sizeof(magic)) return false;
+
+      if(memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0) return false;
+
+      if(fread(&eegSignals, sizeof(unsigned int), 1, handle) != 1) return false;
+      if(fread(&synthParameters, sizeof(unsigned int), 1, handle) != 1) return false;
+      if(fread(&epoch, sizeof(epoch), 1, handle) != 1) return false;
+
+      return (epoch != 0);
+    }
+
+
+    bool MeasurementJournal::writeHeader(FILE* handle, unsigned int eegSignals, unsigned int synthParameters,
+					 unsigned long long epoch)
+    {
+      if(fwrite(JOURNAL_MAGIC, 1, sizeof(JOURNAL_MAGIC), handle) != sizeof(JOURNAL_MAGIC)) return false;
+
+      if(fwrite(&eegSignals, sizeof(unsigned int), 1, handle) != 1) return false;
+      if(fwrite(&synthParameters, sizeof(unsigned int), 1, handle) != 1) return false;
+      if(fwrite(&epoch, sizeof(epoch), 1, handle) != 1) return false;
+
+      return true;
+    }
+
+
+    unsigned long long MeasurementJournal::nextEpoch(unsigned long long previous)
+    {
+      // clock time so that epochs of removed journals are not reused
+      const unsigned long long now = (unsigned long long)
+	std::chrono::duration_cast<std::chrono::nanoseconds>
+	(std::chrono::system_clock::now().time_since_epoch()).count();
+
+      return (now > previous) ? now : previous + 1;
+    }
+
+
+    bool MeasurementJournal::writeRecords(const std::string& filename,
+					  unsigned int eegSignals, unsigned int synthParameters,
+					  unsigned long long epoch,
+					  const std::vector<Record>& records, unsigned int first)
+    {
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* t = fopen(tmpname.c_str(), "wb");
+      if(t == NULL) return false;
+
+      std::vector<unsigned char> buffer;
+
+      bool ok = writeHeader(t, eegSignals, synthParameters, epoch);
+
+      for(unsigned int i=first;i<records.size() && ok;i++){
+	if(encode(records[i], eegSignals, synthParameters, buffer) == false ||
+	   fwrite(buffer.data(), 1, buffer.size(), t) != buffer.size())
+	  ok = false;
+      }
+
+      if(fclose(t) != 0) ok = false;
+
+      if(ok) ok = syncFile(tmpname);
+
+#ifdef _WIN32
+      if(ok) remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(ok == false || rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return syncDirectory(directory(filename));
+    }
+
+
+    bool MeasurementJournal::encode(const Record& r, unsigned int eegSignals,
+				    unsigned int synthParameters, std::vector<unsigned char>& buffer)
+    {
+      if(r.eegBefore.size() != eegSignals || r.eegAfter.size() != eegSignals) return false;
+
+      // synth values are optional (synth is disabled)
+      if(r.synthBefore.size() != synthParameters && r.synthBefore.size() != 0) return false;
+      if(r.synthAfter.size() != synthParameters && r.synthAfter.size() != 0) return false;
+
+      buffer.resize(recordSize(eegSignals, synthParameters));
+
+      unsigned char* p = buffer.data();
+
+      memcpy(p, &r.picture, sizeof(r.picture)); p += sizeof(r.picture);
+      memcpy(p, &r.keyword, sizeof(r.keyword)); p += sizeof(r.keyword);
+      memcpy(p, &r.hmmState, sizeof(r.hmmState)); p += sizeof(r.hmmState);
+
+      memcpy(p, r.eegBefore.data(), eegSignals*sizeof(float)); p += eegSignals*sizeof(float);
+      memcpy(p, r.eegAfter.data(), eegSignals*sizeof(float)); p += eegSignals*sizeof(float);
+
+      const float zero = 0.0f;
+
+      for(unsigned int i=0;i<synthParameters;i++){
+	memcpy(p, r.synthBefore.size() ? &r.synthBefore[i] : &zero, sizeof(float));
+	p += sizeof(float);
+      }
+
+      for(unsigned int i=0;i<synthParameters;i++){
+	memcpy(p, r.synthAfter.size() ? &r.synthAfter[i] : &zero, sizeof(float));
+	p += sizeof(float);
+      }
+
+      const unsigned int c = checksum(buffer.data(), (unsigned int)(p - buffer.data()));
+      memcpy(p, &c, sizeof(c));
+
+      return true;
+    }
+
+
+    bool MeasurementJournal::decode(const std::vector<unsigned char>& buffer, unsigned int eegSignals,
+				    unsigned int synthParameters, Record& r)
+    {
+      if(buffer.size() != recordSize(eegSignals, synthParameters)) return false;
+
+      const unsigned int bytes = buffer.size() - sizeof(unsigned int);
+
+      unsigned int c = 0;
+      memcpy(&c, buffer.data() + bytes, sizeof(c));
+
+      if(c != checksum(buffer.data(), bytes)) return false;
+
+      const unsigned char* p = buffer.data();
+
+      memcpy(&r.picture, p, sizeof(r.picture)); p += sizeof(r.picture);
+      memcpy(&r.keyword, p, sizeof(r.keyword)); p += sizeof(r.keyword);
+      memcpy(&r.hmmState, p, sizeof(r.hmmState)); p += sizeof(r.hmmState);
+
+      r.eegBefore.resize(eegSignals);
+      r.eegAfter.resize(eegSignals);
+      r.synthBefore.resize(synthParameters);
+      r.synthAfter.resize(synthParameters);
+
+      memcpy(r.eegBefore.data(), p, eegSignals*sizeof(float)); p += eegSignals*sizeof(float);
+      memcpy(r.eegAfter.data(), p, eegSignals*sizeof(float)); p += eegSignals*sizeof(float);
+      memcpy(r.synthBefore.data(), p, synthParameters*sizeof(float)); p += synthParameters*sizeof(float);
+      memcpy(r.synthAfter.data(), p, synthParameters*sizeof(float)); p += synthParameters*sizeof(float);
+
+      return true;
+    }
+
+  };
+};
@@ -0,0 +1,144 @@
+/*
+ * MeasurementJournal
+ *
+ * append-only write-ahead log of measurements saved to model directory.
+ * each stored measurement is appended as a fixed-size checksummed record
+ * and the file is fsync()ed in batches so a crash loses at most the last
+ * batch. records are replayed to datasets when the database is loaded and
+ * the journal is cleared after datasets have been saved (compaction).
+ * stimuli are identified by hashes of their names so replay doesn't
+ * depend on the order of pictures and keywords
+ *
+ * saved datasets are committed with the journal: files are written to
+ * newName(file), synced and the fold mark (journal epoch and number of
+ * records saved to the files) is written to filename.folded before the
+ * files are renamed and the journal is cleared (new epoch). after a crash
+ * recover() finishes renaming and removes folded records from the journal
+ */
+
+#ifndef MeasurementJournal_h
+#define MeasurementJournal_h
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdio.h>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class MeasurementJournal
+    {
+    public:
+
+      // fsync() after this many records or milliseconds since the last sync
+      static const unsigned int SYNC_RECORDS = 16;
+      static const unsigned int SYNC_MS = 2000;
+
+      struct Record
+      {
+	unsigned long long picture = 0; // hash of picture name (0 = none)
+	unsigned long long keyword = 0; // hash of keyword (0 = none)
+	unsigned int hmmState = 0;
+
+	std::vector<float> eegBefore, eegAfter;
+	std::vector<float> synthBefore, synthAfter;
+      };
+
+      MeasurementJournal();
+      ~MeasurementJournal(); // syncs and closes journal
+
+      // opens journal for appending (creates it if needed). journal with
+      // different dimensions is moved to filename.bad. torn records at the
+      // end of the file (crash during write) are removed
+      bool open(const std::string& filename,
+		unsigned int eegSignals,
+		unsigned int synthParameters);
+
+      bool isOpen() const { return handle != NULL; }
+
+      bool append(const Record& r);
+
+      // writes buffered records to disk
+      bool sync();
+
+      void close();
+
+      // removes all records (they have been saved to datasets)
+      bool clear();
+
+      // saved dataset files are first written to temporary name
+      static std::string newName(const std::string& file){ return file + ".new"; }
+
+      // syncs newName() files, writes fold mark (all records), renames files
+      // and clears the journal. only renames files if journal isn't open
+      bool commit(const std::vector<std::string>& files);
+
+      // finishes commit stopped by a crash before journal is opened: renames
+      // remaining files and removes records already saved to them from journal
+      static bool recover(const std::string& filename);
+
+      // fold mark file of journal
+      static std::string markName(const std::string& filename){ return filename + ".folded"; }
+
+      // records in the journal
+      unsigned int getRecords() const { return records; }
+
+      // reads valid records from journal, stops at first torn or corrupted record.
+      // returns false if journal doesn't exist or has different dimensions
+      static bool read(const std::string& filename,
+		       unsigned int eegSignals,
+		       unsigned int synthParameters,
+		       std::vector<Record>& records);
+
+      // fsync() of file or directory (renamed files) contents
+      static bool syncFile(const std::string& filename);
+      static bool syncDirectory(const std::string& path);
+
+      // stimulus name hash used in records (never 0)
+      static unsigned long long hash(const std::string& name);
+
+    private:
+
+      static unsigned int recordSize(unsigned int eegSignals, unsigned int synthParameters);
+
+      static bool readHeader(FILE* handle, unsigned int& eegSignals, unsigned int& synthParameters,
+			     unsigned long long& epoch);
+      static bool writeHeader(FILE* handle, unsigned int eegSignals, unsigned int synthParameters,
+			      unsigned long long epoch);
+
+      // epoch following previous one (never used before)
+      static unsigned long long nextEpoch(unsigned long long previous);
+
+      // writes records starting from first to a new journal file (replaces filename)
+      static bool writeRecords(const std::string& filename,
+			       unsigned int eegSignals, unsigned int synthParameters,
+			       unsigned long long epoch,
+			       const std::vector<Record>& records, unsigned int first);
+
+      static bool encode(const Record& r, unsigned int eegSignals,
+			 unsigned int synthParameters, std::vector<unsigned char>& buffer);
+
+      static bool decode(const std::vector<unsigned char>& buffer, unsigned int eegSignals,
+			 unsigned int synthParameters, Record& r);
+
+      std::string filename;
+      FILE* handle = NULL;
+
+      unsigned int E = 0, P = 0;  // EEG signals, synth parameters
+      unsigned long long epoch = 0; // changes when journal is cleared
+      unsigned int records = 0;
+      unsigned int unsynced = 0;
+
+      std::chrono::steady_clock::time_point lastSync;
+
+      std::vector<unsigned char> buffer;
+
+    };
+
+  };
+};
+
+
+#endif
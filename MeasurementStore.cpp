@@ -0,0 +1,427 @@
+
+#include "MeasurementStore.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    static const char STORE_MAGIC[8] = { 'R','Z','S','T','O','R','E','1' };
+
+    static const unsigned int STORE_ALIGN = 64; // columns start at aligned offset
+
+    struct StoreHeader
+    {
+      char magic[8];
+      unsigned int inputs;
+      unsigned int outputs;
+      unsigned int stimuli;
+      unsigned int reserved;
+      unsigned long long totalRows;
+      unsigned long long dataOffset;
+    };
+
+
+    MeasurementStore::MeasurementStore()
+    {
+    }
+
+
+    MeasurementStore::~MeasurementStore()
+    {
+      this->close();
+    }
+
+
+    bool MeasurementStore::open(const std::string& filename_)
+    {
+      this->close();
+
+      if(map(filename_, file) == false) return false;
+
+      filename = filename_;
+
+      if(parse(file) == false){
+	this->close();
+	return false;
+      }
+
+      // segment overrides stimuli of the store file (ignored if it is invalid)
+      if(map(segmentName(filename), segment)){
+	const auto n = names;
+	const auto l = layer;
+	const auto f = first;
+	const auto c = counts;
+	const auto i = index;
+
+	if(parse(segment) == false){
+	  names = n;
+	  layer = l;
+	  first = f;
+	  counts = c;
+	  index = i;
+
+	  unmap(segment);
+	}
+      }
+
+      return true;
+    }
+
+
+    bool MeasurementStore::map(const std::string& filename, Mapping& m)
+    {
+#ifdef _WIN32
+      HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      if(f == INVALID_HANDLE_VALUE) return false;
+
+      LARGE_INTEGER bytes;
+      if(GetFileSizeEx(f, &bytes) == 0 || bytes.QuadPart < (LONGLONG)sizeof(StoreHeader)){
+	CloseHandle(f);
+	return false;
+      }
+
+      HANDLE h = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+      if(h == NULL){
+	CloseHandle(f);
+	return false;
+      }
+
+      void* p = MapViewOfFile(h, FILE_MAP_READ, 0, 0, 0);
+      if(p == NULL){
+	CloseHandle(h);
+	CloseHandle(f);
+	return false;
+      }
+
+      m.fileHandle = f;
+      m.mapHandle = h;
+      m.base = (const unsigned char*)p;
+      m.length = bytes.QuadPart;
+#else
+      const int fd = ::open(filename.c_str(), O_RDONLY);
+      if(fd < 0) return false;
+
+      struct stat st;
+      if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(StoreHeader)){
+	::close(fd);
+	return false;
+      }
+
+      void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd); // mapping keeps the file open
+
+      if(p == MAP_FAILED) return false;
+
+      m.base = (const unsigned char*)p;
+      m.length = st.st_size;
+#endif
+
+      return true;
+    }
+
+
+    void MeasurementStore::unmap(Mapping& m)
+    {
+      if(m.base != nullptr){
+#ifdef _WIN32
+	UnmapViewOfFile(m.base);
+	CloseHandle((HANDLE)m.mapHandle);
+	CloseHandle((HANDLE)m.fileHandle);
+#else
+	munmap((void*)m.base, m.length);
+#endif
+      }
+
+      m = Mapping();
+    }
+
+
+    bool MeasurementStore::parse(Mapping& m)
+    {
+      // parses header and index
+      StoreHeader h;
+      memcpy(&h, m.base, sizeof(h));
+
+      const unsigned long long columns = h.inputs + h.outputs;
+
+      if(memcmp(h.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 ||
+	 h.dataOffset % sizeof(float) != 0 || h.dataOffset > m.length ||
+	 (m.length - h.dataOffset)/sizeof(float) < columns*h.totalRows)
+	return false;
+
+      // segment must have the same columns as the store file
+      if(&m == &segment && (h.inputs != inputs || h.outputs != outputs))
+	return false;
+
+      unsigned long long offset = sizeof(StoreHeader);
+      unsigned int parsed = 0;
+
+      for(unsigned int s=0;s<h.stimuli;s++){
+	unsigned int n = 0, r = 0;
+	unsigned long long f = 0;
+
+	if(offset + sizeof(n) > h.dataOffset) break;
+	memcpy(&n, m.base + offset, sizeof(n)); offset += sizeof(n);
+
+	if(offset + n + sizeof(f) + sizeof(r) > h.dataOffset) break;
+
+	std::string name((const char*)(m.base + offset), n); offset += n;
+	memcpy(&f, m.base + offset, sizeof(f)); offset += sizeof(f);
+	memcpy(&r, m.base + offset, sizeof(r)); offset += sizeof(r);
+
+	if(f + r > h.totalRows) break;
+
+	auto i = index.find(name);
+
+	if(i != index.end()){ // newer values of the stimulus
+	  layer[i->second] = &m;
+	  first[i->second] = f;
+	  counts[i->second] = r;
+	}
+	else{
+	  index[name] = names.size();
+	  names.push_back(name);
+	  layer.push_back(&m);
+	  first.push_back(f);
+	  counts.push_back(r);
+	}
+
+	parsed++;
+      }
+
+      if(parsed != h.stimuli) return false; // corrupted index
+
+      inputs = h.inputs;
+      outputs = h.outputs;
+      m.totalRows = h.totalRows;
+      m.data = (const float*)(m.base + h.dataOffset);
+
+      return true;
+    }
+
+
+    void MeasurementStore::close()
+    {
+      unmap(segment);
+      unmap(file);
+
+      inputs = 0;
+      outputs = 0;
+
+      names.clear();
+      layer.clear();
+      first.clear();
+      counts.clear();
+      index.clear();
+    }
+
+
+    bool MeasurementStore::find(const std::string& name, unsigned int& s) const
+    {
+      auto i = index.find(name);
+      if(i == index.end()) return false;
+
+      s = i->second;
+
+      return true;
+    }
+
+
+    const float* MeasurementStore::column(unsigned int s, unsigned int c) const
+    {
+      if(s >= names.size() || c >= inputs + outputs) return nullptr;
+
+      return layer[s]->data + c*layer[s]->totalRows + first[s];
+    }
+
+
+    unsigned long long MeasurementStore::getRows() const
+    {
+      unsigned long long rows = 0;
+
+      for(const auto& c : counts) rows += c;
+
+      return rows;
+    }
+
+
+    unsigned long long MeasurementStore::getSegmentRows() const
+    {
+      unsigned long long rows = 0;
+
+      for(unsigned int s=0;s<names.size();s++)
+	if(layer[s] == &segment) rows += counts[s];
+
+      return rows;
+    }
+
+
+    bool MeasurementStore::get(unsigned int s, whiteice::dataset<>& ds) const
+    {
+      if(s >= names.size()) return false;
+
+      const unsigned int N = counts[s];
+
+      ds.clear();
+
+      if(ds.createCluster("input", inputs) == false ||
+	 ds.createCluster("output", outputs) == false)
+	return false;
+
+      std::vector< whiteice::math::vertex<> > x(N), y(N);
+
+      for(unsigned int i=0;i<N;i++){
+	x[i].resize(inputs);
+	y[i].resize(outputs);
+      }
+
+      // column by column so that mapped memory is read sequentially
+      for(unsigned int c=0;c<inputs;c++){
+	const float* v = column(s, c);
+	for(unsigned int i=0;i<N;i++) x[i][c] = v[i];
+      }
+
+      for(unsigned int c=0;c<outputs;c++){
+	const float* v = column(s, inputs + c);
+	for(unsigned int i=0;i<N;i++) y[i][c] = v[i];
+      }
+
+      if(N == 0) return true;
+
+      return (ds.add(0, x) && ds.add(1, y));
+    }
+
+
+    bool MeasurementStore::extract(const whiteice::dataset<>& ds, std::vector<float>& columns)
+    {
+      if(ds.getNumberOfClusters() != 2 || ds.size(0) != ds.size(1)) return false;
+
+      const unsigned int N = ds.size(0);
+      const unsigned int I = ds.dimension(0);
+      const unsigned int O = ds.dimension(1);
+
+      columns.resize((unsigned long long)N*(I+O));
+
+      whiteice::math::vertex<> x, y;
+
+      for(unsigned int i=0;i<N;i++){
+	x = ds.access(0, i);
+	y = ds.access(1, i);
+
+	if(ds.invpreprocess(0, x) == false || ds.invpreprocess(1, y) == false)
+	  return false;
+
+	for(unsigned int c=0;c<I && c<x.size();c++)
+	  columns[(unsigned long long)c*N + i] = x[c].c[0];
+
+	for(unsigned int c=0;c<O && c<y.size();c++)
+	  columns[(unsigned long long)(I+c)*N + i] = y[c].c[0];
+      }
+
+      return true;
+    }
+
+
+    bool MeasurementStore::write(const std::string& filename,
+				 unsigned int inputs, unsigned int outputs,
+				 const std::vector<std::string>& names,
+				 const std::vector< std::vector<float> >& columns)
+    {
+      if(names.size() != columns.size()) return false;
+
+      const unsigned int C = inputs + outputs;
+
+      std::vector<unsigned long long> rows(names.size());
+      unsigned long long totalRows = 0;
+      unsigned long long indexBytes = 0;
+
+      for(unsigned int s=0;s<names.size();s++){
+	if(C == 0 || columns[s].size() % C != 0) return false;
+
+	rows[s] = columns[s].size() / C;
+	totalRows += rows[s];
+
+	indexBytes += sizeof(unsigned int) + names[s].size() +
+	  sizeof(unsigned long long) + sizeof(unsigned int);
+      }
+
+      StoreHeader h;
+      memcpy(h.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+      h.inputs = inputs;
+      h.outputs = outputs;
+      h.stimuli = names.size();
+      h.reserved = 0;
+      h.totalRows = totalRows;
+      h.dataOffset = sizeof(StoreHeader) + indexBytes;
+      h.dataOffset = ((h.dataOffset + STORE_ALIGN - 1)/STORE_ALIGN)*STORE_ALIGN;
+
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* handle = fopen(tmpname.c_str(), "wb");
+      if(handle == NULL) return false;
+
+      bool ok = (fwrite(&h, sizeof(h), 1, handle) == 1);
+
+      unsigned long long f = 0;
+
+      for(unsigned int s=0;s<names.size() && ok;s++){
+	const unsigned int n = names[s].size();
+	const unsigned int r = rows[s];
+
+	ok = ok && (fwrite(&n, sizeof(n), 1, handle) == 1);
+	ok = ok && (fwrite(names[s].data(), 1, n, handle) == n);
+	ok = ok && (fwrite(&f, sizeof(f), 1, handle) == 1);
+	ok = ok && (fwrite(&r, sizeof(r), 1, handle) == 1);
+
+	f += r;
+      }
+
+      const unsigned long long padding = h.dataOffset - sizeof(StoreHeader) - indexBytes;
+      const unsigned char zeros[STORE_ALIGN] = { 0 };
+
+      ok = ok && (fwrite(zeros, 1, padding, handle) == padding);
+
+      // column c: rows of every stimulus
+      for(unsigned int c=0;c<C && ok;c++){
+	for(unsigned int s=0;s<names.size() && ok;s++){
+	  if(rows[s] == 0) continue;
+	  const float* v = columns[s].data() + c*rows[s];
+	  ok = (fwrite(v, sizeof(float), rows[s], handle) == rows[s]);
+	}
+      }
+
+      if(fclose(handle) != 0) ok = false;
+
+      if(ok == false){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+#ifdef _WIN32
+      remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return true;
+    }
+
+  };
+};
@@ -0,0 +1,122 @@
+/*
+ * MeasurementStore
+ *
+ * single file columnar store of stimulus measurements (replaces one .ds
+ * file per keyword/picture). values are saved without preprocessing as
+ * float32 columns: column c holds rows of all stimuli one after another and
+ * index maps stimulus name to its row range. file is memory mapped and read
+ * without parsing. stimuli are returned as dataset<> (input and output
+ * clusters) so the rest of the code works as before
+ *
+ * stimuli changed after the store file was written are saved to a smaller
+ * segment file (same format) which overrides them so that saving doesn't
+ * rewrite all stimuli. segment is merged to the store file when it grows
+ *
+ * file: header, index (name, first row, rows), padding, columns
+ */
+
+#ifndef MeasurementStore_h
+#define MeasurementStore_h
+
+#include <dinrhiw/dinrhiw.h>
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class MeasurementStore
+    {
+    public:
+
+      MeasurementStore();
+      ~MeasurementStore(); // unmaps file
+
+      // maps store file and its segment file (if it exists) to memory (read only)
+      bool open(const std::string& filename);
+
+      bool isOpen() const { return (file.base != nullptr); }
+
+      // "path/name.store" => "path/name.store.segment"
+      static std::string segmentName(const std::string& filename){ return filename + ".segment"; }
+
+      void close();
+
+      unsigned int getInputs() const { return inputs; }
+      unsigned int getOutputs() const { return outputs; }
+
+      // number of stimuli
+      unsigned int size() const { return names.size(); }
+
+      const std::string& getName(unsigned int s) const { return names[s]; }
+
+      bool find(const std::string& name, unsigned int& s) const;
+
+      unsigned int rows(unsigned int s) const { return counts[s]; }
+
+      // stimulus is read from segment file
+      bool inSegment(unsigned int s) const { return (layer[s] == &segment); }
+
+      // rows of all stimuli and rows of stimuli in segment file
+      unsigned long long getRows() const;
+      unsigned long long getSegmentRows() const;
+
+      // zero-copy access: rows(s) values of column c (inputs first, then outputs)
+      const float* column(unsigned int s, unsigned int c) const;
+
+      // creates dataset with input and output clusters (no preprocessing)
+      bool get(unsigned int s, whiteice::dataset<>& data) const;
+
+      // values of dataset without preprocessing in column-major order
+      static bool extract(const whiteice::dataset<>& data, std::vector<float>& columns);
+
+      // writes store of stimuli (columns as returned by extract()).
+      // writes temporary file and renames it
+      static bool write(const std::string& filename,
+			unsigned int inputs, unsigned int outputs,
+			const std::vector<std::string>& names,
+			const std::vector< std::vector<float> >& columns);
+
+    private:
+
+      struct Mapping
+      {
+	const unsigned char* base = nullptr; // mapped file
+	unsigned long long length = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mapHandle = nullptr;
+#endif
+
+	unsigned long long totalRows = 0;
+	const float* data = nullptr;         // columns
+      };
+
+      static bool map(const std::string& filename, Mapping& m);
+      static void unmap(Mapping& m);
+
+      // adds stimuli of mapped file to index (replaces stimuli with the same name)
+      bool parse(Mapping& m);
+
+      std::string filename;
+
+      Mapping file, segment;
+
+      unsigned int inputs = 0, outputs = 0;
+
+      std::vector<std::string> names;
+      std::vector<const Mapping*> layer;   // file of stimulus
+      std::vector<unsigned long long> first;
+      std::vector<unsigned int> counts;
+      std::map<std::string, unsigned int> index;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -0,0 +1,188 @@
+
+#include "ModelInfo.h"
+#include <stdio.h>
+#include <math.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    // FNV-1a
+    static void hash_value(unsigned long long& h, unsigned long long v)
+    {
+      for(unsigned int i=0;i<8;i++){
+	h ^= (v >> (8*i)) & 0xFF;
+	h *= 1099511628211ULL;
+      }
+    }
+
+
+    // keeps 16 bits of mantissa
+    static unsigned long long quantize(float x)
+    {
+      if(x != x) return 0xFFFFFFFFFFFFFFFFULL;
+
+      int e = 0;
+      const double m = frexp((double)x, &e);
+
+      return (((unsigned long long)(long long)lround(m*65536.0)) << 16) ^ (unsigned long long)(e & 0xFFFF);
+    }
+
+
+    bool ModelInfo::calculate(const whiteice::dataset<>& data, unsigned int inputColumns)
+    {
+      // outputs (cluster 1) are optional
+      const bool outputs = (data.getNumberOfClusters() >= 2);
+
+      if(data.getNumberOfClusters() < 1) return false;
+      if(outputs && data.size(0) != data.size(1)) return false;
+
+      samples = data.size(0);
+      hash = 14695981039346656037ULL;
+
+      hash_value(hash, samples);
+
+      whiteice::math::vertex<> x, y;
+
+      for(unsigned int i=0;i<samples;i++){
+	x = data.access(0, i);
+	if(data.invpreprocess(0, x) == false) return false;
+
+	for(unsigned int j=0;j<x.size() && j<inputColumns;j++)
+	  hash_value(hash, quantize(x[j].c[0]));
+
+	if(outputs){
+	  y = data.access(1, i);
+	  if(data.invpreprocess(1, y) == false) return false;
+
+	  for(unsigned int j=0;j<y.size();j++)
+	    hash_value(hash, quantize(y[j].c[0]));
+	}
+      }
+
+      return true;
+    }
+
+
+    bool ModelInfo::load(const std::string& filename)
+    {
+      FILE* handle = fopen(filename.c_str(), "rt");
+      if(handle == NULL) return false;
+
+      ModelInfo info;
+      bool hasSamples = false, hasHash = false;
+
+      char line[256];
+
+      while(fgets(line, sizeof(line), handle) != NULL){
+	unsigned long long h = 0;
+	unsigned int u = 0;
+	float f = 0.0f;
+
+	if(sscanf(line, "samples %u", &u) == 1){ info.samples = u; hasSamples = true; }
+	else if(sscanf(line, "hash %llx", &h) == 1){ info.hash = h; hasHash = true; }
+	else if(sscanf(line, "states %llx", &h) == 1) info.states = h;
+	else if(sscanf(line, "iterations %u", &u) == 1) info.iterations = u;
+	else if(sscanf(line, "error %f", &f) == 1) info.error = f;
+	else if(sscanf(line, "seconds %f", &f) == 1) info.seconds = f;
+	else if(sscanf(line, "hmcsamples %u", &u) == 1) info.hmcSamples = u;
+      }
+
+      fclose(handle);
+
+      if(hasSamples == false || hasHash == false) return false;
+
+      *this = info;
+
+      return true;
+    }
+
+
+    bool ModelInfo::save(const std::string& filename) const
+    {
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* handle = fopen(tmpname.c_str(), "wt");
+      if(handle == NULL) return false;
+
+      bool ok = (fprintf(handle, "samples %u\nhash %llx\niterations %u\nerror %f\nseconds %.1f\n",
+			 samples, hash, iterations, error, seconds) > 0);
+
+      if(ok && states != 0)
+	ok = (fprintf(handle, "states %llx\n", states) > 0);
+
+      if(ok && hmcSamples > 0)
+	ok = (fprintf(handle, "hmcsamples %u\n", hmcSamples) > 0);
+
+      if(fclose(handle) != 0) ok = false;
+
+      if(ok == false){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+#ifdef _WIN32
+      remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool ModelInfo::hashFile(const std::string& filename, unsigned long long& hash)
+    {
+      FILE* handle = fopen(filename.c_str(), "rb");
+      if(handle == NULL) return false;
+
+      if(hash == 0) hash = 14695981039346656037ULL;
+
+      unsigned char buffer[4096];
+      size_t n = 0;
+
+      while((n = fread(buffer, 1, sizeof(buffer), handle)) > 0){
+	for(size_t i=0;i<n;i++){
+	  hash ^= buffer[i];
+	  hash *= 1099511628211ULL;
+	}
+      }
+
+      const bool ok = (ferror(handle) == 0);
+
+      fclose(handle);
+
+      return ok;
+    }
+
+
+    std::string ModelInfo::sidecar(const std::string& modelFilename)
+    {
+      const std::string ext = ".model";
+
+      if(modelFilename.size() >= ext.size() &&
+	 modelFilename.compare(modelFilename.size() - ext.size(), ext.size(), ext) == 0)
+	return modelFilename.substr(0, modelFilename.size() - ext.size()) + ".modelinfo";
+
+      return modelFilename + ".modelinfo";
+    }
+
+
+    std::string ModelInfo::partial(const std::string& modelFilename)
+    {
+      const std::string ext = ".model";
+
+      if(modelFilename.size() >= ext.size() &&
+	 modelFilename.compare(modelFilename.size() - ext.size(), ext.size(), ext) == 0)
+	return modelFilename.substr(0, modelFilename.size() - ext.size()) + ".partial.model";
+
+      return modelFilename + ".partial.model";
+    }
+
+  };
+};
@@ -0,0 +1,69 @@
+/*
+ * ModelInfo
+ *
+ * .modelinfo sidecar file saved next to each trained .model file. records
+ * number of samples and content hash of the dataset the model was trained
+ * with so that retraining can skip unchanged models and only fine-tune
+ * models which have few new measurements or relabelled HMM states. also
+ * keeps training statistics
+ */
+
+#ifndef ModelInfo_h
+#define ModelInfo_h
+
+#include <dinrhiw/dinrhiw.h>
+#include <string>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class ModelInfo
+    {
+    public:
+
+      unsigned int samples = 0;     // number of rows in dataset
+      unsigned long long hash = 0;  // content hash of dataset
+      unsigned long long states = 0; // hash of K-Means and HMM models that labelled HMM state columns (0 if none)
+
+      // statistics of the last training
+      unsigned int iterations = 0;  // optimizer iterations used
+      float error = 0.0f;           // final error
+      float seconds = 0.0f;         // training time
+      unsigned int hmcSamples = 0;  // HMC samples in unfinished model snapshot
+
+      // computes samples and hash of dataset. only first inputColumns values
+      // of input rows are used (HMM state columns are recomputed every time
+      // models are optimized, states identifies the model that computed them).
+      // values are hashed without preprocessing and rounded so that
+      // preprocessing round trips don't change the hash
+      bool calculate(const whiteice::dataset<>& data, unsigned int inputColumns);
+
+      bool load(const std::string& filename);
+      bool save(const std::string& filename) const; // writes temporary file and renames it
+
+      bool sameData(const ModelInfo& info) const {
+	return (samples == info.samples && hash == info.hash && states == info.states);
+      }
+
+      // same measurements but possibly different HMM state labels
+      bool sameSamples(const ModelInfo& info) const {
+	return (samples == info.samples && hash == info.hash);
+      }
+
+      // adds content of file to hash (start from 0 or previous hashFile() value)
+      static bool hashFile(const std::string& filename, unsigned long long& hash);
+
+      // "path/name.model" => "path/name.modelinfo"
+      static std::string sidecar(const std::string& modelFilename);
+
+      // "path/name.model" => "path/name.partial.model" (snapshot of unfinished model)
+      static std::string partial(const std::string& modelFilename);
+
+    };
+
+  };
+};
+
+
+#endif
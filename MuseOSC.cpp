@@ -21,7 +21,7 @@ namespace whiteice {
 namespace resonanz {
 
 MuseOSC::MuseOSC(unsigned int portNum) : 
-		port(portNum)
+		port(portNum), samples(6)
 {
   worker_thread = nullptr;
   running = false;
@@ -103,6 +103,25 @@ bool MuseOSC::data(std::vector<float>& x) const
   return true;
 }
 
+bool MuseOSC::readSince(unsigned long long& cursor,
+			std::vector<std::chrono::steady_clock::time_point>& times,
+			std::vector< std::vector<float> >& x) const
+{
+  samples.readSince(cursor, times, x);
+  return true;
+}
+
+unsigned long long MuseOSC::getSampleCursor() const
+{
+  return samples.getCursor();
+}
+
+bool MuseOSC::waitForSample(unsigned long long cursor,
+			    std::chrono::steady_clock::time_point deadline) const
+{
+  return samples.waitForSample(cursor, deadline);
+}
+
 bool MuseOSC::getSignalNames(std::vector<std::string>& names) const
 {
   names.resize(6);
@@ -211,6 +230,8 @@ void MuseOSC::muse_loop() // worker thread loop
       // gets current time
       auto ms_since_epoch = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
       
+      samples.push(steady_clock::now(), v);
+      
       std::lock_guard<std::mutex> lock(data_mutex);
       value = v;
       latest_sample_seen_t = (long long)ms_since_epoch;
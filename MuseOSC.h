@@ -9,6 +9,7 @@
 #define MUSEOSC_H_
 
 #include "DataSource.h"
+#include "SampleRing.h"
 
 #include <vector>
 #include <stdexcept>
@@ -53,6 +54,15 @@ public:
   
   virtual unsigned int getNumberOfSignals() const;
   
+  virtual bool readSince(unsigned long long& cursor,
+			 std::vector<std::chrono::steady_clock::time_point>& times,
+			 std::vector< std::vector<float> >& samples) const;
+  
+  virtual unsigned long long getSampleCursor() const;
+  
+  virtual bool waitForSample(unsigned long long cursor,
+			     std::chrono::steady_clock::time_point deadline) const;
+  
  private:
   const unsigned int port;
   
@@ -71,6 +81,8 @@ public:
   std::vector<float> value; // currently measured value
   long long latest_sample_seen_t; // time of the latest measured value
   
+  SampleRing samples; // every measured value
+  
 };
 
 } /* namespace resonanz */
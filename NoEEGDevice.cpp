@@ -10,14 +10,34 @@
 namespace whiteice {
 namespace resonanz {
 
-NoEEGDevice::NoEEGDevice() {
-	// TODO Auto-generated constructor stub
-
+NoEEGDevice::NoEEGDevice() :
+	stream(1, SAMPLE_HZ, [this](std::vector<float>& x){ return data(x); }) {
 }
 
 NoEEGDevice::~NoEEGDevice() {
 	// TODO Auto-generated destructor stub
 }
 
+
+bool NoEEGDevice::readSince(unsigned long long& cursor,
+		std::vector<std::chrono::steady_clock::time_point>& times,
+		std::vector< std::vector<float> >& x) const
+{
+	return stream.readSince(cursor, times, x);
+}
+
+
+unsigned long long NoEEGDevice::getSampleCursor() const
+{
+	return stream.getCursor();
+}
+
+
+bool NoEEGDevice::waitForSample(unsigned long long cursor,
+		std::chrono::steady_clock::time_point deadline) const
+{
+	return stream.waitForSample(cursor, deadline);
+}
+
 } /* namespace resonanz */
 } /* namespace whiteice */
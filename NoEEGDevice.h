@@ -9,6 +9,7 @@
 #define NOEEGDEVICE_H_
 
 #include "DataSource.h"
+#include "SimulatedStream.h"
 
 namespace whiteice {
 namespace resonanz {
@@ -45,6 +46,23 @@ public:
 	}
 
 	virtual unsigned int getNumberOfSignals() const { return 1; }
+
+	/**
+	 * sample stream of values generated at SAMPLE_HZ
+	 */
+	virtual bool readSince(unsigned long long& cursor,
+			std::vector<std::chrono::steady_clock::time_point>& times,
+			std::vector< std::vector<float> >& samples) const;
+
+	virtual unsigned long long getSampleCursor() const;
+
+	virtual bool waitForSample(unsigned long long cursor,
+			std::chrono::steady_clock::time_point deadline) const;
+
+private:
+	static const unsigned int SAMPLE_HZ = 10;
+
+	mutable SimulatedStream stream;
 };
 
 } /* namespace resonanz */
@@ -0,0 +1,117 @@
+
+#include "OptimizeCheckpoint.h"
+#include <stdio.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    void OptimizeCheckpoint::clear()
+    {
+      eeg = ModelInfo();
+      stage = NONE;
+      models.clear();
+    }
+
+
+    bool OptimizeCheckpoint::load(const std::string& filename)
+    {
+      FILE* handle = fopen(filename.c_str(), "rt");
+      if(handle == NULL) return false;
+
+      OptimizeCheckpoint c;
+      bool hasEEG = false;
+
+      char line[4096];
+
+      while(fgets(line, sizeof(line), handle) != NULL){
+	unsigned int n = 0, s = 0;
+	unsigned long long h = 0, st = 0;
+	int offset = 0;
+
+	if(sscanf(line, "eeg %u %llx", &n, &h) == 2){
+	  c.eeg.samples = n;
+	  c.eeg.hash = h;
+	  hasEEG = true;
+	}
+	else if(sscanf(line, "stage %u", &s) == 1){
+	  if(s > RELABEL) s = NONE;
+	  c.stage = (Stage)s;
+	}
+	else if(sscanf(line, "trained %u %llx %llx %n", &n, &h, &st, &offset) == 3 && offset > 0){
+	  std::string name = line + offset;
+
+	  while(name.size() > 0 && (name.back() == '\n' || name.back() == '\r'))
+	    name.pop_back();
+
+	  if(name.size() == 0) continue;
+
+	  ModelInfo info;
+	  info.samples = n;
+	  info.hash = h;
+	  info.states = st;
+
+	  c.models[name] = info;
+	}
+      }
+
+      fclose(handle);
+
+      if(hasEEG == false) return false;
+
+      *this = c;
+
+      return true;
+    }
+
+
+    bool OptimizeCheckpoint::save(const std::string& filename) const
+    {
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* handle = fopen(tmpname.c_str(), "wt");
+      if(handle == NULL) return false;
+
+      bool ok = true;
+
+      if(fprintf(handle, "eeg %u %llx\nstage %u\n", eeg.samples, eeg.hash, (unsigned int)stage) <= 0)
+	ok = false;
+
+      for(const auto& m : models){
+	if(fprintf(handle, "trained %u %llx %llx %s\n", m.second.samples, m.second.hash,
+		   m.second.states, m.first.c_str()) <= 0)
+	  ok = false;
+      }
+
+      if(fclose(handle) != 0) ok = false;
+
+      if(ok == false){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+#ifdef _WIN32
+      remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool OptimizeCheckpoint::isCompleted(const std::string& modelFilename, const ModelInfo& info) const
+    {
+      auto i = models.find(modelFilename);
+      if(i == models.end()) return false;
+
+      return i->second.sameData(info);
+    }
+
+  };
+};
@@ -0,0 +1,49 @@
+/*
+ * OptimizeCheckpoint
+ *
+ * checkpoint file of model optimization saved to model directory. records
+ * EEG data the K-Means and HMM models were computed from, how far brain
+ * state modelling got and which prediction models have been completed (with
+ * hashes of the data they were trained with) so that stopped or crashed
+ * optimization can continue where it stopped
+ */
+
+#ifndef OptimizeCheckpoint_h
+#define OptimizeCheckpoint_h
+
+#include <string>
+#include <map>
+
+#include "ModelInfo.h"
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class OptimizeCheckpoint
+    {
+    public:
+
+      // completed steps of brain state modelling
+      enum Stage { NONE = 0, KMEANS = 1, HMM = 2, RELABEL = 3 };
+
+      ModelInfo eeg;        // EEG data used to compute K-Means and HMM
+      Stage stage = NONE;
+
+      std::map<std::string, ModelInfo> models; // completed models (filename => data)
+
+      void clear();
+
+      bool load(const std::string& filename);
+      bool save(const std::string& filename) const; // writes temporary file and renames it
+
+      // model has been completed with the same data
+      bool isCompleted(const std::string& modelFilename, const ModelInfo& info) const;
+
+    };
+
+  };
+};
+
+
+#endif
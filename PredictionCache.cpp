@@ -0,0 +1,194 @@
+
+#include "PredictionCache.h"
+#include <math.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    PredictionCache::PredictionCache(unsigned int capacity_, float grid_)
+    {
+      capacity = capacity_;
+      grid = grid_ > 0.0f ? grid_ : 0.01f;
+      hits = 0;
+      misses = 0;
+    }
+
+    PredictionCache::~PredictionCache()
+    {
+    }
+
+
+    void PredictionCache::setCapacity(unsigned int capacity_)
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+
+      capacity = capacity_;
+
+      while(lru.size() > capacity_){
+	table.erase(lru.back().key);
+	lru.pop_back();
+      }
+    }
+
+
+    unsigned int PredictionCache::getCapacity() const
+    {
+      return capacity;
+    }
+
+
+    bool PredictionCache::setGrid(float grid_)
+    {
+      if(grid_ <= 0.0f) return false;
+
+      std::lock_guard<std::mutex> lock(cache_mutex);
+
+      if(grid != grid_){
+	grid = grid_;
+	lru.clear(); // keys are not valid anymore
+	table.clear();
+      }
+
+      return true;
+    }
+
+
+    float PredictionCache::getGrid() const
+    {
+      return grid;
+    }
+
+
+    void PredictionCache::clear()
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      lru.clear();
+      table.clear();
+    }
+
+
+    void PredictionCache::quantize(const std::vector<float>& eeg, unsigned int state,
+				   std::vector<int>& key) const
+    {
+      key.resize(eeg.size() + 1);
+
+      key[0] = (int)state;
+
+      const float g = grid;
+
+      for(unsigned int i=0;i<eeg.size();i++)
+	key[i+1] = (int)floorf(eeg[i]/g + 0.5f);
+    }
+
+
+    void PredictionCache::make_key(stimulus_type type, unsigned int stimulus,
+				   const std::vector<int>& key, std::vector<int>& k) const
+    {
+      k.resize(key.size() + 2);
+      k[0] = (int)type;
+      k[1] = (int)stimulus;
+
+      for(unsigned int i=0;i<key.size();i++)
+	k[i+2] = key[i];
+    }
+
+
+    bool PredictionCache::lookup(stimulus_type type, unsigned int stimulus,
+				 const std::vector<int>& key,
+				 float* m, float* var, unsigned int dim)
+    {
+      std::vector<int> k;
+      make_key(type, stimulus, key, k);
+
+      std::lock_guard<std::mutex> lock(cache_mutex);
+
+      if(capacity == 0) return false;
+
+      auto i = table.find(k);
+
+      if(i == table.end() || i->second->m.size() != dim){
+	misses++;
+	return false;
+      }
+
+      // moves entry to the front of the LRU list
+      lru.splice(lru.begin(), lru, i->second);
+
+      const entry& e = *(i->second);
+
+      for(unsigned int j=0;j<dim;j++){
+	m[j] = e.m[j];
+	var[j] = e.var[j];
+      }
+
+      hits++;
+
+      return true;
+    }
+
+
+    void PredictionCache::insert(stimulus_type type, unsigned int stimulus,
+				 const std::vector<int>& key,
+				 const float* m, const float* var, unsigned int dim)
+    {
+      std::vector<int> k;
+      make_key(type, stimulus, key, k);
+
+      std::lock_guard<std::mutex> lock(cache_mutex);
+
+      if(capacity == 0) return;
+
+      auto i = table.find(k);
+
+      if(i != table.end()){
+	lru.splice(lru.begin(), lru, i->second);
+      }
+      else{
+	if(lru.size() >= capacity){
+	  table.erase(lru.back().key);
+	  lru.pop_back();
+	}
+
+	entry e;
+	e.key = k;
+	lru.push_front(e);
+	table[k] = lru.begin();
+      }
+
+      entry& e = lru.front();
+      e.m.assign(m, m + dim);
+      e.var.assign(var, var + dim);
+    }
+
+
+    unsigned int PredictionCache::size() const
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      return lru.size();
+    }
+
+
+    float PredictionCache::getHitRate() const
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+
+      const unsigned long long h = hits, n = hits + misses;
+
+      if(n == 0) return 0.0f;
+
+      return ((float)h)/((float)n);
+    }
+
+
+    void PredictionCache::resetStatistics()
+    {
+      std::lock_guard<std::mutex> lock(cache_mutex);
+      hits = 0;
+      misses = 0;
+    }
+
+  };
+};
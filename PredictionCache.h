@@ -0,0 +1,105 @@
+/*
+ * PredictionCache
+ *
+ * LRU cache of stimulus response predictions (mean and variance) keyed by
+ * stimulus, HMM state and EEG values quantized to a grid. EEG values change
+ * slowly compared to engine ticks so the same predictions are computed
+ * again and again. cache must be cleared when models are (re)loaded
+ */
+
+#ifndef PredictionCache_h
+#define PredictionCache_h
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class PredictionCache
+    {
+    public:
+
+      enum stimulus_type { KEYWORD = 0, PICTURE = 1, SOUND = 2 };
+
+      // disabled by default: cached predictions are computed from quantized EEG values
+      PredictionCache(unsigned int capacity = 0, float grid = 0.01f);
+      ~PredictionCache();
+
+      // sets maximum number of cached predictions (0 = cache is disabled)
+      void setCapacity(unsigned int capacity);
+      unsigned int getCapacity() const;
+
+      // sets quantization step of EEG values
+      bool setGrid(float grid);
+      float getGrid() const;
+
+      bool enabled() const { return (capacity > 0); }
+
+      // removes all predictions (models have changed)
+      void clear();
+
+      // quantizes EEG values and HMM state into cache key
+      void quantize(const std::vector<float>& eeg, unsigned int state,
+		    std::vector<int>& key) const;
+
+      // finds prediction of stimulus for quantized key (m and var have dim elements)
+      bool lookup(stimulus_type type, unsigned int stimulus, const std::vector<int>& key,
+		  float* m, float* var, unsigned int dim);
+
+      void insert(stimulus_type type, unsigned int stimulus, const std::vector<int>& key,
+		  const float* m, const float* var, unsigned int dim);
+
+      unsigned int size() const;
+
+      unsigned long long getHits() const { return hits; }
+      unsigned long long getMisses() const { return misses; }
+
+      // hit rate since the last call to resetStatistics()
+      float getHitRate() const;
+
+      void resetStatistics();
+
+    private:
+
+      struct key_hash {
+	size_t operator()(const std::vector<int>& k) const {
+	  size_t h = 14695981039346656037ULL; // FNV-1a
+	  for(const auto& v : k){
+	    h ^= (size_t)(unsigned int)v;
+	    h *= 1099511628211ULL;
+	  }
+	  return h;
+	}
+      };
+
+      struct entry {
+	std::vector<int> key;
+	std::vector<float> m, var;
+      };
+
+      void make_key(stimulus_type type, unsigned int stimulus,
+		    const std::vector<int>& key, std::vector<int>& k) const;
+
+      // read without cache_mutex by enabled(), quantize() and statistics getters
+      std::atomic<unsigned int> capacity;
+      std::atomic<float> grid;
+
+      std::atomic<unsigned long long> hits, misses;
+
+      std::list<entry> lru; // most recently used first
+      std::unordered_map< std::vector<int>, std::list<entry>::iterator, key_hash > table;
+
+      mutable std::mutex cache_mutex;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -0,0 +1,172 @@
+
+#include "PreprocessFolding.h"
+#include <math.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    static bool apply_preprocess(const whiteice::dataset<>& data, unsigned int cluster,
+				 bool inverse, math::vertex<>& v)
+    {
+      if(inverse) return data.invpreprocess(cluster, v);
+      else return data.preprocess(cluster, v);
+    }
+
+
+    bool getPreprocessTransform(const whiteice::dataset<>& data, unsigned int cluster,
+				bool inverse, std::vector<float>& A, std::vector<float>& c)
+    {
+      if(cluster >= data.getNumberOfClusters()) return false;
+
+      const unsigned int dim = data.dimension(cluster);
+
+      if(dim == 0) return false;
+
+      A.resize(dim*dim);
+      c.resize(dim);
+
+      math::vertex<> v(dim);
+      v.zero();
+
+      if(apply_preprocess(data, cluster, inverse, v) == false || v.size() != dim)
+	return false;
+
+      for(unsigned int i=0;i<dim;i++)
+	c[i] = v[i].c[0];
+
+      for(unsigned int j=0;j<dim;j++){
+	v.resize(dim);
+	v.zero();
+	v[j] = 1.0f;
+
+	if(apply_preprocess(data, cluster, inverse, v) == false || v.size() != dim)
+	  return false;
+
+	for(unsigned int i=0;i<dim;i++)
+	  A[i*dim + j] = v[i].c[0] - c[i];
+      }
+
+      // checks that the preprocessing really is affine: f(1) = A*1 + c
+      v.resize(dim);
+      for(unsigned int i=0;i<dim;i++)
+	v[i] = 1.0f;
+
+      if(apply_preprocess(data, cluster, inverse, v) == false || v.size() != dim)
+	return false;
+
+      for(unsigned int i=0;i<dim;i++){
+	float s = c[i];
+	for(unsigned int j=0;j<dim;j++)
+	  s += A[i*dim + j];
+
+	const float t = v[i].c[0];
+
+	if(fabsf(s - t) > 1e-3f*(1.0f + fabsf(t)))
+	  return false;
+      }
+
+      return true;
+    }
+
+
+    bool foldPreprocessing(whiteice::bayesian_nnetwork<>& model,
+			   whiteice::dataset<>& data)
+    {
+      if(data.getNumberOfClusters() != 2) return false;
+
+      const unsigned int I = data.dimension(0);
+      const unsigned int Y = data.dimension(1);
+
+      if(model.inputSize() != I || model.outputSize() != Y) return false;
+
+      std::vector<float> A, c, B, d;
+
+      if(getPreprocessTransform(data, 0, false, A, c) == false) return false;
+      if(getPreprocessTransform(data, 1, true, B, d) == false) return false;
+
+      whiteice::nnetwork<> nn;
+      std::vector< math::vertex<> > samples;
+
+      if(model.exportSamples(nn, samples) == false) return false;
+      if(samples.size() == 0) return false;
+
+      const unsigned int L = nn.getLayers();
+
+      if(L == 0) return false;
+
+      // output transform can be folded only into linear last layer without skip connection
+      if(nn.getNonlinearity(L-1) != whiteice::nnetwork<>::pureLinear) return false;
+      if(nn.getResidual() && L > 1 && nn.getInputs(L-1) == nn.getNeurons(L-1)) return false;
+
+      math::matrix<> W, V;
+      math::vertex<> b, e;
+
+      for(auto& s : samples){
+	if(nn.importdata(s) == false) return false;
+
+	// first layer: W*(A*x + c) + b = (W*A)*x + (W*c + b)
+	if(nn.getWeights(W, 0) == false || nn.getBias(b, 0) == false) return false;
+	if(W.xsize() != I) return false;
+
+	V.resize(W.ysize(), I);
+	e = b;
+
+	for(unsigned int r=0;r<W.ysize();r++){
+	  for(unsigned int j=0;j<I;j++){
+	    float t = 0.0f;
+	    for(unsigned int i=0;i<I;i++)
+	      t += W(r,i).c[0]*A[i*I + j];
+	    V(r,j) = t;
+	  }
+
+	  float t = b[r].c[0];
+	  for(unsigned int i=0;i<I;i++)
+	    t += W(r,i).c[0]*c[i];
+	  e[r] = t;
+	}
+
+	if(nn.setWeights(V, 0) == false || nn.setBias(e, 0) == false) return false;
+
+	// last layer: B*(W*x + b) + d = (B*W)*x + (B*b + d)
+	if(nn.getWeights(W, L-1) == false || nn.getBias(b, L-1) == false) return false;
+	if(W.ysize() != Y) return false;
+
+	V.resize(Y, W.xsize());
+	e = b;
+
+	for(unsigned int r=0;r<Y;r++){
+	  for(unsigned int j=0;j<W.xsize();j++){
+	    float t = 0.0f;
+	    for(unsigned int i=0;i<Y;i++)
+	      t += B[r*Y + i]*W(i,j).c[0];
+	    V(r,j) = t;
+	  }
+
+	  float t = d[r];
+	  for(unsigned int i=0;i<Y;i++)
+	    t += B[r*Y + i]*b[i].c[0];
+	  e[r] = t;
+	}
+
+	if(nn.setWeights(V, L-1) == false || nn.setBias(e, L-1) == false) return false;
+
+	if(nn.exportdata(s) == false) return false;
+      }
+
+      if(model.importSamples(nn, samples) == false) return false;
+
+      // model now works with raw values: data without preprocessing
+      whiteice::dataset<> raw;
+      raw.createCluster(data.getName(0), I);
+      raw.createCluster(data.getName(1), Y);
+
+      data = raw;
+
+      return true;
+    }
+
+  };
+};
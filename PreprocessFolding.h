@@ -0,0 +1,35 @@
+/*
+ * PreprocessFolding
+ *
+ * dataset<> preprocessings used by the prediction models (mean-variance
+ * normalization and PCA) are affine so they can be measured and folded into
+ * the first and last layer weights of bayesian_nnetwork models. after folding
+ * the models take raw EEG values as inputs and output raw responses.
+ */
+
+#ifndef PreprocessFolding_h
+#define PreprocessFolding_h
+
+#include <dinrhiw.h>
+#include <vector>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    // measures cluster's preprocess() (or invpreprocess()) as affine map y = A*x + c
+    // (A is row-major dim x dim matrix). fails if preprocessing is not affine
+    bool getPreprocessTransform(const whiteice::dataset<>& data, unsigned int cluster,
+				bool inverse, std::vector<float>& A, std::vector<float>& c);
+
+    // folds data's input (cluster 0) preprocessing and output (cluster 1) inverse
+    // preprocessing into model's weights. on success data is replaced with an empty
+    // dataset that has the same clusters but no preprocessing (and no data points)
+    bool foldPreprocessing(whiteice::bayesian_nnetwork<>& model,
+			   whiteice::dataset<>& data);
+
+  };
+};
+
+
+#endif
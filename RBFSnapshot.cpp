@@ -0,0 +1,310 @@
+
+#include "RBFSnapshot.h"
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RBF_AVX2_KERNEL
+#endif
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    // sums accumulated outputs: sumw = sum(w), msum[j] = sum(w*y_j),
+    // csum[j*Y+k] = sum(w*y_j*y_k) for k <= j
+
+    static void rbf_scan_scalar(const float* xcols, const float* ycols,
+				unsigned int begin, unsigned int end, unsigned int stride,
+				unsigned int D, unsigned int Y, const float* x, float epsilon,
+				double& sumw, double* msum, double* csum)
+    {
+      for(unsigned int i=begin;i<end;i++){
+	float d2 = 0.0f;
+
+	for(unsigned int j=0;j<D;j++){
+	  const float t = x[j] - xcols[j*stride + i];
+	  d2 += t*t;
+	}
+
+	const float w = 1.0f/(epsilon + sqrtf(d2));
+
+	sumw += w;
+
+	for(unsigned int j=0;j<Y;j++){
+	  const float wy = w*ycols[j*stride + i];
+	  msum[j] += wy;
+
+	  for(unsigned int k=0;k<=j;k++)
+	    csum[j*Y + k] += wy*ycols[k*stride + i];
+	}
+      }
+    }
+
+
+#ifdef RBF_AVX2_KERNEL
+
+    __attribute__((target("avx2,fma")))
+    static double rbf_hsum(__m256 v)
+    {
+      float tmp[8];
+      _mm256_storeu_ps(tmp, v);
+
+      double s = 0.0;
+      for(unsigned int i=0;i<8;i++) s += tmp[i];
+
+      return s;
+    }
+
+
+    __attribute__((target("avx2,fma")))
+    static void rbf_scan_avx2(const float* xcols, const float* ycols,
+			      unsigned int N, unsigned int stride,
+			      unsigned int D, unsigned int Y, const float* x, float epsilon,
+			      double& sumw, double* msum, double* csum)
+    {
+      __m256 xb[RBFSnapshot::MAX_INPUTS];
+      __m256 accm[RBFSnapshot::MAX_OUTPUTS];
+      __m256 accc[RBFSnapshot::MAX_OUTPUTS*RBFSnapshot::MAX_OUTPUTS];
+      __m256 yv[RBFSnapshot::MAX_OUTPUTS];
+
+      for(unsigned int j=0;j<D;j++)
+	xb[j] = _mm256_set1_ps(x[j]);
+
+      __m256 accw = _mm256_setzero_ps();
+
+      for(unsigned int j=0;j<Y;j++){
+	accm[j] = _mm256_setzero_ps();
+	for(unsigned int k=0;k<=j;k++)
+	  accc[j*Y + k] = _mm256_setzero_ps();
+      }
+
+      const __m256 eps = _mm256_set1_ps(epsilon);
+      const __m256 one = _mm256_set1_ps(1.0f);
+
+      unsigned int i = 0;
+
+      for(;i+8<=N;i+=8){
+	__m256 d2 = _mm256_setzero_ps();
+
+	for(unsigned int j=0;j<D;j++){
+	  const __m256 t = _mm256_sub_ps(xb[j], _mm256_loadu_ps(xcols + j*stride + i));
+	  d2 = _mm256_fmadd_ps(t, t, d2);
+	}
+
+	const __m256 w = _mm256_div_ps(one, _mm256_add_ps(eps, _mm256_sqrt_ps(d2)));
+
+	accw = _mm256_add_ps(accw, w);
+
+	for(unsigned int j=0;j<Y;j++)
+	  yv[j] = _mm256_loadu_ps(ycols + j*stride + i);
+
+	for(unsigned int j=0;j<Y;j++){
+	  const __m256 wy = _mm256_mul_ps(w, yv[j]);
+	  accm[j] = _mm256_add_ps(accm[j], wy);
+
+	  for(unsigned int k=0;k<=j;k++)
+	    accc[j*Y + k] = _mm256_fmadd_ps(wy, yv[k], accc[j*Y + k]);
+	}
+      }
+
+      sumw += rbf_hsum(accw);
+
+      for(unsigned int j=0;j<Y;j++){
+	msum[j] += rbf_hsum(accm[j]);
+	for(unsigned int k=0;k<=j;k++)
+	  csum[j*Y + k] += rbf_hsum(accc[j*Y + k]);
+      }
+
+      // remaining (N mod 8) rows
+      rbf_scan_scalar(xcols, ycols, i, N, stride, D, Y, x, epsilon, sumw, msum, csum);
+    }
+
+#endif
+
+
+    RBFSnapshot::RBFSnapshot()
+    {
+    }
+
+    RBFSnapshot::~RBFSnapshot()
+    {
+    }
+
+
+    bool RBFSnapshot::build(const whiteice::dataset<>& data)
+    {
+      clear();
+
+      if(data.getNumberOfClusters() != 2) return false;
+      if(data.size(0) != data.size(1)) return false;
+      if(data.dimension(0) > MAX_INPUTS || data.dimension(1) > MAX_OUTPUTS)
+	return false;
+
+      N = data.size(0);
+      D = data.dimension(0);
+      Y = data.dimension(1);
+      stride = ((N + 7)/8)*8;
+
+      xcols.resize(D*stride);
+      ycols.resize(Y*stride);
+
+      for(auto& v : xcols) v = 0.0f;
+      for(auto& v : ycols) v = 0.0f;
+
+      for(unsigned int i=0;i<N;i++){
+	const auto& x = data.access(0, i);
+	const auto& y = data.access(1, i);
+
+	for(unsigned int j=0;j<D && j<x.size();j++)
+	  xcols[j*stride + i] = x[j].c[0];
+
+	for(unsigned int j=0;j<Y && j<y.size();j++)
+	  ycols[j*stride + i] = y[j].c[0];
+      }
+
+      if(index.build(data, 0) == false){
+	clear();
+	return false;
+      }
+
+      return true;
+    }
+
+
+    void RBFSnapshot::clear()
+    {
+      N = 0;
+      D = 0;
+      Y = 0;
+      stride = 0;
+      xcols.clear();
+      ycols.clear();
+      index.clear();
+    }
+
+
+    bool RBFSnapshot::hasSIMD()
+    {
+#ifdef RBF_AVX2_KERNEL
+      static const bool avx2 = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+      return avx2;
+#else
+      return false;
+#endif
+    }
+
+
+    bool RBFSnapshot::estimate(const float* x, float* m, float* cov) const
+    {
+      if(N == 0 || x == nullptr || m == nullptr || cov == nullptr)
+	return false;
+
+      double sumw = 0.0;
+      double msum[MAX_OUTPUTS];
+      double csum[MAX_OUTPUTS*MAX_OUTPUTS];
+
+      for(unsigned int j=0;j<Y;j++) msum[j] = 0.0;
+      for(unsigned int j=0;j<Y*Y;j++) csum[j] = 0.0;
+
+#ifdef RBF_AVX2_KERNEL
+      if(hasSIMD())
+	rbf_scan_avx2(&(xcols[0]), &(ycols[0]), N, stride, D, Y, x, epsilon, sumw, msum, csum);
+      else
+#endif
+	rbf_scan_scalar(&(xcols[0]), &(ycols[0]), 0, N, stride, D, Y, x, epsilon, sumw, msum, csum);
+
+      finish(sumw, msum, csum, m, cov);
+
+      return true;
+    }
+
+
+    bool RBFSnapshot::estimate(const float* x, unsigned int k, float radius, float approx,
+			       float* m, float* cov) const
+    {
+      if(N == 0 || x == nullptr || m == nullptr || cov == nullptr)
+	return false;
+
+      if(k == 0 && radius <= 0.0f)
+	return estimate(x, m, cov);
+
+      double sumw = 0.0;
+      double msum[MAX_OUTPUTS];
+      double csum[MAX_OUTPUTS*MAX_OUTPUTS];
+
+      for(unsigned int j=0;j<Y;j++) msum[j] = 0.0;
+      for(unsigned int j=0;j<Y*Y;j++) csum[j] = 0.0;
+
+      std::pair<float, unsigned int> heap[MAX_NEIGHBOURS];
+      unsigned int found = 0;
+
+      std::vector<unsigned int> rindices;
+      std::vector<float> rdistances;
+
+      if(radius > 0.0f){
+	index.radius(x, radius, rindices, rdistances);
+
+	for(unsigned int n=0;n<rindices.size();n++){
+	  const unsigned int i = rindices[n];
+	  const float w = 1.0f/(epsilon + sqrtf(rdistances[n]));
+
+	  sumw += w;
+
+	  for(unsigned int j=0;j<Y;j++){
+	    const float wy = w*ycols[j*stride + i];
+	    msum[j] += wy;
+	    for(unsigned int l=0;l<=j;l++)
+	      csum[j*Y + l] += wy*ycols[l*stride + i];
+	  }
+	}
+      }
+
+      if(sumw <= 0.0 && k > 0){
+	if(k > MAX_NEIGHBOURS) k = MAX_NEIGHBOURS;
+
+	found = index.knearest(x, k, approx, heap);
+
+	for(unsigned int n=0;n<found;n++){
+	  const unsigned int i = heap[n].second;
+	  const float w = 1.0f/(epsilon + sqrtf(heap[n].first));
+
+	  sumw += w;
+
+	  for(unsigned int j=0;j<Y;j++){
+	    const float wy = w*ycols[j*stride + i];
+	    msum[j] += wy;
+	    for(unsigned int l=0;l<=j;l++)
+	      csum[j*Y + l] += wy*ycols[l*stride + i];
+	  }
+	}
+      }
+
+      if(sumw <= 0.0)
+	return estimate(x, m, cov); // no neighbours found => uses all data
+
+      finish(sumw, msum, csum, m, cov);
+
+      return true;
+    }
+
+
+    void RBFSnapshot::finish(double sumw, const double* msum, const double* csum,
+			     float* m, float* cov) const
+    {
+      for(unsigned int j=0;j<Y;j++)
+	m[j] = (float)(msum[j]/sumw);
+
+      for(unsigned int j=0;j<Y;j++){
+	for(unsigned int k=0;k<=j;k++){
+	  const float c = (float)(csum[j*Y + k]/sumw) - m[j]*m[k];
+	  cov[j*Y + k] = c;
+	  cov[k*Y + j] = c;
+	}
+      }
+    }
+
+  };
+};
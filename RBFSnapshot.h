@@ -0,0 +1,78 @@
+/*
+ * RBFSnapshot
+ *
+ * contiguous float structure-of-arrays copy of a (preprocessed) dataset<>
+ * used by the RBF response predictor. estimates weighted mean and
+ * covariance of the outputs without heap allocations using AVX2 kernel
+ * (if CPU supports it) or a scalar fallback
+ */
+
+#ifndef RBFSnapshot_h
+#define RBFSnapshot_h
+
+#include <dinrhiw.h>
+#include <vector>
+
+#include "KDTree.h"
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class RBFSnapshot
+    {
+    public:
+
+      static const unsigned int MAX_INPUTS = 64;
+      static const unsigned int MAX_OUTPUTS = 16;
+      static const unsigned int MAX_NEIGHBOURS = 512;
+
+      RBFSnapshot();
+      ~RBFSnapshot();
+
+      // copies dataset (two clusters: input and output) and builds search index
+      bool build(const whiteice::dataset<>& data);
+
+      void clear();
+
+      unsigned int size() const { return N; }
+      unsigned int inputs() const { return D; }
+      unsigned int outputs() const { return Y; }
+
+      const KDTree& getIndex() const { return index; }
+
+      // estimates weighted output mean m[Y] and covariance cov[Y*Y] (row-major)
+      // at x[D] using all data points. weights are 1/(epsilon + ||x - x_i||)
+      bool estimate(const float* x, float* m, float* cov) const;
+
+      // estimates mean and covariance using only k nearest neighbours or
+      // points within radius (if radius > 0). approx is nearest neighbour search
+      // error bound. radius search is not allocation free
+      bool estimate(const float* x, unsigned int k, float radius, float approx,
+		    float* m, float* cov) const;
+
+      // returns true if AVX2 kernel is used
+      static bool hasSIMD();
+
+    private:
+
+      void finish(double sumw, const double* msum, const double* csum,
+		  float* m, float* cov) const;
+
+      unsigned int N = 0, D = 0, Y = 0;
+      unsigned int stride = 0; // column length (N rounded up to multiple of 8)
+
+      std::vector<float> xcols; // D columns of inputs
+      std::vector<float> ycols; // Y columns of outputs
+
+      KDTree index;
+
+      const float epsilon = 0.01f;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -13,8 +13,8 @@
 namespace whiteice {
 namespace resonanz {
 
-RandomEEG::RandomEEG() {
-
+RandomEEG::RandomEEG() :
+	stream(6, SAMPLE_HZ, [this](std::vector<float>& x){ return data(x); }) {
 }
 
 RandomEEG::~RandomEEG() {
@@ -79,5 +79,27 @@ unsigned int RandomEEG::getNumberOfSignals() const
 
 
 
+bool RandomEEG::readSince(unsigned long long& cursor,
+		std::vector<std::chrono::steady_clock::time_point>& times,
+		std::vector< std::vector<float> >& x) const
+{
+	return stream.readSince(cursor, times, x);
+}
+
+
+unsigned long long RandomEEG::getSampleCursor() const
+{
+	return stream.getCursor();
+}
+
+
+bool RandomEEG::waitForSample(unsigned long long cursor,
+		std::chrono::steady_clock::time_point deadline) const
+{
+	return stream.waitForSample(cursor, deadline);
+}
+
+
+
 } /* namespace resonanz */
 } /* namespace whiteice */
@@ -9,6 +9,7 @@
 #define RANDOMEEG_H_
 
 #include "DataSource.h"
+#include "SimulatedStream.h"
 
 namespace whiteice {
 namespace resonanz {
@@ -34,6 +35,23 @@ public:
 	virtual bool getSignalNames(std::vector<std::string>& names) const;
 
 	virtual unsigned int getNumberOfSignals() const;
+
+	/**
+	 * sample stream of values generated at SAMPLE_HZ
+	 */
+	virtual bool readSince(unsigned long long& cursor,
+			std::vector<std::chrono::steady_clock::time_point>& times,
+			std::vector< std::vector<float> >& samples) const;
+
+	virtual unsigned long long getSampleCursor() const;
+
+	virtual bool waitForSample(unsigned long long cursor,
+			std::chrono::steady_clock::time_point deadline) const;
+
+private:
+	static const unsigned int SAMPLE_HZ = 10;
+
+	mutable SimulatedStream stream;
 };
 
 } /* namespace resonanz */
@@ -0,0 +1,217 @@
+
+#include "RenderThread.h"
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    RenderThread::RenderThread(opener open, renderer draw, presenter show,
+			       pump events, closer close)
+    {
+      openWindow = open;
+      drawScene = draw;
+      showScene = show;
+      pumpEvents = events;
+      closeWindow = close;
+      presented = 0;
+      dropped = 0;
+    }
+
+
+    RenderThread::~RenderThread()
+    {
+      this->stop();
+    }
+
+
+    bool RenderThread::start()
+    {
+      if(!openWindow || !drawScene || !showScene || !pumpEvents || !closeWindow)
+	return false;
+
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running){
+	return false; // thread is already running
+      }
+
+      {
+	std::lock_guard<std::mutex> slock(scene_mutex);
+	opened = 0;
+	pending = false;
+      }
+
+      try{
+	thread_running = true;
+	if(render_thread){ delete render_thread; render_thread = nullptr; }
+	render_thread = new std::thread(std::bind(&RenderThread::render_loop, this));
+      }
+      catch(std::exception& e){
+	thread_running = false;
+	render_thread = nullptr;
+	return false;
+      }
+
+      // waits until window is open so caller can use its size and font
+      bool ok = false;
+
+      {
+	std::unique_lock<std::mutex> slock(scene_mutex);
+	scene_cond.wait(slock, [this](){ return (opened != 0); });
+	ok = (opened > 0);
+      }
+
+      if(ok == false){
+	render_thread->join();
+	delete render_thread;
+	render_thread = nullptr;
+	thread_running = false;
+      }
+
+      return ok;
+    }
+
+
+    bool RenderThread::isRunning()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running && render_thread != nullptr)
+	return true;
+      else
+	return false;
+    }
+
+
+    bool RenderThread::stop()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running == false)
+	return false;
+
+      {
+	std::lock_guard<std::mutex> slock(scene_mutex);
+	thread_running = false;
+	scene_cond.notify_all();
+      }
+
+      {
+	std::lock_guard<std::mutex> plock(presented_mutex);
+	presented_cond.notify_all();
+      }
+
+      if(render_thread){
+	render_thread->join();
+	delete render_thread;
+      }
+
+      render_thread = nullptr;
+
+      return true;
+    }
+
+
+    unsigned long long RenderThread::post(const std::string& message,
+					  unsigned int picture, long long tick)
+    {
+      std::lock_guard<std::mutex> lock(scene_mutex);
+
+      if(pending)
+	dropped++; // renderer was too slow to show the previous scene
+
+      // reuses slot (and its message buffer)
+      RenderScene& s = scenes[back];
+      s.message = message;
+      s.picture = picture;
+      s.tick = tick;
+      s.sequence = ++sequence;
+
+      pending = true;
+      scene_cond.notify_one();
+
+      return s.sequence;
+    }
+
+
+    bool RenderThread::waitPresented(unsigned long long seq, clock::time_point t)
+    {
+      std::unique_lock<std::mutex> lock(presented_mutex);
+
+      presented_cond.wait_until(lock, t, [this, seq](){
+	  return (presentedSequence >= seq || thread_running == false);
+	});
+
+      return (presentedSequence >= seq);
+    }
+
+
+    bool RenderThread::getPresented(unsigned long long& seq, clock::time_point& t) const
+    {
+      std::lock_guard<std::mutex> lock(presented_mutex);
+
+      if(presentedSequence == 0) return false;
+
+      seq = presentedSequence;
+      t = presentedTime;
+
+      return true;
+    }
+
+
+    void RenderThread::render_loop()
+    {
+      const bool ok = openWindow();
+
+      {
+	std::lock_guard<std::mutex> lock(scene_mutex);
+	opened = ok ? 1 : -1;
+	scene_cond.notify_all();
+      }
+
+      if(ok == false){
+	closeWindow();
+	return;
+      }
+
+      while(thread_running){
+	pumpEvents();
+
+	const RenderScene* s = nullptr;
+
+	{
+	  std::unique_lock<std::mutex> lock(scene_mutex);
+
+	  if(pending == false){
+	    // wakes up regularly to handle window events
+	    scene_cond.wait_for(lock, std::chrono::milliseconds(EVENT_POLL_MS), [this](){
+		return (pending || thread_running == false);
+	      });
+	  }
+
+	  if(pending && thread_running){
+	    // front slot becomes the back slot for the next post()
+	    s = &scenes[back];
+	    back = 1 - back;
+	    pending = false;
+	  }
+	}
+
+	if(s == nullptr) continue;
+
+	if(drawScene(*s) && showScene()){
+	  std::lock_guard<std::mutex> plock(presented_mutex);
+	  presentedSequence = s->sequence;
+	  presentedTime = clock::now();
+	  presented++;
+	  presented_cond.notify_all();
+	}
+      }
+
+      closeWindow();
+    }
+
+  };
+};
@@ -0,0 +1,126 @@
+/*
+ * RenderThread
+ *
+ * owns the stimulus window: opens it, draws and presents scenes and handles
+ * window events in a separate thread so that slow drawing doesn't delay
+ * computation or EEG sampling and slow computation doesn't freeze the
+ * display (SDL window functions are only called from the thread that
+ * created the window). the engine only posts scenes.
+ *
+ * scenes are passed through a preallocated double buffer: post() writes
+ * the back slot and the thread swaps it with the front slot it draws. a new
+ * scene replaces the previous one if it has not been drawn yet. the time
+ * when each scene was actually presented is recorded
+ */
+
+#ifndef RenderThread_h
+#define RenderThread_h
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    struct RenderScene
+    {
+      std::string message;
+      unsigned int picture = 0;
+      long long tick = 0;            // engine tick when scene was posted
+      unsigned long long sequence = 0;
+    };
+
+
+    class RenderThread
+    {
+    public:
+
+      typedef std::chrono::steady_clock clock;
+
+      // opens window, returns false if thread cannot draw anything
+      typedef std::function<bool ()> opener;
+
+      // draws scene to window surface, returns false if nothing was drawn
+      typedef std::function<bool (const RenderScene& scene)> renderer;
+
+      // shows the drawn window surface
+      typedef std::function<bool ()> presenter;
+
+      // handles pending window events
+      typedef std::function<void ()> pump;
+
+      // closes window
+      typedef std::function<void ()> closer;
+
+      // all functions are called from the render thread
+      RenderThread(opener open, renderer draw, presenter show, pump events, closer close);
+      ~RenderThread();
+
+      // starts thread and waits until it has opened the window
+      bool start();
+
+      bool isRunning();
+
+      // stops thread after it has closed the window
+      bool stop();
+
+      // posts scene to be drawn (replaces undrawn scene). returns sequence number of the scene
+      unsigned long long post(const std::string& message, unsigned int picture, long long tick);
+
+      // waits until scene with given sequence number (or a newer one) is presented or time t
+      bool waitPresented(unsigned long long sequence, clock::time_point t);
+
+      // latest presented scene and its presentation time (false if nothing is presented)
+      bool getPresented(unsigned long long& sequence, clock::time_point& t) const;
+
+      // statistics
+      unsigned long long getPresentedCount() const { return presented; }
+      unsigned long long getDroppedCount() const { return dropped; }
+
+    private:
+
+      void render_loop();
+
+      // window events are handled at least this often
+      static const unsigned int EVENT_POLL_MS = 10;
+
+      opener openWindow;
+      renderer drawScene;
+      presenter showScene;
+      pump pumpEvents;
+      closer closeWindow;
+
+      std::mutex thread_mutex;
+      std::atomic<bool> thread_running { false };
+      std::thread* render_thread = nullptr;
+
+      // double buffer: post() writes scenes[back], thread draws the other slot
+      std::mutex scene_mutex;
+      std::condition_variable scene_cond;
+      RenderScene scenes[2];
+      unsigned int back = 0;
+      bool pending = false;          // scenes[back] has not been drawn
+      int opened = 0;                // 0 = opening, 1 = window open, -1 = failed
+      unsigned long long sequence = 0;
+
+      mutable std::mutex presented_mutex;
+      std::condition_variable presented_cond;
+      unsigned long long presentedSequence = 0;
+      clock::time_point presentedTime;
+
+      std::atomic<unsigned long long> presented;
+      std::atomic<unsigned long long> dropped;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -6,6 +6,7 @@
  */
 
 #include "ResonanzEngine.h"
+#include <algorithm>
 #include <chrono>
 #include <exception>
 #include <iostream>
@@ -162,6 +163,14 @@ ResonanzEngine::~ResonanzEngine()
   delete workerThread;
   workerThread = nullptr;
   
+  if(speculator){
+    speculator->stop();
+    delete speculator;
+    speculator = nullptr;
+  }
+
+  engine_stopTracker();
+
   if(eeg != nullptr){
     std::lock_guard<std::mutex> lock(eeg_mutex);
     delete eeg;
@@ -452,6 +461,7 @@ bool ResonanzEngine::keypress(){
 
 bool ResonanzEngine::setEEGDeviceType(int deviceNumber)
 {
+  std::lock_guard<std::mutex> lock0(eeg_wait_mutex);
   std::lock_guard<std::mutex> lock1(eeg_mutex);
   
   try{
@@ -772,6 +782,110 @@ bool ResonanzEngine::setParameter(const std::string& parameter, const std::strin
       whiteice::logging.setPrintOutput(false);
     }
   }
+  else if(parameter == "rbf-neighbours"){
+    const int k = atoi(value.c_str());
+    if(k < 0) return false;
+    rbfNeighbours = (unsigned int)k;
+    return true;
+  }
+  else if(parameter == "rbf-radius"){
+    const float r = (float)atof(value.c_str());
+    if(r < 0.0f) return false;
+    rbfRadius = r;
+    return true;
+  }
+  else if(parameter == "rbf-approximation"){
+    const float e = (float)atof(value.c_str());
+    if(e < 0.0f) return false;
+    rbfEpsilon = e;
+    return true;
+  }
+  else if(parameter == "planner-depth"){
+    const int d = atoi(value.c_str());
+    if(d < 0) return false;
+    plannerDepth = (unsigned int)d;
+    return planner.setParameters(plannerDepth, plannerBeam);
+  }
+  else if(parameter == "planner-beam"){
+    const int b = atoi(value.c_str());
+    if(b <= 0) return false;
+    plannerBeam = (unsigned int)b;
+    return planner.setParameters(plannerDepth, plannerBeam);
+  }
+  else if(parameter == "planner-budget-ms"){
+    const int ms = atoi(value.c_str());
+    if(ms < 0) return false;
+    plannerBudgetMs = (unsigned int)ms;
+    return true;
+  }
+  else if(parameter == "render-thread"){
+    if(value == "true"){
+      renderThreaded = true;
+    }
+    else if(value == "false"){
+      renderThreaded = false;
+    }
+    else return false;
+    
+    return true;
+  }
+  else if(parameter == "speculative-execute"){
+    if(value == "true"){
+      speculativeExecute = true;
+    }
+    else if(value == "false"){
+      speculativeExecute = false;
+    }
+    else return false;
+    
+    return true;
+  }
+  else if(parameter == "response-shortlist"){
+    const int k = atoi(value.c_str());
+    if(k < 0) return false;
+    responseShortlist = (unsigned int)k;
+    return true;
+  }
+  else if(parameter == "selection-budget-ms"){
+    const int ms = atoi(value.c_str());
+    if(ms < 0) return false;
+    selectionBudgetMs = (unsigned int)ms;
+    return true;
+  }
+  else if(parameter == "eeg-retention"){
+    EEGRetention::Policy policy;
+    if(EEGRetention::parsePolicy(value, policy) == false) return false;
+    
+    // row limit must be set before the policy
+    return eegRetention.setPolicy(policy, eegRetention.getMaxRows(), eegRetention.getHalfLife());
+  }
+  else if(parameter == "eeg-retention-rows"){
+    const int n = atoi(value.c_str());
+    if(n < 500) return false; // HMM optimization needs at least 500 samples
+    return eegRetention.setPolicy(eegRetention.getPolicy(), (unsigned int)n, eegRetention.getHalfLife());
+  }
+  else if(parameter == "eeg-retention-halflife-days"){
+    const double days = atof(value.c_str());
+    if(days < 0.0) return false;
+    return eegRetention.setPolicy(eegRetention.getPolicy(), eegRetention.getMaxRows(), days*24.0*3600.0);
+  }
+  else if(parameter == "prediction-cache-size"){
+    const int n = atoi(value.c_str());
+    if(n < 0) return false;
+    predictionCache.setCapacity((unsigned int)n);
+    return true;
+  }
+  else if(parameter == "prediction-cache-grid"){
+    const float g = (float)atof(value.c_str());
+    if(predictionCache.setGrid(g) == false) return false;
+    return planner.setGrid(g); // planner keeps its predictions with the same grid
+  }
+  else if(parameter == "optimize-concurrency"){
+    const int n = atoi(value.c_str());
+    if(n < 0) return false;
+    optimizeConcurrency = (unsigned int)n;
+    return true;
+  }
   else if(parameter == "random-programs"){
     if(value == "true"){
       randomPrograms = true;
@@ -806,13 +920,7 @@ void ResonanzEngine::engine_loop()
   }
 #endif
   
-  long long tickStartTime = 0;
-  {
-    auto t1 = std::chrono::system_clock::now().time_since_epoch();
-    auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
-    
-    tickStartTime = t1ms;
-  }
+  ticker.reset();
   
   long long lastTickProcessed = -1;
   tick = 0;
@@ -843,7 +951,7 @@ void ResonanzEngine::engine_loop()
   long long lastProgramSecond = 0LL;
   unsigned int eegConnectionDownTime = 0;
 
-  long long lastHMMStateUpdateMS = 0; // last time HMM model has been updated
+  long long lastHMMStateUpdateMS = -(long long)MEASUREMODE_DELAY_MS; // last time HMM model has been updated
   HMMstate = 0;
   
   std::vector<float> eegCurrent;
@@ -882,15 +990,18 @@ void ResonanzEngine::engine_loop()
   
   while(thread_is_running){
     
-    // sleeps until there is a new engine tick
-    while(lastTickProcessed >= tick){
-      auto t1 = std::chrono::system_clock::now().time_since_epoch();
-      auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
+    // sleeps until the start of the next engine tick (absolute deadline)
+    {
+      tick = ticker.wait(lastTickProcessed);
       
-      auto currentTick = (t1ms - tickStartTime)/TICK_MS;
+      const auto t1ms = ticker.getMilliseconds();
 
       // UPDATE HMM STATE
-      {
+      if(hmmTracker != nullptr){
+	// tracker thread follows EEG samples and publishes the most probable state
+	HMMstate = hmmTracker->getState();
+      }
+      else{
 	const auto timeSinceLastUpdateMS = ((long long)t1ms) - lastHMMStateUpdateMS;
 	
 	if(timeSinceLastUpdateMS >= MEASUREMODE_DELAY_MS){
@@ -921,11 +1032,6 @@ void ResonanzEngine::engine_loop()
 	}
 	
       }
-      
-      if(tick < currentTick)
-	tick = currentTick;
-      else
-	engine_sleep(TICK_MS/10);
     }
     
     lastTickProcessed = tick;
@@ -935,6 +1041,12 @@ void ResonanzEngine::engine_loop()
     ResonanzCommand prevCommand = currentCommand;
     if(engine_checkIncomingCommand() == true){
       logging.info("new engine command received");
+      
+      // window, font, images and video change during state transitions
+      engine_stopRenderer();
+      
+      // HMM models and EEG device may change during state transitions
+      engine_stopTracker();
       // we must make engine state transitions, state transfer from the previous command to the new command
       
       // state exit actions:
@@ -954,7 +1066,7 @@ void ResonanzEngine::engine_loop()
 
 	// stops encoding if needed
 	if(video != nullptr){
-	  auto t1 = std::chrono::system_clock::now().time_since_epoch();
+	  auto t1 = TickScheduler::clock::now().time_since_epoch();
 	  auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
 	  
 	  logging.info("stopping theora video encoding.");
@@ -974,17 +1086,34 @@ void ResonanzEngine::engine_loop()
 	  logging.info("stop synth");
 	}
 	
-	engine_setStatus("resonanz-engine: saving database..");
-	if(engine_saveDatabase(prevCommand.modelDir) == false){
-	  logging.error("saving database failed");
+	// measurements are already in the journal: datasets are rewritten only when
+	// journal has grown large (or it couldn't be written)
+	if(measurementJournal.isOpen() && measurementJournal.sync() &&
+	   measurementJournal.getRecords() < JOURNAL_COMPACT_RECORDS){
+	  char buffer[128];
+	  snprintf(buffer, 128, "measurements saved to journal (%d records)",
+		   measurementJournal.getRecords());
+	  logging.info(buffer);
 	}
 	else{
-	  logging.error("saving database successful");
+	  engine_setStatus("resonanz-engine: saving database..");
+	  if(engine_saveDatabase(prevCommand.modelDir) == false){
+	    logging.error("saving database failed");
+	  }
+	  else{
+	    logging.error("saving database successful");
+	  }
 	}
 	
+	measurementJournal.close();
+	
 	keywordData.clear();
 	pictureData.clear();
 	eegData.clear();
+	keywordIndex.clear();
+	pictureIndex.clear();
+	keywordResponses.clear();
+	pictureResponses.clear();
 	
       }
       else if(prevCommand.command == ResonanzCommand::CMD_DO_OPTIMIZE){
@@ -1008,16 +1137,10 @@ void ResonanzEngine::engine_loop()
 	  kmeans = nullptr;
 	}
 	
-	if(optimizer != nullptr){
-	  optimizer->stopComputation();
-	  delete optimizer;
-	  optimizer = nullptr;
-	}
-	
-	if(bayes_optimizer != nullptr){
-	  bayes_optimizer->stopSampler();
-	  delete bayes_optimizer;
-	  bayes_optimizer = nullptr;
+	if(trainer != nullptr){
+	  trainer->stop(); // unfinished models are saved as .partial.model snapshots
+	  delete trainer;
+	  trainer = nullptr;
 	}
 
 	// also saves database because preprocessing parameters may have changed
@@ -1032,6 +1155,10 @@ void ResonanzEngine::engine_loop()
 	keywordData.clear();
 	pictureData.clear();
 	eegData.clear();
+	keywordIndex.clear();
+	pictureIndex.clear();
+	keywordResponses.clear();
+	pictureResponses.clear();
       }
       else if(prevCommand.command == ResonanzCommand::CMD_DO_EXECUTE){
 	// stop playing sound
@@ -1040,10 +1167,17 @@ void ResonanzEngine::engine_loop()
 	  synth->reset();
 	}
 
+	// background precomputation uses models and must stop first
+	if(speculator != nullptr){
+	  speculator->stop();
+	  delete speculator;
+	  speculator = nullptr;
+	}
+
 	if(hmmUpdator != nullptr){
 	  hmmUpdator->stop();
 	  delete hmmUpdator;
-	  hmmUpdaor = nullptr;
+	  hmmUpdator = nullptr;
 	}
 
 	if(hmm != nullptr){
@@ -1061,8 +1195,15 @@ void ResonanzEngine::engine_loop()
 	keywordData.clear();
 	pictureData.clear();
 	eegData.clear();
+	keywordIndex.clear();
+	pictureIndex.clear();
+	keywordResponses.clear();
+	pictureResponses.clear();
 	keywordModels.clear();
 	pictureModels.clear();
+	keywordBatch.clear();
+	pictureBatch.clear();
+	predictionCache.clear();
 
 	if(prevCommand.audioFile.length() > 0){
 	  logging.info("stop audio file playback");
@@ -1074,7 +1215,7 @@ void ResonanzEngine::engine_loop()
 	
 	// stops encoding if needed
 	if(video != nullptr){
-	  auto t1 = std::chrono::system_clock::now().time_since_epoch();
+	  auto t1 = TickScheduler::clock::now().time_since_epoch();
 	  auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
 	  
 	  logging.info("stopping theora video encoding.");
@@ -1097,114 +1238,13 @@ void ResonanzEngine::engine_loop()
       // state exit/entry actions:
       
       // checks if we want to have open graphics window and opens one if needed
-      if(currentCommand.showScreen == true && prevCommand.showScreen == false){
-	if(window != nullptr) SDL_DestroyWindow(window);
-	
-	SDL_DisplayMode mode;
-	
-	if(SDL_GetCurrentDisplayMode(0, &mode) == 0){
-	  SCREEN_WIDTH = mode.w;
-	  SCREEN_HEIGHT = mode.h;
-	}
-	
-	if(fullscreen){
-	  window = SDL_CreateWindow(windowTitle.c_str(),
-				    SDL_WINDOWPOS_CENTERED,
-				    SDL_WINDOWPOS_CENTERED,
-				    SCREEN_WIDTH, SCREEN_HEIGHT,
-				    SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN_DESKTOP);
-	}
-	else{
-	  window = SDL_CreateWindow(windowTitle.c_str(),
-				    SDL_WINDOWPOS_CENTERED,
-				    SDL_WINDOWPOS_CENTERED,
-				    (3*SCREEN_WIDTH)/4, (3*SCREEN_HEIGHT)/4,
-				    SDL_WINDOW_SHOWN);
-	}
-	
-	if(window != nullptr){
-	  SDL_GetWindowSize(window, &SCREEN_WIDTH, &SCREEN_HEIGHT);
-	  if(font) TTF_CloseFont(font);
-	  double fontSize = 100.0*sqrt(((float)(SCREEN_WIDTH*SCREEN_HEIGHT))/(640.0*480.0));
-	  unsigned int fs = (unsigned int)fontSize;
-	  if(fs <= 0) fs = 10;
-	  
-	  font = 0;
-	  font = TTF_OpenFont(fontname.c_str(), fs);
-	  
-	  
-	  SDL_Surface* icon = IMG_Load(iconFile.c_str());
-	  if(icon != nullptr){
-	    SDL_SetWindowIcon(window, icon);
-	    SDL_FreeSurface(icon);
-	  }
-	  
-	  SDL_Surface* surface = SDL_GetWindowSurface(window);
-	  SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0, 0, 0));
-	  SDL_RaiseWindow(window);
-	  // SDL_SetWindowGrab(window, SDL_TRUE);
-	  SDL_UpdateWindowSurface(window);
-	  SDL_RaiseWindow(window);
-	  // SDL_SetWindowGrab(window, SDL_FALSE);
-	}
-
-      }
-      else if(currentCommand.showScreen == true && prevCommand.showScreen == true){
-	// just empties current window with blank (black) screen
-	
-	SDL_DisplayMode mode;
-	
-	if(SDL_GetCurrentDisplayMode(0, &mode) == 0){
-	  SCREEN_WIDTH = mode.w;
-	  SCREEN_HEIGHT = mode.h;
-	}
-	
-	if(window == nullptr){
-	  if(fullscreen){
-	    window = SDL_CreateWindow(windowTitle.c_str(),
-				      SDL_WINDOWPOS_CENTERED,
-				      SDL_WINDOWPOS_CENTERED,
-				      SCREEN_WIDTH, SCREEN_HEIGHT,
-				      SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN_DESKTOP);
-	  }
-	  else{
-	    window = SDL_CreateWindow(windowTitle.c_str(),
-				      SDL_WINDOWPOS_CENTERED,
-				      SDL_WINDOWPOS_CENTERED,
-				      (3*SCREEN_WIDTH)/4, (3*SCREEN_HEIGHT)/4,
-				      SDL_WINDOW_SHOWN);
-	  }
-	}
-	
-	if(window != nullptr){
-	  SDL_GetWindowSize(window, &SCREEN_WIDTH, &SCREEN_HEIGHT);
-	  if(font) TTF_CloseFont(font);
-	  double fontSize = 100.0*sqrt(((float)(SCREEN_WIDTH*SCREEN_HEIGHT))/(640.0*480.0));
-	  unsigned int fs = (unsigned int)fontSize;
-	  if(fs <= 0) fs = 10;
-	  
-	  font = 0;
-	  font = TTF_OpenFont(fontname.c_str(), fs);
-	  
-	  SDL_Surface* icon = IMG_Load(iconFile.c_str());
-	  if(icon != nullptr){
-	    SDL_SetWindowIcon(window, icon);
-	    SDL_FreeSurface(icon);
-	  }
-	  
-	  SDL_Surface* surface = SDL_GetWindowSurface(window);
-	  SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0, 0, 0));
-	  SDL_RaiseWindow(window);
-	  // SDL_SetWindowGrab(window, SDL_TRUE);
-	  SDL_UpdateWindowSurface(window);
-	  SDL_RaiseWindow(window);
-	  // SDL_SetWindowGrab(window, SDL_FALSE);
-	}
-	
+      // (render thread opens and owns its window when it is enabled)
+      if(currentCommand.showScreen == true && renderThreaded == false){
+	if(prevCommand.showScreen == false) engine_closeWindow();
+	engine_openWindow(fontname);
       }
-      else if(currentCommand.showScreen == false){
-	if(window != nullptr) SDL_DestroyWindow(window);
-	window = nullptr;
+      else{
+	engine_closeWindow();
       }
       
       // state entry actions:
@@ -1266,23 +1306,21 @@ void ResonanzEngine::engine_loop()
 	// checks there is enough data to do meaningful optimization
 	bool aborted = false;
 	
-	for(unsigned int i=0;i<pictureData.size() && !aborted;i++){
-	  if(pictureData[i].size(0) < 10){
-	    engine_setStatus("resonanz-engine: less than 10 data points per picture/keyword => aborting optimization");
-	    logging.warn("aborting model optimization command because of too little data (less than 10 samples per case)");
-	    cmdDoNothing(false);
-	    aborted = true;
-	    break;
-	  }
-	}
-	
-	for(unsigned int i=0;i<keywordData.size() && !aborted;i++){
-	  if(keywordData[i].size(0) < 10){
-	    engine_setStatus("resonanz-engine: less than 10 data points per picture/keyword => aborting optimization");
-	    logging.warn("aborting model optimization command because of too little data (less than 10 samples per case)");
-	    cmdDoNothing(false);
-	    aborted = true;
-	    break;
+	{
+	  // pictures and keywords with little data don't abort: they use RBF estimate of data
+	  unsigned int few = 0;
+	  
+	  for(unsigned int i=0;i<pictureData.size();i++)
+	    if(pictureData[i].size(0) < NN_MIN_SAMPLES) few++;
+	  
+	  for(unsigned int i=0;i<keywordData.size();i++)
+	    if(keywordData[i].size(0) < NN_MIN_SAMPLES) few++;
+	  
+	  if(few > 0){
+	    char buffer[256];
+	    snprintf(buffer, 256, "%d pictures/keywords have less than %d data points: predictions use RBF estimate of data",
+		     few, NN_MIN_SAMPLES);
+	    logging.info(buffer);
 	  }
 	}
 	
@@ -1307,6 +1345,8 @@ void ResonanzEngine::engine_loop()
 	if(aborted)
 	  continue; // do not start executing any commands [recheck command input buffer and move back to do nothing command]
 	
+	engine_resumeOptimization(currentHMMModel);
+	
 	optimizeETA.start(0.0f, 1.0f);
       }
 
@@ -1321,6 +1361,19 @@ void ResonanzEngine::engine_loop()
 	    continue; // aborts initializing execute command
 	  }
 
+	  if(speculativeExecute && speculator == nullptr){
+	    speculation = Speculation();
+	    
+	    speculator = new SpeculativeWorker
+	      ([this](const std::atomic<bool>& cancel){ return engine_speculate(cancel); });
+	    
+	    if(speculator->start() == false){
+	      logging.warn("starting speculative prediction thread failed");
+	      delete speculator;
+	      speculator = nullptr;
+	    }
+	  }
+
 	  logging.info("Converting program (targets) to internal format..");
 	  
 	  // convert input command parameters into generic targets that are used to select target values
@@ -1379,7 +1432,7 @@ void ResonanzEngine::engine_loop()
 	  
 	  // starts measuring time for the execution of the program
 	  
-	  auto t0 = std::chrono::system_clock::now().time_since_epoch();
+	  auto t0 = TickScheduler::clock::now().time_since_epoch();
 	  auto t0ms = std::chrono::duration_cast<std::chrono::milliseconds>(t0).count();
 	  programStarted = t0ms;
 	  lastProgramSecond = -1;
@@ -1424,7 +1477,7 @@ void ResonanzEngine::engine_loop()
 	
 	// starts measuring time for the execution of the program
 	
-	auto t0 = std::chrono::system_clock::now().time_since_epoch();
+	auto t0 = TickScheduler::clock::now().time_since_epoch();
 	auto t0ms = std::chrono::duration_cast<std::chrono::milliseconds>(t0).count();
 	programStarted = t0ms;
 	lastProgramSecond = -1;
@@ -1475,7 +1528,7 @@ void ResonanzEngine::engine_loop()
 
       
       if(currentCommand.command == ResonanzCommand::CMD_DO_RANDOM){
-	auto t0 = std::chrono::system_clock::now().time_since_epoch();
+	auto t0 = TickScheduler::clock::now().time_since_epoch();
 	auto t0ms = std::chrono::duration_cast<std::chrono::milliseconds>(t0).count();
 	programStarted = t0ms;
 	lastProgramSecond = -1;
@@ -1488,6 +1541,30 @@ void ResonanzEngine::engine_loop()
       
     }
     
+    // measure and execute follow HMM brain state in tracker thread
+    if(currentCommand.command == ResonanzCommand::CMD_DO_MEASURE ||
+       currentCommand.command == ResonanzCommand::CMD_DO_EXECUTE){
+      if(hmmTracker == nullptr && hmmUpdator == nullptr && hmm != nullptr && kmeans != nullptr)
+	engine_startTracker();
+    }
+    else if(hmmTracker != nullptr)
+      engine_stopTracker();
+    
+    // window is owned by render thread if it is enabled
+    if(renderThreaded && renderer == nullptr && currentCommand.showScreen){
+      engine_closeWindow(); // window opened by engine thread
+      
+      if(engine_startRenderer(fontname) == false){
+	logging.warn("render thread disabled: engine thread draws scenes");
+	renderThreaded = false;
+	engine_openWindow(fontname);
+      }
+    }
+    else if(renderThreaded == false && renderer != nullptr){
+      engine_stopRenderer();
+      if(currentCommand.showScreen) engine_openWindow(fontname);
+    }
+    
     ////////////////////////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // executes current command
@@ -1606,18 +1683,16 @@ void ResonanzEngine::engine_loop()
 	  
 	}
 	
-	eeg->data(eegBefore);
-	
-	engine_showScreen(keywords[key], pic, synthCurrent);
-	engine_updateScreen(); // always updates window if it exists
-	engine_sleep(MEASUREMODE_DELAY_MS);
-	
-	eeg->data(eegAfter);
+	// EEG at stimulus onset and MEASUREMODE_DELAY_MS after it
+	const bool measured =
+	  engine_measureResponse(keywords[key], pic, synthCurrent, eegBefore, eegAfter);
 	
 	engine_pollEvents();
 	
-	if(engine_storeMeasurement(pic, key, eegBefore, eegAfter,
-				   synthBefore, synthCurrent) == false)
+	if(measured == false)
+	  logging.error("measuring EEG response failed");
+	else if(engine_storeMeasurement(pic, key, eegBefore, eegAfter,
+					synthBefore, synthCurrent) == false)
 	  logging.error("Store measurement FAILED");
       }
       else if(pictures.size() > 0){
@@ -1649,18 +1724,16 @@ void ResonanzEngine::engine_loop()
 	  }
 	}
 	
-	eeg->data(eegBefore);
-	
-	engine_showScreen(" ", pic, synthCurrent);
-	engine_updateScreen(); // always updates window if it exists
-	engine_sleep(MEASUREMODE_DELAY_MS);
-	
-	eeg->data(eegAfter);
+	// EEG at stimulus onset and MEASUREMODE_DELAY_MS after it
+	const bool measured =
+	  engine_measureResponse(" ", pic, synthCurrent, eegBefore, eegAfter);
 	
 	engine_pollEvents();
 	
-	if(engine_storeMeasurement(pic, 0, eegBefore, eegAfter,
-				   synthBefore, synthCurrent) == false)
+	if(measured == false)
+	  logging.error("measuring EEG response failed");
+	else if(engine_storeMeasurement(pic, 0, eegBefore, eegAfter,
+					synthBefore, synthCurrent) == false)
 	  logging.error("store measurement failed");
 	
       }
@@ -1698,7 +1771,7 @@ void ResonanzEngine::engine_loop()
       
       engine_stopHibernation();
       
-      auto t1 = std::chrono::system_clock::now().time_since_epoch();
+      auto t1 = TickScheduler::clock::now().time_since_epoch();
       auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
       
       long long currentSecond = (long long)
@@ -1711,7 +1784,7 @@ void ResonanzEngine::engine_loop()
 	  currentSecond = 0;
 	  lastProgramSecond = -1;
 	  
-	  auto t1 = std::chrono::system_clock::now().time_since_epoch();
+	  auto t1 = TickScheduler::clock::now().time_since_epoch();
 	  auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
 	  
 	  programStarted = (long long)t1ms;
@@ -1802,8 +1875,53 @@ void ResonanzEngine::engine_loop()
 	// const float timedelta = TICK_MS/1000.0f; // current delta between pictures [length of single tick which the image is shown]
 	
 	
-	if(currentCommand.blindMonteCarlo == false)
+	// targets of the following steps for multi-step planning
+	planTargets.clear();
+	planVariances.clear();
+	
+	for(unsigned int k=0;k<plannerDepth;k++){
+	  const unsigned int step =
+	    std::min((unsigned int)(currentSecond/programHz) + k, (unsigned int)(program[0].size()-1));
+	  
+	  std::vector<float> t(eegCurrent.size()), v(eegCurrent.size());
+	  
+	  for(unsigned int i=0;i<t.size();i++){
+	    t[i] = program[i][step];
+	    v[i] = programVar[i][step];
+	  }
+	  
+	  planTargets.push_back(t);
+	  planVariances.push_back(v);
+	}
+	
+	if(currentCommand.blindMonteCarlo == false){
+	  // waits background speculation to stop so that its results can be used
+	  if(speculator) speculator->pause();
+	  
 	  engine_executeProgram(eegCurrent, eegTarget, eegTargetVariance, timedelta);
+	  
+	  // speculates the next tick while the selected stimulus is shown
+	  if(speculator){
+	    const long long nextSecond = (long long)
+	      (programHz*(t1ms + TICK_MS - programStarted)/1000.0f);
+	    
+	    unsigned int step = (unsigned int)(nextSecond/programHz);
+	    if(step >= program[0].size()) step = program[0].size() - 1;
+	    
+	    speculation.valid = false;
+	    speculation.state = HMMstate;
+	    speculation.timestep = timedelta;
+	    speculation.target.resize(eegCurrent.size());
+	    speculation.targetVariance.resize(eegCurrent.size());
+	    
+	    for(unsigned int i=0;i<eegCurrent.size();i++){
+	      speculation.target[i] = program[i][step];
+	      speculation.targetVariance[i] = programVar[i][step];
+	    }
+	    
+	    speculator->resume();
+	  }
+	}
 	else
 	  engine_executeProgramMonteCarlo(eegTarget, eegTargetVariance, timedelta);
       }
@@ -1812,8 +1930,10 @@ void ResonanzEngine::engine_loop()
 	// program has run to the end => stop
 	logging.info("Executing the given program has stopped [program stop time].");
 	
+	engine_stopRenderer(); // render thread may be encoding frames (closes its window)
+	
 	if(video){
-	  auto t1 = std::chrono::system_clock::now().time_since_epoch();
+	  auto t1 = TickScheduler::clock::now().time_since_epoch();
 	  auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
 	  
 	  logging.info("stopping theora video encoding.");
@@ -1831,7 +1951,7 @@ void ResonanzEngine::engine_loop()
       
       engine_stopHibernation();
       
-      auto t1 = std::chrono::system_clock::now().time_since_epoch();
+      auto t1 = TickScheduler::clock::now().time_since_epoch();
       auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
 		  
       long long currentSecond = (long long)
@@ -1951,8 +2071,16 @@ void ResonanzEngine::engine_loop()
     
   }
   
-  if(window != nullptr)
-    SDL_DestroyWindow(window);
+  if(speculator != nullptr){
+    speculator->stop();
+    delete speculator;
+    speculator = nullptr;
+  }
+  
+  engine_stopRenderer();
+  engine_stopTracker();
+  
+  engine_closeWindow();
   
   {
     std::lock_guard<std::mutex> lock(eeg_mutex);
@@ -1971,6 +2099,14 @@ void ResonanzEngine::engine_loop()
     nnsynth = nullptr;
   }
 
+  if(trainer != nullptr){
+    trainer->stop();
+    delete trainer;
+    trainer = nullptr;
+  }
+  
+  measurementJournal.close(); // measurements are replayed next time
+
   if(hmmUpdator != nullptr){
     hmmUpdator->stop();
     delete hmmUpdator;
@@ -2003,6 +2139,15 @@ void ResonanzEngine::engine_loop()
 // loads prediction models for program execution, returns false in case of failure
 bool ResonanzEngine::engine_loadModels(const std::string& modelDir)
 {
+  // cached predictions are not valid with new models
+  predictionCache.clear();
+  predictionCache.resetStatistics();
+  
+  keywordTop.clear();
+  pictureTop.clear();
+  keywordQuality.clear();
+  pictureQuality.clear();
+  
   try{
     if(hmmUpdator != nullptr) return  false; // already computing HMM/K-Means models.
     
@@ -2049,6 +2194,17 @@ bool ResonanzEngine::engine_loadModels(const std::string& modelDir)
       // updates HMM state (choses first randomly according to HMM PI parameter)
       
       HMMstate = hmm->sample(hmm->getPI());
+      
+      // state transition probabilities for planning stimulus sequences
+      const auto& A = hmm->getA();
+      const unsigned int S = hmm->getNumHiddenStates();
+      std::vector<float> transitions(S*S);
+      
+      for(unsigned int i=0;i<S;i++)
+	for(unsigned int j=0;j<S;j++)
+	  transitions[i*S + j] = (float)A[i][j].getDouble();
+      
+      planner.setTransitions(transitions, S);
     }
     
   }
@@ -2070,6 +2226,7 @@ bool ResonanzEngine::engine_loadModels(const std::string& modelDir)
   
   unsigned int pictureModelsLoaded = 0;
   unsigned int keywordModelsLoaded = 0;
+  unsigned int modelsFolded = 0;
   
   // #pragma omp parallel for
   for(unsigned int i=0;i<pictureModels.size();i++){
@@ -2077,13 +2234,22 @@ bool ResonanzEngine::engine_loadModels(const std::string& modelDir)
     filename = modelDir + "/" + filename;
     
     if(pictureModels[i].load(filename) == false){
-      logging.error("Loading picture model file failed: " + filename);
+      if(i < pictureData.size() && pictureData[i].size(0) > 0)
+	logging.info("No picture model, using RBF estimate of data: " + filename);
+      else
+	logging.error("Loading picture model file failed: " + filename);
       continue;
     }
     
     
     pictureModels[i].downsample(100); // keeps only 100 random models
     
+    // neural network models don't need data after normalization is folded into weights
+    if(dataRBFmodel == false && i < pictureData.size()){
+      if(foldPreprocessing(pictureModels[i], pictureData[i]))
+	modelsFolded++;
+    }
+    
     pictureModelsLoaded++;
     
     {
@@ -2109,12 +2275,20 @@ bool ResonanzEngine::engine_loadModels(const std::string& modelDir)
     filename = modelDir + "/" + filename;
     
     if(keywordModels[i].load(filename) == false){
-      logging.error("Loading keyword model file failed: " + filename);
+      if(i < keywordData.size() && keywordData[i].size(0) > 0)
+	logging.info("No keyword model, using RBF estimate of data: " + filename);
+      else
+	logging.error("Loading keyword model file failed: " + filename);
       continue;
     }
     
     keywordModels[i].downsample(100); // keeps only 100 random samples
     
+    if(dataRBFmodel == false && i < keywordData.size()){
+      if(foldPreprocessing(keywordModels[i], keywordData[i]))
+	modelsFolded++;
+    }
+    
     keywordModelsLoaded++;
     
     {
@@ -2150,6 +2324,26 @@ bool ResonanzEngine::engine_loadModels(const std::string& modelDir)
     synthModel.downsample(100); // keeps only 100 random models
   }
   
+  // packs models for batched evaluation in engine_executeProgram()
+  if(dataRBFmodel == false){
+    {
+      char buffer[128];
+      snprintf(buffer, 128, "resonanz-engine: data normalization folded into %d/%d models",
+	       modelsFolded, (unsigned int)(pictureModels.size() + keywordModels.size()));
+      logging.info(buffer);
+    }
+    
+    engine_setStatus("resonanz-engine: packing prediction models..");
+    
+    const unsigned int numSignals = eeg->getNumberOfSignals();
+    
+    if(keywordModels.size() == keywordData.size())
+      keywordBatch.build(keywordModels, keywordData, numSignals, HMM_NUM_CLUSTERS);
+    
+    if(pictureModels.size() == pictureData.size())
+      pictureBatch.build(pictureModels, pictureData, numSignals, HMM_NUM_CLUSTERS);
+  }
+  
   // returns true if could load at least one model for pictures
   return (pictureModelsLoaded > 0);
 }
@@ -2196,13 +2390,74 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
 #endif
   }
   
+  // anytime selection: stimulus are scored in priority order until deadline
+  const auto selectionStart = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point keywordDeadline, pictureDeadline, synthDeadline;
+  
+  {
+    const unsigned int numSynth = synth ? SYNTH_NUM_GENERATED_PARAMS : 0;
+    const double total = keywordData.size() + pictureData.size() + numSynth + 1;
+    const double budget = selectionBudgetMs;
+    
+    keywordDeadline = selectionStart +
+      std::chrono::microseconds((long long)(1000.0*budget*keywordData.size()/total));
+    pictureDeadline = selectionStart +
+      std::chrono::microseconds((long long)(1000.0*budget*(keywordData.size() + pictureData.size())/total));
+    synthDeadline = selectionStart + std::chrono::milliseconds(selectionBudgetMs);
+  }
+  
+  std::vector<unsigned int> order;
+  std::vector<char> scored(keywordData.size(), 0);
+  unsigned int keywordsScored = 0, picturesScored = 0, synthScored = 0;
+  
+  // speculated best stimulus are only rescored with the latest EEG values
+  const bool confirm = engine_speculationConfirmed(eegCurrent, eegTarget, eegTargetVariance, timestep_);
+  
+  if(confirm){
+    logging.info("engine_executeProgram(): rescoring speculated stimulus");
+    order = speculation.keywords;
+  }
+  else{
+    engine_selectionOrder(keywordTop, keywordQuality, keywordData.size(), order);
+    engine_shortlistOrder(keywordResponses, keywordTop, eegCurrent, eegTarget, timestep_, order);
+  }
+  
   std::vector< std::pair<float, int> > results(keywordData.size());
   std::vector< float > model_error_ratio(keywordData.size());
   
+  for(unsigned int index=0;index<results.size();index++){
+    results[index].first = std::numeric_limits<float>::infinity(); // not scored
+    results[index].second = index;
+  }
+  
+  // looks for already computed predictions (EEG values change slowly)
+  const unsigned int YDIM = eegCurrent.size();
+  std::vector<int> cacheKey;
+  std::vector<char> cached(keywordData.size(), 0), computed(keywordData.size(), 0);
+  std::vector<float> cacheM(keywordData.size()*YDIM), cacheVar(keywordData.size()*YDIM);
+  
+  if(predictionCache.enabled()){
+    predictionCache.quantize(eegCurrent, HMMstate, cacheKey);
+    
+    for(unsigned int index=0;index<keywordData.size();index++)
+      cached[index] = predictionCache.lookup(PredictionCache::KEYWORD, index, cacheKey,
+					     &(cacheM[index*YDIM]), &(cacheVar[index*YDIM]), YDIM);
+  }
+  
+  // packed neural network models are evaluated in priority order inside the
+  // loop so that the deadline also bounds them (others use per model code path)
+  std::vector<float> batchM(keywordData.size()*YDIM), batchCov(keywordData.size()*YDIM*YDIM);
+  
   logging.info("engine_executeProgram() calculate keywords");
 
 #pragma omp parallel for schedule(dynamic)	
-  for(unsigned int index=0;index<keywordData.size();index++){
+  for(unsigned int n=0;n<order.size();n++){
+    const unsigned int index = order[n];
+    
+    // after deadline only already computed predictions are scored
+    if(selectionBudgetMs > 0 && cached[index] == 0 &&
+       std::chrono::steady_clock::now() > keywordDeadline)
+      continue;
     
     math::vertex<> x(eegCurrent.size() + HMM_NUM_CLUSTERS);
     
@@ -2215,37 +2470,79 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     
     auto original = x;
     
-    if(keywordData[index].preprocess(0, x) == false){
-      logging.warn("skipping bad keyword prediction model");
-      continue;
-    }
-    
     math::vertex<> m;
     math::matrix<> cov;
     
-    if(dataRBFmodel){
-      engine_estimateNN(x, keywordData[index], m , cov);
+    if(cached[index]){
+      // cached prediction (only variances are needed for scoring)
+      m.resize(YDIM);
+      cov.resize(YDIM, YDIM);
+      cov.zero();
+      
+      for(unsigned int i=0;i<YDIM;i++){
+	m[i] = cacheM[index*YDIM + i];
+	cov(i,i) = cacheVar[index*YDIM + i];
+      }
     }
-    else{
-      whiteice::bayesian_nnetwork<>& model = keywordModels[index];
+    else if(dataRBFmodel == false && keywordBatch.isBatched(index) &&
+	    keywordBatch.calculate(index, eegCurrent, HMMstate,
+				 &(batchM[index*YDIM]), &(batchCov[index*YDIM*YDIM])))
+    {
+      // packed model (output is already in the original output space)
+      m.resize(YDIM);
+      cov.resize(YDIM, YDIM);
       
-      if(model.inputSize() != (eegCurrent.size()+HMM_NUM_CLUSTERS) ||
-	 model.outputSize() != eegTarget.size())
-      {
+      for(unsigned int i=0;i<YDIM;i++){
+	m[i] = batchM[index*YDIM + i];
+	for(unsigned int j=0;j<YDIM;j++)
+	  cov(i,j) = batchCov[index*YDIM*YDIM + i*YDIM + j];
+      }
+    }
+    else{
+      if(keywordData[index].preprocess(0, x) == false){
 	logging.warn("skipping bad keyword prediction model");
-	continue; // bad model/data => ignore
+	continue;
+      }
+      
+      // stimulus without trained model (too little data) uses RBF estimate
+      if(dataRBFmodel || index >= keywordModels.size() || keywordModels[index].inputSize() == 0){
+	const RBFSnapshot* snapshot = nullptr;
+	if(index < keywordIndex.size()) snapshot = &(keywordIndex[index]);
+	
+	engine_estimateNN(x, keywordData[index], m , cov, snapshot);
+      }
+      else{
+	whiteice::bayesian_nnetwork<>& model = keywordModels[index];
+	
+	if(model.inputSize() != (eegCurrent.size()+HMM_NUM_CLUSTERS) ||
+	   model.outputSize() != eegTarget.size())
+	{
+	  logging.warn("skipping bad keyword prediction model");
+	  continue; // bad model/data => ignore
+	}
+	
+	if(model.calculate(x, m, cov, 1, 0) == false){
+	  logging.warn("skipping bad keyword prediction model");
+	  continue;
+	}
       }
       
-      if(model.calculate(x, m, cov, 1, 0) == false){
+      
+      if(keywordData[index].invpreprocess(1, m, cov) == false){
 	logging.warn("skipping bad keyword prediction model");
 	continue;
       }
     }
     
-    
-    if(keywordData[index].invpreprocess(1, m, cov) == false){
-      logging.warn("skipping bad keyword prediction model");
-      continue;
+    if(cached[index] == 0 && predictionCache.enabled() &&
+       m.size() == YDIM && cov.ysize() == YDIM && cov.xsize() == YDIM)
+    {
+      for(unsigned int i=0;i<YDIM;i++){
+	cacheM[index*YDIM + i] = m[i].c[0];
+	cacheVar[index*YDIM + i] = cov(i,i).c[0];
+      }
+      
+      computed[index] = 1;
     }
     
     m *= timestep; // corrects delta to given timelength
@@ -2293,11 +2590,20 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     p.second = index;
     
     results[index] = p;
+    scored[index] = 1;
     
     // engine_pollEvents(); // polls for incoming events in case there are lots of models
   }
   
 	
+  for(unsigned int index=0;index<computed.size();index++){
+    if(computed[index])
+      predictionCache.insert(PredictionCache::KEYWORD, index, cacheKey,
+			     &(cacheM[index*YDIM]), &(cacheVar[index*YDIM]), YDIM);
+  }
+  
+  keywordsScored = engine_updateSelection(results, scored, keywordTop, keywordQuality);
+  
   // estimates quality of results
   if(model_error_ratio.size() > 0)
   {
@@ -2330,10 +2636,49 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
   results.resize(pictureData.size());
   model_error_ratio.resize(pictureData.size());
   
+  for(unsigned int index=0;index<results.size();index++){
+    results[index].first = std::numeric_limits<float>::infinity(); // not scored
+    results[index].second = index;
+  }
+  
+  scored.resize(pictureData.size());
+  for(auto& s : scored) s = 0;
+  
+  if(confirm){
+    order = speculation.pictures;
+  }
+  else{
+    engine_selectionOrder(pictureTop, pictureQuality, pictureData.size(), order);
+    engine_shortlistOrder(pictureResponses, pictureTop, eegCurrent, eegTarget, timestep_, order);
+  }
+  
+  cached.resize(pictureData.size());
+  computed.resize(pictureData.size());
+  cacheM.resize(pictureData.size()*YDIM);
+  cacheVar.resize(pictureData.size()*YDIM);
+  
+  for(unsigned int index=0;index<pictureData.size();index++){
+    cached[index] = 0;
+    computed[index] = 0;
+    
+    if(predictionCache.enabled())
+      cached[index] = predictionCache.lookup(PredictionCache::PICTURE, index, cacheKey,
+					     &(cacheM[index*YDIM]), &(cacheVar[index*YDIM]), YDIM);
+  }
+  
+  batchM.resize(pictureData.size()*YDIM);
+  batchCov.resize(pictureData.size()*YDIM*YDIM);
+  
   logging.info("engine_executeProgram(): calculate pictures");
   
 #pragma omp parallel for schedule(dynamic)	
-  for(unsigned int index=0;index<pictureData.size();index++){
+  for(unsigned int n=0;n<order.size();n++){
+    const unsigned int index = order[n];
+    
+    // after deadline only already computed predictions are scored
+    if(selectionBudgetMs > 0 && cached[index] == 0 &&
+       std::chrono::steady_clock::now() > pictureDeadline)
+      continue;
     
     math::vertex<> x(eegCurrent.size() + HMM_NUM_CLUSTERS);
     
@@ -2347,35 +2692,79 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     
     auto original = x;
     
-    if(pictureData[index].preprocess(0, x) == false){
-      logging.warn("skipping bad picture prediction model");
-      continue;
-    }
-    
     math::vertex<> m;
     math::matrix<> cov;
     
-    if(dataRBFmodel){
-      engine_estimateNN(x, pictureData[index], m , cov);
-    }
-    else{
-      whiteice::bayesian_nnetwork<>& model = pictureModels[index];
+    if(cached[index]){
+      // cached prediction (only variances are needed for scoring)
+      m.resize(YDIM);
+      cov.resize(YDIM, YDIM);
+      cov.zero();
       
-      if(model.inputSize() != eegCurrent.size() || model.outputSize() != eegTarget.size()){
-	logging.warn("skipping bad picture prediction model");
-	continue; // bad model/data => ignore
+      for(unsigned int i=0;i<YDIM;i++){
+	m[i] = cacheM[index*YDIM + i];
+	cov(i,i) = cacheVar[index*YDIM + i];
       }
-      
-      if(model.calculate(x, m, cov, 1, 0) == false){
+    }
+    else if(dataRBFmodel == false && pictureBatch.isBatched(index) &&
+	    pictureBatch.calculate(index, eegCurrent, HMMstate,
+				 &(batchM[index*YDIM]), &(batchCov[index*YDIM*YDIM])))
+    {
+      // packed model (output is already in the original output space)
+      m.resize(YDIM);
+      cov.resize(YDIM, YDIM);
+      
+      for(unsigned int i=0;i<YDIM;i++){
+	m[i] = batchM[index*YDIM + i];
+	for(unsigned int j=0;j<YDIM;j++)
+	  cov(i,j) = batchCov[index*YDIM*YDIM + i*YDIM + j];
+      }
+    }
+    else{
+      if(pictureData[index].preprocess(0, x) == false){
 	logging.warn("skipping bad picture prediction model");
 	continue;
       }
       
+      // stimulus without trained model (too little data) uses RBF estimate
+      if(dataRBFmodel || index >= pictureModels.size() || pictureModels[index].inputSize() == 0){
+	const RBFSnapshot* snapshot = nullptr;
+	if(index < pictureIndex.size()) snapshot = &(pictureIndex[index]);
+	
+	engine_estimateNN(x, pictureData[index], m , cov, snapshot);
+      }
+      else{
+	whiteice::bayesian_nnetwork<>& model = pictureModels[index];
+	
+	if(model.inputSize() != (eegCurrent.size()+HMM_NUM_CLUSTERS) ||
+	   model.outputSize() != eegTarget.size())
+	{
+	  logging.warn("skipping bad picture prediction model");
+	  continue; // bad model/data => ignore
+	}
+	
+	if(model.calculate(x, m, cov, 1, 0) == false){
+	  logging.warn("skipping bad picture prediction model");
+	  continue;
+	}
+	
+      }
+      
+      if(pictureData[index].invpreprocess(1, m, cov) == false){
+	logging.warn("skipping bad picture prediction model");
+	continue;
+      }
     }
     
-    if(pictureData[index].invpreprocess(1, m, cov) == false){
-      logging.warn("skipping bad picture prediction model");
-      continue;
+    if(cached[index] == 0 && predictionCache.enabled() &&
+       m.size() == YDIM && cov.ysize() == YDIM && cov.xsize() == YDIM)
+    {
+      for(unsigned int i=0;i<YDIM;i++){
+	cacheM[index*YDIM + i] = m[i].c[0];
+	cacheVar[index*YDIM + i] = cov(i,i).c[0];
+      }
+      
+      computed[index] = 1;
     }
     
     m *= timestep; // corrects delta to given timelength
@@ -2424,11 +2813,27 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     p.second = index;
     
     results[index] = p;
+    scored[index] = 1;
 		
     // engine_pollEvents(); // polls for incoming events in case there are lots of models
   }
   
   
+  for(unsigned int index=0;index<computed.size();index++){
+    if(computed[index])
+      predictionCache.insert(PredictionCache::PICTURE, index, cacheKey,
+			     &(cacheM[index*YDIM]), &(cacheVar[index*YDIM]), YDIM);
+  }
+  
+  picturesScored = engine_updateSelection(results, scored, pictureTop, pictureQuality);
+  
+  if(predictionCache.enabled()){
+    char buffer[128];
+    snprintf(buffer, 128, "engine_executeProgram(): prediction cache hit rate %.1f%% (%d predictions)",
+	     100.0f*predictionCache.getHitRate(), predictionCache.size());
+    logging.info(buffer);
+  }
+  
   // estimates quality of results
   if(model_error_ratio.size() > 0)
   {
@@ -2453,6 +2858,39 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     bestPicture.erase(i); // removes the largest element
   }
   
+  // multi-step lookahead: replaces greedy choice with the first picture of the best plan
+  if(plannerDepth > 1 && planTargets.size() > 0 && randomPrograms == false){
+    std::vector< std::pair<float, int> > sorted;
+    
+    for(unsigned int index=0;index<results.size();index++)
+      if(scored[index]) sorted.push_back(results[index]);
+    
+    const unsigned int C = std::min((unsigned int)sorted.size(), PLANNER_CANDIDATES);
+    std::partial_sort(sorted.begin(), sorted.begin() + C, sorted.end());
+    
+    std::vector<unsigned int> candidates;
+    for(unsigned int i=0;i<C;i++)
+      candidates.push_back(sorted[i].second);
+    
+    StimulusPlanner::predictor f =
+      [this](unsigned int stimulus, const std::vector<float>& eeg, unsigned int state, float* m, float* var)
+      { return engine_predictResponse(PredictionCache::PICTURE, stimulus, eeg, state, m, var); };
+    
+    std::vector<unsigned int> plan;
+    
+    if(planner.plan(eegCurrent, HMMstate, candidates, planTargets, planVariances,
+		    timestep_, f, plannerBudgetMs, plan))
+    {
+      bestPicture.clear();
+      bestPicture.insert(std::pair<float, int>(results[plan[0]].first, plan[0]));
+    }
+    
+    char buffer[256];
+    snprintf(buffer, 256, "engine_executeProgram(): planner expanded %d sequences (depth %d/%d, %d reused predictions)",
+	     planner.getExpanded(), planner.getDepthReached(), plannerDepth, planner.getReused());
+    logging.info(buffer);
+  }
+  
   engine_pollEvents(); // polls for incoming events in case there are lots of models
 	
   // FIXME synth don't use HMMstate variable (brain clusterized state)
@@ -2498,6 +2936,9 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     std::vector< std::pair<float, std::vector<float> > > errors;
     errors.resize(SYNTH_NUM_GENERATED_PARAMS);
     
+    for(auto& e : errors)
+      e.first = std::numeric_limits<float>::infinity(); // not scored
+    
     model_error_ratio.resize(SYNTH_NUM_GENERATED_PARAMS);
     
     // generates synth parameters randomly and selects parameter
@@ -2505,9 +2946,12 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
 
     logging.info("engine_executeProgram(): parallel synth model search start..");
     
-#pragma omp parallel for schedule(dynamic)
+#pragma omp parallel for schedule(dynamic) reduction(+:synthScored)
     for(unsigned int param=0;param<SYNTH_NUM_GENERATED_PARAMS;param++){
       
+      if(selectionBudgetMs > 0 && std::chrono::steady_clock::now() > synthDeadline)
+	continue; // out of time: uses the best parameters found so far
+      
       if(rng.uniform() < 0.10f)
       {
 	// generates random parameters [random search]
@@ -2598,6 +3042,7 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
       p.second = synthTest;
       
       errors[param] = p;
+      synthScored++;
       
     }
     
@@ -2622,7 +3067,8 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
     // finds the best error
     float best_error = 10e20;
     for(unsigned int i=0;i<errors.size();i++){
-      if(errors[i].first < best_error){
+      if(errors[i].first < best_error && errors[i].second.size() > 0){
+	best_error = errors[i].first;
 	soundParameters = errors[i].second; // synthTest
       }
     }
@@ -2637,6 +3083,20 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
   }
   
   
+  // per tick coverage statistics of stimulus selection
+  {
+    const auto selectionTime = std::chrono::duration_cast<std::chrono::milliseconds>
+      (std::chrono::steady_clock::now() - selectionStart).count();
+    
+    char buffer[256];
+    snprintf(buffer, 256, "engine_executeProgram(): scored %d/%d keywords, %d/%d pictures, %d/%d synth params in %d ms (budget %d ms)",
+	     keywordsScored, (unsigned int)keywordData.size(),
+	     picturesScored, (unsigned int)pictureData.size(),
+	     synthScored, synth ? SYNTH_NUM_GENERATED_PARAMS : 0,
+	     (int)selectionTime, selectionBudgetMs);
+    logging.info(buffer);
+  }
+  
   if((bestKeyword.size() <= 0 && keywordData.size() > 0) || bestPicture.size() <= 0){
     logging.error("Execute command couldn't find picture or keyword command to show (no models?)");
     engine_pollEvents();
@@ -2715,6 +3175,320 @@ bool ResonanzEngine::engine_executeProgram(const std::vector<float>& eegCurrent,
 }
 
 
+// predicts response mean and variance of a single stimulus (used by planner)
+bool ResonanzEngine::engine_predictResponse(PredictionCache::stimulus_type type,
+					    unsigned int index,
+					    const std::vector<float>& eegCurrent,
+					    unsigned int state,
+					    float* m, float* var)
+{
+  if(type != PredictionCache::KEYWORD && type != PredictionCache::PICTURE) return false;
+  
+  auto& data = (type == PredictionCache::KEYWORD) ? keywordData : pictureData;
+  auto& models = (type == PredictionCache::KEYWORD) ? keywordModels : pictureModels;
+  auto& batch = (type == PredictionCache::KEYWORD) ? keywordBatch : pictureBatch;
+  auto& snapshots = (type == PredictionCache::KEYWORD) ? keywordIndex : pictureIndex;
+  
+  if(index >= data.size()) return false;
+  
+  const unsigned int Y = eegCurrent.size();
+  std::vector<int> key;
+  
+  if(predictionCache.enabled()){
+    predictionCache.quantize(eegCurrent, state, key);
+    if(predictionCache.lookup(type, index, key, m, var, Y))
+      return true;
+  }
+  
+  if(dataRBFmodel == false && batch.isBatched(index)){
+    std::vector<float> cov(Y*Y);
+    
+    if(batch.calculate(index, eegCurrent, state, m, &(cov[0])) == false)
+      return false;
+    
+    for(unsigned int i=0;i<Y;i++)
+      var[i] = cov[i*Y + i];
+  }
+  else{
+    math::vertex<> x(Y + HMM_NUM_CLUSTERS);
+    
+    for(unsigned int i=0;i<Y;i++)
+      x[i] = eegCurrent[i];
+    for(unsigned int i=0;i<HMM_NUM_CLUSTERS;i++)
+      x[Y+i] = (i == state) ? 1.0f : 0.0f;
+    
+    if(data[index].preprocess(0, x) == false) return false;
+    
+    math::vertex<> mv;
+    math::matrix<> cv;
+    
+    if(dataRBFmodel || index >= models.size() || models[index].inputSize() == 0){
+      const RBFSnapshot* snapshot = nullptr;
+      if(index < snapshots.size()) snapshot = &(snapshots[index]);
+      
+      engine_estimateNN(x, data[index], mv, cv, snapshot);
+    }
+    else{
+      
+      if(models[index].inputSize() != x.size() || models[index].outputSize() != Y)
+	return false;
+      
+      if(models[index].calculate(x, mv, cv, 1, 0) == false)
+	return false;
+    }
+    
+    if(data[index].invpreprocess(1, mv, cv) == false) return false;
+    
+    if(mv.size() != Y || cv.ysize() != Y || cv.xsize() != Y) return false;
+    
+    for(unsigned int i=0;i<Y;i++){
+      m[i] = mv[i].c[0];
+      var[i] = cv(i,i).c[0];
+    }
+  }
+  
+  if(predictionCache.enabled())
+    predictionCache.insert(type, index, key, m, var, Y);
+  
+  return true;
+}
+
+
+// error of predicted response to target (the same measure as in engine_executeProgram())
+static float speculation_error(const std::vector<float>& eeg, const float* m, const float* var,
+			       const std::vector<float>& target,
+			       const std::vector<float>& targetVariance, float timestep)
+{
+  float error = 0.0f;
+  
+  for(unsigned int i=0;i<eeg.size();i++){
+    float p = eeg[i] + m[i]*timestep;
+    if(p < 0.0f) p = 0.0f;
+    else if(p > 1.0f) p = 1.0f;
+    
+    const float stdev = sqrtf(fabsf(var[i]))*timestep;
+    const float d = (fabsf(target[i] - p) + 0.50f*stdev)/sqrtf(targetVariance[i]);
+    
+    error += d*d;
+  }
+  
+  return sqrtf(error);
+}
+
+
+// scores all keywords and pictures for the next tick's targets using the latest
+// EEG measurement and keeps the best ones (runs in SpeculativeWorker thread)
+bool ResonanzEngine::engine_speculate(const std::atomic<bool>& cancel)
+{
+  std::vector<float> eegNow;
+  
+  {
+    std::lock_guard<std::mutex> lock(eeg_mutex);
+    if(eeg == nullptr) return false;
+    eeg->data(eegNow);
+  }
+  
+  const unsigned int Y = eegNow.size();
+  
+  if(Y == 0 || speculation.target.size() != Y || speculation.targetVariance.size() != Y)
+    return false;
+  
+  if(speculation.valid && speculation.eeg.size() == Y){
+    float change = 0.0f;
+    for(unsigned int i=0;i<Y;i++)
+      change = std::max(change, fabsf(eegNow[i] - speculation.eeg[i]));
+    
+    if(change <= SPECULATION_TOLERANCE/2.0f)
+      return false; // speculation is still fresh
+  }
+  
+  const unsigned int state = speculation.state;
+  const unsigned int K = keywordData.size();
+  const unsigned int P = pictureData.size();
+  
+  std::vector<float> errors(K+P, std::numeric_limits<float>::infinity());
+  
+#pragma omp parallel for schedule(dynamic)
+  for(unsigned int n=0;n<(K+P);n++){
+    if(cancel) continue;
+    
+    std::vector<float> m(Y), var(Y);
+    bool ok;
+    
+    if(n < K)
+      ok = engine_predictResponse(PredictionCache::KEYWORD, n, eegNow, state, &(m[0]), &(var[0]));
+    else
+      ok = engine_predictResponse(PredictionCache::PICTURE, n-K, eegNow, state, &(m[0]), &(var[0]));
+    
+    if(ok)
+      errors[n] = speculation_error(eegNow, &(m[0]), &(var[0]), speculation.target,
+				    speculation.targetVariance, speculation.timestep);
+  }
+  
+  if(cancel) return false;
+  
+  // keeps SPECULATION_SHORTLIST best stimulus of both types
+  auto best = [&](unsigned int first, unsigned int N, std::vector<unsigned int>& shortlist){
+    std::vector< std::pair<float, unsigned int> > sorted;
+    
+    for(unsigned int i=0;i<N;i++)
+      if(errors[first+i] < std::numeric_limits<float>::infinity())
+	sorted.push_back(std::pair<float, unsigned int>(errors[first+i], i));
+    
+    const unsigned int L = std::min((unsigned int)sorted.size(), SPECULATION_SHORTLIST);
+    std::partial_sort(sorted.begin(), sorted.begin() + L, sorted.end());
+    
+    shortlist.clear();
+    for(unsigned int i=0;i<L;i++)
+      shortlist.push_back(sorted[i].second);
+  };
+  
+  best(0, K, speculation.keywords);
+  best(K, P, speculation.pictures);
+  
+  speculation.eeg = eegNow;
+  speculation.valid = true;
+  
+  return true;
+}
+
+
+// speculation was computed for the same HMM state and targets and EEG values
+// have not changed more than SPECULATION_TOLERANCE since it
+bool ResonanzEngine::engine_speculationConfirmed(const std::vector<float>& eegCurrent,
+						 const std::vector<float>& eegTarget,
+						 const std::vector<float>& eegTargetVariance,
+						 float timestep) const
+{
+  const Speculation& s = speculation;
+  
+  if(speculator == nullptr || s.valid == false) return false;
+  
+  if(s.state != HMMstate || s.timestep != timestep ||
+     s.target != eegTarget || s.targetVariance != eegTargetVariance)
+    return false;
+  
+  if(s.eeg.size() != eegCurrent.size()) return false;
+  
+  for(unsigned int i=0;i<eegCurrent.size();i++)
+    if(fabsf(eegCurrent[i] - s.eeg[i]) > SPECULATION_TOLERANCE) return false;
+  
+  return true;
+}
+
+
+// calculates order in which stimulus are scored: last tick's best stimulus first,
+// then stimulus never scored and then the rest by their latest errors
+void ResonanzEngine::engine_selectionOrder(const std::vector<unsigned int>& top,
+					   const std::vector<float>& quality,
+					   unsigned int N,
+					   std::vector<unsigned int>& order) const
+{
+  order.resize(N);
+  
+  if(selectionBudgetMs == 0 || quality.size() != N){
+    for(unsigned int i=0;i<N;i++)
+      order[i] = i;
+    return;
+  }
+  
+  std::vector< std::pair<float, unsigned int> > rest;
+  std::vector<char> used(N, 0);
+  unsigned int n = 0;
+  
+  for(const auto& t : top){
+    if(t < N && used[t] == 0){
+      order[n++] = t;
+      used[t] = 1;
+    }
+  }
+  
+  for(unsigned int i=0;i<N;i++){
+    if(used[i] == 0){
+      const float q = std::isnan(quality[i]) ? -std::numeric_limits<float>::infinity() : quality[i];
+      rest.push_back(std::make_pair(q, i));
+    }
+  }
+  
+  std::sort(rest.begin(), rest.end());
+  
+  for(const auto& r : rest)
+    order[n++] = r.second;
+}
+
+
+// keeps only last tick's best stimulus and stimulus whose expected response in the
+// current HMM state is closest to (target - current)/timestep (approximate search)
+void ResonanzEngine::engine_shortlistOrder(const ResponseIndex& responses,
+					   const std::vector<unsigned int>& top,
+					   const std::vector<float>& eegCurrent,
+					   const std::vector<float>& eegTarget,
+					   float timestep,
+					   std::vector<unsigned int>& order) const
+{
+  if(responseShortlist == 0 || dataRBFmodel == false) return;
+  if(responses.size() != order.size() || responses.size() <= responseShortlist) return;
+  if(timestep <= 0.0f || eegCurrent.size() != eegTarget.size()) return;
+  
+  std::vector<float> wanted(eegCurrent.size());
+  
+  for(unsigned int i=0;i<wanted.size();i++)
+    wanted[i] = (eegTarget[i] - eegCurrent[i])/timestep;
+  
+  std::vector<unsigned int> shortlist;
+  
+  if(responses.query(HMMstate, wanted, responseShortlist, shortlist) == false)
+    return;
+  
+  std::vector<char> keep(order.size(), 0);
+  
+  for(const auto& i : shortlist) keep[i] = 1;
+  for(const auto& i : top) if(i < keep.size()) keep[i] = 1;
+  
+  unsigned int n = 0;
+  
+  for(unsigned int i=0;i<order.size();i++){
+    if(keep[order[i]])
+      order[n++] = order[i];
+  }
+  
+  order.resize(n);
+}
+
+
+// stores errors of scored stimulus and SELECTION_TOPK best stimulus for the next tick,
+// returns number of scored stimulus
+unsigned int ResonanzEngine::engine_updateSelection(const std::vector< std::pair<float, int> >& results,
+						    const std::vector<char>& scored,
+						    std::vector<unsigned int>& top,
+						    std::vector<float>& quality)
+{
+  if(quality.size() != results.size())
+    quality.assign(results.size(), std::numeric_limits<float>::quiet_NaN()); // NaN = never scored
+  
+  std::vector< std::pair<float, unsigned int> > best;
+  unsigned int count = 0;
+  
+  for(unsigned int i=0;i<results.size();i++){
+    if(scored[i] == 0) continue;
+    
+    quality[i] = results[i].first;
+    best.push_back(std::make_pair(results[i].first, i));
+    count++;
+  }
+  
+  const unsigned int K = std::min((unsigned int)best.size(), SELECTION_TOPK);
+  
+  std::partial_sort(best.begin(), best.begin() + K, best.end());
+  
+  top.resize(K);
+  for(unsigned int i=0;i<K;i++)
+    top[i] = best[i].second;
+  
+  return count;
+}
+
+
 // executes program blindly based on Monte Carlo sampling and prediction models
 // [only works for low dimensional target signals and well-trained models]
 //
@@ -3061,23 +3835,42 @@ bool ResonanzEngine::engine_optimizeModels(unsigned int& currentHMMModel,
       }
       else logging.info("Saving K-Means solution OK.");
 
+      engine_saveCheckpoint(OptimizeCheckpoint::KMEANS);
+
       // starts HMM optimizer
       hmm = new HMM(KMEANS_NUM_CLUSTERS, HMM_NUM_CLUSTERS);
       
-      std::vector<whiteice::math::vertex<> > eegTS; // eeg time-series
-      
-      if(eegData.getData(0,eegTS) == false){
-	logging.error("Loading EEG data from datastructure failed");
-	return false;
-      }
-
       std::vector<unsigned int> observations;
       {
-	// converts data to observation variables
-	
-	for(unsigned int i=0;i<eegData.size(0);i++){
-	  unsigned int c = kmeans->getClusterIndex(eegData.access(0, i));
-	  observations.push_back(c);
+	// converts data to observation variables. reads EEG time-series
+	// in place and packs only one block of it at a time
+	CentroidTable centroids;
+
+	if(centroids.build(*kmeans) == false){
+	  logging.error("Packing K-Means centroids FAILED.");
+	  return false;
+	}
+
+	const unsigned int N = eegData.size(0);
+	const unsigned int E = centroids.dimension();
+	const unsigned int BLOCK = 4096;
+	std::vector<float> X(BLOCK*E);
+
+	observations.resize(N);
+
+	for(unsigned int b=0;b<N;b+=BLOCK){
+	  const unsigned int n = std::min(BLOCK, N-b);
+	  
+	  for(unsigned int i=0;i<n;i++){
+	    const auto& v = eegData.access(0, b+i);
+	    for(unsigned int j=0;j<E && j<v.size();j++)
+	      X[i*E + j] = v[j].c[0];
+	  }
+	  
+	  if(centroids.assign(X.data(), n, E, observations.data() + b) == false){
+	    logging.error("Classifying EEG data to K-Means clusters FAILED.");
+	    return false;
+	  }
 	}
       }
       
@@ -3107,6 +3900,8 @@ bool ResonanzEngine::engine_optimizeModels(unsigned int& currentHMMModel,
       }
       else logging.info("Saving HMM solution OK.");
 
+      engine_saveCheckpoint(OptimizeCheckpoint::HMM);
+
       currentHMMModel++;
     }
     else if(hmmUpdator == nullptr && currentHMMModel == 1){
@@ -3132,642 +3927,183 @@ bool ResonanzEngine::engine_optimizeModels(unsigned int& currentHMMModel,
       delete hmmUpdator;
       hmmUpdator = nullptr;
 
+      // relabelled data is saved so that resumed optimization doesn't need to relabel it again
+      keywordDirty.assign(keywordData.size(), true);
+      pictureDirty.assign(pictureData.size(), true);
+      
+      // HMM state columns have changed
+      for(unsigned int i=0;i<keywords.size();i++)
+	statistics[engine_statisticsKey(engine_storeKey(keywords[i], true), 0)].reset(0);
+      
+      for(unsigned int i=0;i<pictures.size();i++)
+	statistics[engine_statisticsKey(engine_storeKey(pictures[i], false), 0)].reset(0);
+      
+      if(engine_saveDatabase(currentCommand.modelDir) == false)
+	logging.error("saving relabelled database failed");
+      else
+	engine_saveCheckpoint(OptimizeCheckpoint::RELABEL);
+
       currentHMMModel++;
     }
     
   }
   
-  else if(soundModelCalculated == false){
-	  
-    // first model to be optimized (no need to store the previous result)
-    if(optimizer == nullptr && bayes_optimizer == nullptr){
-      whiteice::math::vertex<> w;
-      
-      nnsynth->randomize();
-      nnsynth->exportdata(w);
-      
-      {
-	char buffer[512];
-	snprintf(buffer, 512, "resonanz model optimization started: synth model. database size: %d %d",
-		 synthData.size(0), synthData.size(1));
-	fprintf(stdout, "%s\n", buffer);
-	logging.info(buffer);
+  else if(soundModelCalculated == false ||
+	  (optimizeSynthOnly == false &&
+	   (currentPictureModel < pictureData.size() || currentKeywordModel < keywordData.size())))
+  {
+    if(trainer == nullptr){
+      // trains synth, picture and keyword models concurrently from a work queue
+      unsigned int concurrency = optimizeConcurrency;
+      if(concurrency == 0) concurrency = std::thread::hardware_concurrency();
+      if(concurrency == 0) concurrency = 1;
+      
+      trainer = new TrainingScheduler(concurrency, NUM_OPTIMIZER_ITERATIONS,
+				      use_bayesian_nnetwork ? BAYES_NUM_SAMPLES : 0);
+      
+      // models of unchanged data are skipped and models with few new measurements fine-tuned
+      unsigned int counts[4] = { 0, 0, 0, 0 }; // up to date, fine-tuned, retrained, data only
+      
+      // HMM state columns are only the same if the same K-Means and HMM models labelled them
+      unsigned long long states = 0;
+      
+      if(optimizeSynthOnly == false){
+	const std::string kmeansFile = currentCommand.modelDir + "/" +
+	  calculateHashName("KMeans" + eeg->getDataSourceName()) + ".kmeans";
+	const std::string hmmFile = currentCommand.modelDir + "/" +
+	  calculateHashName("HMM" + eeg->getDataSourceName()) + ".hmm";
+	
+	if(ModelInfo::hashFile(kmeansFile, states) == false ||
+	   ModelInfo::hashFile(hmmFile, states) == false){
+	  logging.error("Reading K-Means and HMM model files FAILED.");
+	  delete trainer;
+	  trainer = nullptr;
+	  return false;
+	}
       }
-
-      
-      //optimizer = new whiteice::pLBFGS_nnetwork<>(*nnsynth, synthData, false, false);
-      //optimizer->minimize(NUM_OPTIMIZER_THREADS);
       
-      optimizer = new whiteice::math::NNGradDescent<>();
-      optimizer->startOptimize(synthData, *nnsynth, 
-			       NUM_OPTIMIZER_THREADS);
-      
-    }
-    else if(optimizer != nullptr && use_bayesian_nnetwork){ // pre-optimizer is active
-      
-      whiteice::math::blas_real<float> error = 1000.0f;
-      whiteice::math::vertex<> w;
-      whiteice::nnetwork<> tmpnn;
-      unsigned int iterations = 0;
-      
-      //optimizer->getSolution(w, error, iterations);
-      optimizer->getSolution(tmpnn, error, iterations);
-      
-      if(iterations >= NUM_OPTIMIZER_ITERATIONS){
-	// gets finished solution
-	
-	logging.info("DEBUG: ABOUT TO STOP COMPUTATION");
-	
-	optimizer->stopComputation();
-	//optimizer->getSolution(w, error, iterations);
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz model NNGradDescent<> optimization stopped. synth model. iterations: %d error: %f",
-		   iterations, error.c[0]);
-	  logging.info(buffer);
-	}
+      auto addModel = [&](const whiteice::dataset<>& data, const whiteice::nnetwork<>& net,
+			  unsigned int inputColumns, unsigned long long states,
+			  const std::string& filename, unsigned int group)
+      {
+	ModelInfo info;
+	unsigned int iterations = 0;
 	
-	nnsynth->importdata(w);
+	auto start = engine_planTraining(data, inputColumns, states, filename, iterations, info);
 	
-	// switches to uncertainty analysis
-	const bool adaptive = true;
+	// too little data for a neural network: predictions use RBF estimate of the data
+	// (synth model has no RBF fallback so it is always trained)
+	if(group != TRAIN_SYNTH && data.size(0) < NN_MIN_SAMPLES)
+	  start = TrainingScheduler::DATA_ONLY;
 	
-	logging.info("DEBUG: STARTING HMC SAMPLER");
+	if(start == TrainingScheduler::UP_TO_DATE) counts[0]++;
+	else if(start == TrainingScheduler::DATA_ONLY) counts[3]++;
+	else if(iterations > 0) counts[1]++;
+	else counts[2]++;
 	
-	bayes_optimizer = new whiteice::UHMC<>(*nnsynth, synthData, adaptive);
-	bayes_optimizer->startSampler();
+	trainer->add(data, net, filename, group, start, iterations,
+		     info.samples > 0 ? &info : nullptr);
+      };
+      
+      if(soundModelCalculated == false){
+	std::string modelFilename = currentCommand.modelDir + "/" + 
+	  calculateHashName(eeg->getDataSourceName() + synth->getSynthesizerName()) + ".model";
 	
-	delete optimizer;
-	optimizer = nullptr;
+	addModel(synthData, *nnsynth, synthData.dimension(0), 0, modelFilename, TRAIN_SYNTH);
       }
-      else{
-	{
-	  whiteice::nnetwork<> tmpnn;
-	  math::vertex< math::blas_real<float> > w;
-	  math::blas_real<float> error;
-	  unsigned int iterations = 0;
+      
+      if(optimizeSynthOnly == false){
+	const unsigned int eegColumns = eeg->getNumberOfSignals(); // HMM state columns are not compared
+	
+	for(unsigned int i=0;i<pictureData.size();i++){
+	  std::string dbFilename = currentCommand.modelDir + "/" +
+	    calculateHashName(pictures[i] + eeg->getDataSourceName()) + ".model";
 	  
-	  //optimizer->getSolution(w, error, iterations);
-	  optimizer->getSolution(tmpnn, error, iterations);
-	  tmpnn.exportdata(w);
+	  addModel(pictureData[i], *nn, eegColumns, states, dbFilename, TRAIN_PICTURE);
+	}
+	
+	for(unsigned int i=0;i<keywordData.size();i++){
+	  std::string dbFilename = currentCommand.modelDir + "/" +
+	    calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".model";
 	  
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz NNGradDescent<> model optimization running. synth model. number of iterations: %d/%d. error: %f",
-		   iterations, NUM_OPTIMIZER_ITERATIONS, error.c[0]);
-	  logging.info(buffer);
+	  addModel(keywordData[i], *nn, eegColumns, states, dbFilename, TRAIN_KEYWORD);
 	}
       }
       
+      if(trainer->start() == false){
+	logging.error("Starting model optimization FAILED.");
+	delete trainer;
+	trainer = nullptr;
+	return false;
+      }
+      
+      {
+	char buffer[512];
+	snprintf(buffer, 512, "resonanz model optimization started: %d models (%d up to date, %d fine-tuned, %d use data RBF), %d concurrently",
+		 trainer->getTotal(), counts[0], counts[1], counts[3], concurrency);
+	fprintf(stdout, "%s\n", buffer);
+	logging.info(buffer);
+      }
     }
-    else if(bayes_optimizer != nullptr){
-      if(bayes_optimizer->getNumberOfSamples() >= BAYES_NUM_SAMPLES){ // time to stop computation [got uncertainly information]
-	
-	bayes_optimizer->stopSampler();
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz bayes synth model optimization stopped. iterations: %d",
-		   bayes_optimizer->getNumberOfSamples());
-	  logging.info(buffer);
-	}
-	
-	// saves optimization results to a file
-	std::string dbFilename = currentCommand.modelDir + "/" +
-	  calculateHashName(eeg->getDataSourceName() + synth->getSynthesizerName()) + ".model";
-	
-	bayes_optimizer->getNetwork(*bnn);
-	
-	if(bnn->save(dbFilename) == false)
-	  logging.error("saving bayesian nn configuration file failed");
-	
-	delete bayes_optimizer;
-	bayes_optimizer = nullptr;
-	
-	soundModelCalculated = true;
-      }
-      else{
-	unsigned int samples = bayes_optimizer->getNumberOfSamples();
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz bayes model optimization running. synth model. number of samples: %d/%d",
-		   bayes_optimizer->getNumberOfSamples(), BAYES_NUM_SAMPLES);
-	  logging.info(buffer);
-	}
-	
-      }
-    }
-    else if(optimizer != nullptr){
-      whiteice::math::blas_real<float> error = 1000.0f;
-      whiteice::nnetwork<> tmpnn;
-      whiteice::math::vertex<> w;
-      unsigned int iterations = 0;
-      
-      //optimizer->getSolution(w, error, iterations);
-      optimizer->getSolution(tmpnn, error, iterations);
-      tmpnn.exportdata(w);
-      
-      if(iterations >= NUM_OPTIMIZER_ITERATIONS){
-	// gets finished solution
-	
-	optimizer->stopComputation();
-	//optimizer->getSolution(w, error, iterations);
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz model optimization stopped. synth model. iterations: %d error: %f",
-		   iterations, error.c[0]);
-	  logging.info(buffer);
-	}
-	
-	// saves optimization results to a file
-	std::string modelFilename = currentCommand.modelDir + "/" + 
-	  calculateHashName(eeg->getDataSourceName() + synth->getSynthesizerName()) + ".model";
-	
-	nnsynth->importdata(w);
-	
-	bnn->importNetwork(*nnsynth);
-	
-	if(bnn->save(modelFilename) == false)
-	  logging.error("saving nn configuration file failed");
-	
-	delete optimizer;
-	optimizer = nullptr;
-	
+    else if(trainer->isRunning()){
+      if(trainer->getCompleted(TRAIN_SYNTH) > 0)
 	soundModelCalculated = true;
-      }
-      else{
-	{
-	  whiteice::nnetwork<> tmpnn;
-	  math::vertex< math::blas_real<float> > w;
-	  math::blas_real<float> error;
-	  unsigned int iterations = 0;
-	  
-	  //optimizer->getSolution(w, error, iterations);
-	  optimizer->getSolution(tmpnn, error, iterations);
-	  tmpnn.exportdata(w);
-	  
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz NNGradDescent<> model optimization running. synth model. number of iterations: %d/%d. error: %f",
-		   iterations, NUM_OPTIMIZER_ITERATIONS, error.c[0]);
-	  
-	  logging.info(buffer);
-	}
-      }
-    }
-    
-    
-  }
-  else if(currentPictureModel < pictureData.size() && optimizeSynthOnly == false){
-    
-    // first model to be optimized (no need to store the previous result)
-    if(optimizer == nullptr && bayes_optimizer == nullptr){
-      whiteice::math::vertex<> w;
-      
-      nn->randomize();
-      nn->exportdata(w);
-      
-      //optimizer = new whiteice::pLBFGS_nnetwork<>(*nn, pictureData[currentPictureModel], false, false);
-      //optimizer->minimize(NUM_OPTIMIZER_THREADS);
-      
-      optimizer = new whiteice::math::NNGradDescent<>();
-      optimizer->startOptimize(pictureData[currentPictureModel], *nn,
-			       NUM_OPTIMIZER_THREADS);
       
       {
-	char buffer[512];
-	snprintf(buffer, 512, "resonanz model optimization started: picture %d database size: %d",
-		 currentPictureModel, pictureData[currentPictureModel].size(0));
-	fprintf(stdout, "%s\n", buffer);
-	logging.info(buffer);
-      }
-      
-    }
-    else if(optimizer != nullptr && use_bayesian_nnetwork){ // pre-optimizer is active
-      
-      whiteice::math::blas_real<float> error = 1000.0f;
-      whiteice::nnetwork<> tmpnn;
-      whiteice::math::vertex<> w;
-      unsigned int iterations = 0;
-      
-      //optimizer->getSolution(w, error, iterations);
-      optimizer->getSolution(tmpnn, error, iterations);
-      tmpnn.exportdata(w);
-      
-      if(iterations >= NUM_OPTIMIZER_ITERATIONS){
-	// gets finished solution
-	
-	optimizer->stopComputation();
-	//optimizer->getSolution(w, error, iterations);
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz model NNGradDescent<> optimization stopped. picture model. iterations: %d error: %f",
-		   iterations, error.c[0]);
-	  logging.info(buffer);
-	}
+	std::vector< std::pair<std::string, ModelInfo> > finished;
 	
-	nn->importdata(w);
-	
-	// switches to uncertainty analysis
-	const bool adaptive = true;
-	
-	bayes_optimizer = new whiteice::UHMC<>(*nn, pictureData[currentPictureModel], adaptive);
-	bayes_optimizer->startSampler();
-	
-	delete optimizer;
-	optimizer = nullptr;
-      }
-      else{
-	{
-	  char buffer[512];
-	  unsigned int iterations;
-	  whiteice::math::blas_real<float> error;
-	  optimizer->getSolutionStatistics(error, iterations);
+	if(trainer->getFinished(finished)){
+	  for(const auto& f : finished)
+	    checkpoint.models[f.first] = f.second;
 	  
-	  //snprintf(buffer, 512, "resonanz L-BFGS model optimization running. picture model. number of iterations: %d/%d",
-	  //   optimizer->getIterations(), NUM_OPTIMIZER_ITERATIONS);
-	  snprintf(buffer, 512, "resonanz NNGradDescent<> model optimization running. picture model. number of iterations: %d/%d",
-		   iterations, NUM_OPTIMIZER_ITERATIONS);
-	  logging.info(buffer);
-	}
-      }
-      
-    }
-    else if(bayes_optimizer != nullptr){
-      if(bayes_optimizer->getNumberOfSamples() >= BAYES_NUM_SAMPLES){ // time to stop computation [got uncertainly information]
-	
-	bayes_optimizer->stopSampler();
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz bayes model optimization stopped. picture: %d iterations: %d",
-		   currentPictureModel, bayes_optimizer->getNumberOfSamples());
-	  logging.info(buffer);
-	}
-	
-	// saves optimization results to a file
-	std::string dbFilename = currentCommand.modelDir + "/" +
-	  calculateHashName(pictures[currentPictureModel] + eeg->getDataSourceName()) + ".model";
-	
-	bayes_optimizer->getNetwork(*bnn);
-	
-	if(bnn->save(dbFilename) == false)
-	  logging.error("saving bayesian nn configuration file failed");
-	
-	delete bayes_optimizer;
-	bayes_optimizer = nullptr;
-	
-	// starts new computation
-	currentPictureModel++;
-	if(currentPictureModel < pictures.size()){
-	  {
-	    char buffer[512];
-	    snprintf(buffer, 512, "resonanz bayes model optimization started: picture %d database size: %d",
-		     currentPictureModel, pictureData[currentPictureModel].size(0));
-	    fprintf(stdout, "%s\n", buffer);
-	    logging.info(buffer);
-	  }
-	  
-	  // actives pre-optimizer
-	  whiteice::math::vertex<> w;
-	  
-	  nn->randomize();
-	  nn->exportdata(w);
-	  
-	  //optimizer = new whiteice::pLBFGS_nnetwork<>(*nn, pictureData[currentPictureModel], false, false);
-	  //optimizer->minimize(NUM_OPTIMIZER_THREADS);
-	  
-	  optimizer = new whiteice::math::NNGradDescent<>();
-	  
-	  optimizer->startOptimize(pictureData[currentPictureModel], *nn,
-				   NUM_OPTIMIZER_THREADS);
-	  
-	}
-      }
-      else{
-	unsigned int samples = bayes_optimizer->getNumberOfSamples();
-	
-	if((samples % 100) == 0){
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz bayes model optimization running. picture: %d number of samples: %d/%d",
-		   currentPictureModel, bayes_optimizer->getNumberOfSamples(), BAYES_NUM_SAMPLES);
-	  logging.info(buffer);
+	  engine_saveCheckpoint(checkpoint.stage);
 	}
-	
       }
-    }
-    else if(optimizer != nullptr){
-      whiteice::math::blas_real<float> error = 1000.0f;
-      whiteice::nnetwork<> tmpnn;
-      whiteice::math::vertex<> w;
-      unsigned int iterations = 0;
       
-      //optimizer->getSolution(w, error, iterations);
-      optimizer->getSolution(tmpnn, error, iterations);
-      tmpnn.exportdata(w);
+      currentPictureModel = trainer->getCompleted(TRAIN_PICTURE);
+      currentKeywordModel = trainer->getCompleted(TRAIN_KEYWORD);
       
-      if(iterations >= NUM_OPTIMIZER_ITERATIONS){
-	// gets finished solution
-	
-	optimizer->stopComputation();
-	//optimizer->getSolution(w, error, iterations);
-	
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz model optimization stopped. picture: %d iterations: %d error: %f",
-		   currentPictureModel, iterations, error.c[0]);
-	  fprintf(stdout, "%s\n", buffer);
-	  logging.info(buffer);
-	}
-	
-	// saves optimization results to a file
-	std::string dbFilename = currentCommand.modelDir + "/" +
-	  calculateHashName(pictures[currentPictureModel] + eeg->getDataSourceName()) + ".model";
-	nn->importdata(w);
-	
-	bnn->importNetwork(*nn);
-	
-	if(bnn->save(dbFilename) == false)
-	  logging.error("saving nn configuration file failed");
-	
-	delete optimizer;
-	optimizer = nullptr;
-	
-	// starts new computation
-	currentPictureModel++;
-	if(currentPictureModel < pictures.size()){
-	  nn->randomize();
-	  nn->exportdata(w);
-	  
-	  {
-	    char buffer[512];
-	    snprintf(buffer, 512, "resonanz model optimization started: picture %d database size: %d",
-		     currentPictureModel, pictureData[currentPictureModel].size(0));
-	    logging.info(buffer);
-	  }
-	  
-	  //optimizer = new whiteice::pLBFGS_nnetwork<>(*nn, pictureData[currentPictureModel], false, false);
-	  //optimizer->minimize(NUM_OPTIMIZER_THREADS);
-	  
-	  optimizer = new whiteice::math::NNGradDescent<>();
-	  
-	  optimizer->startOptimize(pictureData[currentPictureModel], *nn,
-				   NUM_OPTIMIZER_THREADS);
-	}
-      }
-    }
-    else{
       {
-	math::vertex< math::blas_real<float> > w;
-	whiteice::nnetwork<> tmpnn;
-	math::blas_real<float> error;
-	unsigned int iterations = 0;
-	
-	//optimizer->getSolution(w, error, iterations);
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
+	const double eta = trainer->getETA();
 	
 	char buffer[512];
-	snprintf(buffer, 512, "resonanz L-BFGS model optimization running. picture model %d/%d. number of iterations: %d/%d. error: %f",
-		 currentPictureModel, pictures.size(), 
-		 iterations, NUM_OPTIMIZER_ITERATIONS, error.c[0]);
-	fprintf(stdout, "%s\n", buffer);
+	snprintf(buffer, 512, "resonanz model optimization running. models %d/%d (%d running, %d failed). progress: %.1f%% ETA: %.1f min",
+		 trainer->getCompleted(), trainer->getTotal(), trainer->getActive(), trainer->getFailed(),
+		 100.0f*trainer->getProgress(), eta >= 0.0 ? eta/60.0 : 0.0);
 	logging.info(buffer);
       }
     }
-    
-  }
-  else if(currentKeywordModel < keywords.size() && optimizeSynthOnly == false){
-    
-    if(optimizer == nullptr && bayes_optimizer == nullptr){ // first model to be optimized (no need to store the previous result)
-      
-      whiteice::math::vertex<> w;
-      
-      nn->randomize();
-      nn->exportdata(w);
-      
-      //optimizer = new whiteice::pLBFGS_nnetwork<>(*nn, keywordData[currentKeywordModel], false, false);
-      //optimizer->minimize(NUM_OPTIMIZER_THREADS);
-      
-      optimizer = new whiteice::math::NNGradDescent<>();
-      
-      optimizer->startOptimize(keywordData[currentKeywordModel], *nn,
-			       NUM_OPTIMIZER_THREADS);
-      
+    else{
+      // all models have been trained and saved
       {
 	char buffer[512];
-	snprintf(buffer, 512, "resonanz model optimization started: keyword %d database size: %d",
-		 currentKeywordModel, keywordData[currentKeywordModel].size(0));
+	snprintf(buffer, 512, "resonanz model optimization stopped. models: %d failed: %d",
+		 trainer->getCompleted(), trainer->getFailed());
 	fprintf(stdout, "%s\n", buffer);
 	logging.info(buffer);
       }
       
-    }
-    else if(optimizer != nullptr && use_bayesian_nnetwork){ // pre-optimizer is active
-      
-      whiteice::math::blas_real<float> error = 1000.0f;
-      whiteice::nnetwork<> tmpnn;
-      whiteice::math::vertex<> w;
-      unsigned int iterations = 0;
-      
-      //optimizer->getSolution(w, error, iterations);
-      optimizer->getSolution(tmpnn, error, iterations);
-      tmpnn.exportdata(w);
+      if(trainer->getFailed() > 0)
+	logging.error("training or saving some prediction models failed");
       
-      if(iterations >= NUM_OPTIMIZER_ITERATIONS){
-	// gets finished solution
-	
-	optimizer->stopComputation();
-	
-	//optimizer->getSolution(w, error, iterations);
-	
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz model NNGradDescent<> optimization stopped. keyword model. iterations: %d error: %f",
-		   iterations, error.c[0]);
-	  logging.info(buffer);
-	}
-	
-	nn->importdata(w);
-	
-	// switches to bayesian optimizer
-	const bool adaptive = true;
-	
-	bayes_optimizer = new whiteice::UHMC<>(*nn, keywordData[currentKeywordModel], adaptive);
-	bayes_optimizer->startSampler();
-	
-	delete optimizer;
-	optimizer = nullptr;
-      }
-      else{
-	{
-	  char buffer[512];
-	  unsigned int iterations;
-	  whiteice::math::blas_real<float> error;
-	  optimizer->getSolutionStatistics(error, iterations);
-	  
-	  //snprintf(buffer, 512, "resonanz L-BFGS model optimization running. keyword model. number of iterations: %d/%d",
-	  //	   optimizer->getIterations(), NUM_OPTIMIZER_ITERATIONS);
-	  snprintf(buffer, 512, "resonanz NNGradDescent<> model optimization running. keyword model. number of iterations: %d/%d",
-		   iterations, NUM_OPTIMIZER_ITERATIONS);
-	  logging.info(buffer);
-	}
-      }
-      
-    }
-    else if(bayes_optimizer != nullptr){
-      if(bayes_optimizer->getNumberOfSamples() >= BAYES_NUM_SAMPLES){ // time to stop computation
-	
-	bayes_optimizer->stopSampler();
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz bayes model optimization stopped. keyword: %d iterations: %d",
-		   currentKeywordModel, bayes_optimizer->getNumberOfSamples());
-	  logging.info(buffer);
-	}
-	
-	// saves optimization results to a file
-	std::string dbFilename = currentCommand.modelDir + "/" +
-	  calculateHashName(keywords[currentKeywordModel] + eeg->getDataSourceName()) + ".model";
-	
-	bayes_optimizer->getNetwork(*bnn);
-	
-	if(bnn->save(dbFilename) == false)
-	  logging.error("saving bayesian nn configuration file failed");
-	
-	delete bayes_optimizer;
-	bayes_optimizer = nullptr;
+      {
+	std::vector< std::pair<std::string, ModelInfo> > finished;
 	
-	// starts new computation
-	currentKeywordModel++;
-	if(currentKeywordModel < keywords.size()){
-	  {
-	    char buffer[512];
-	    snprintf(buffer, 512, "resonanz bayes model optimization started: keyword %d database size: %d",
-		     currentKeywordModel, keywordData[currentKeywordModel].size(0));
-	    fprintf(stdout, "%s\n", buffer);
-	    logging.info(buffer);
-	  }
+	if(trainer->getFinished(finished)){
+	  for(const auto& f : finished)
+	    checkpoint.models[f.first] = f.second;
 	  
-	  whiteice::math::vertex<> w;
-	  nn->randomize();
-	  nn->exportdata(w);
-	  
-	  //optimizer = new whiteice::pLBFGS_nnetwork<>(*nn, keywordData[currentKeywordModel], false, false);
-	  //optimizer->minimize(NUM_OPTIMIZER_THREADS);
-	  
-	  optimizer = new whiteice::math::NNGradDescent<>();
-	  optimizer->startOptimize(keywordData[currentKeywordModel], *nn, 
-								 NUM_OPTIMIZER_THREADS);
-	}
-      }
-      else{
-	unsigned int samples = bayes_optimizer->getNumberOfSamples();
-	
-	if((samples % 100) == 0){
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz bayes model optimization running. keyword: %d number of samples: %d/%d",
-		   currentKeywordModel, bayes_optimizer->getNumberOfSamples(), BAYES_NUM_SAMPLES);
-	  logging.info(buffer);
+	  engine_saveCheckpoint(checkpoint.stage);
 	}
-	
       }
-    }
-    else if(optimizer != nullptr){
-      whiteice::math::blas_real<float> error = 1000.0f;
-      whiteice::nnetwork<> tmpnn;
-      whiteice::math::vertex<> w;
-      unsigned int iterations = 0;
       
-      //optimizer->getSolution(w, error, iterations);
-      optimizer->getSolution(tmpnn, error, iterations);
-      tmpnn.exportdata(w);
+      trainer->stop();
+      delete trainer;
+      trainer = nullptr;
       
-      if(iterations >= NUM_OPTIMIZER_ITERATIONS){
-	// gets finished solution
-	
-	optimizer->stopComputation();
-	
-	//optimizer->getSolution(w, error, iterations);
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	
-	{
-	  char buffer[512];
-	  snprintf(buffer, 512, "resonanz model optimization stopped. keyword: %d iterations: %d error: %f",
-		   currentKeywordModel, iterations, error.c[0]);
-	  fprintf(stdout, "%s\n", buffer);
-	  logging.info(buffer);
-	}
-	
-	// saves optimization results to a file
-	std::string dbFilename = currentCommand.modelDir + "/" +
-	  calculateHashName(keywords[currentKeywordModel] + eeg->getDataSourceName()) + ".model";
-	nn->importdata(w);
-	
-	bnn->importNetwork(*nn);
-	
-	if(bnn->save(dbFilename) == false)
-	  logging.error("saving nn configuration file failed");
-	
-	delete optimizer;
-	optimizer = nullptr;
-	
-	// starts new computation
-	currentKeywordModel++;
-	if(currentKeywordModel < keywords.size()){
-	  nn->randomize();
-	  nn->exportdata(w);
-	  
-	  {
-	    char buffer[512];
-	    snprintf(buffer, 512, "resonanz model optimization started: keyword %d database size: %d",
-		     currentKeywordModel, keywordData[currentKeywordModel].size(0));
-	    logging.info(buffer);
-	  }
-	  
-	  //optimizer = new whiteice::pLBFGS_nnetwork<>(*nn, keywordData[currentKeywordModel], false, false);
-	  //optimizer->minimize(NUM_OPTIMIZER_THREADS);
-	  
-	  optimizer = new whiteice::math::NNGradDescent<>();
-	  optimizer->startOptimize(keywordData[currentKeywordModel], *nn, 
-				   NUM_OPTIMIZER_THREADS);
-	}
-      }
-    }
-    else{
-      {
-	math::vertex< math::blas_real<float> > w;
-	whiteice::nnetwork<> tmpnn;
-	math::blas_real<float> error;
-	unsigned int iterations = 0;
-	
-	//optimizer->getSolution(w, error, iterations);
-	optimizer->getSolution(tmpnn, error, iterations);
-	tmpnn.exportdata(w);
-	
-	char buffer[512];
-	snprintf(buffer, 512, "resonanz NNGradDescent<> model optimization running. keyword model %d/%d. number of iterations: %d/%d. error: %f",
-		 currentKeywordModel, keywords.size(), 
-		 iterations, NUM_OPTIMIZER_ITERATIONS, error.c[0]);
-	logging.info(buffer);
-      }
+      soundModelCalculated = true;
+      currentPictureModel = pictureData.size();
+      currentKeywordModel = keywordData.size();
     }
   }
   else{ // both synth, picture and keyword models has been computed or
@@ -3780,11 +4116,156 @@ bool ResonanzEngine::engine_optimizeModels(unsigned int& currentHMMModel,
 
 
 
+TrainingScheduler::Start ResonanzEngine::engine_planTraining(const whiteice::dataset<>& data,
+							     unsigned int inputColumns,
+							     unsigned long long states,
+							     const std::string& modelFilename,
+							     unsigned int& iterations,
+							     ModelInfo& info)
+{
+  iterations = 0; // default number of iterations
+  
+  if(info.calculate(data, inputColumns) == false)
+    return TrainingScheduler::RANDOM_START;
+  
+  info.states = states;
+  
+  {
+    FILE* handle = fopen(modelFilename.c_str(), "rb");
+    if(handle == NULL) return TrainingScheduler::RANDOM_START; // no model yet
+    fclose(handle);
+  }
+  
+  ModelInfo previous;
+  
+  if(previous.load(ModelInfo::sidecar(modelFilename)) == false)
+    return TrainingScheduler::WARM_START; // model saved without sidecar file
+  
+  if(previous.sameData(info) || checkpoint.isCompleted(modelFilename, info))
+    return TrainingScheduler::UP_TO_DATE;
+  
+  // same measurements but K-Means and HMM were retrained (new EEG data)
+  // so only HMM state inputs changed: short fine-tuning to the new labels
+  if(previous.sameSamples(info)){
+    iterations = FINETUNE_MIN_ITERATIONS;
+    return TrainingScheduler::WARM_START;
+  }
+  
+  // only few new measurements: short fine-tuning of the previous model
+  if(previous.samples > 0 && info.samples > previous.samples){
+    const unsigned int added = info.samples - previous.samples;
+    
+    if(added <= FINETUNE_MAX_NEW*previous.samples){
+      iterations = (NUM_OPTIMIZER_ITERATIONS*added)/info.samples;
+      if(iterations < FINETUNE_MIN_ITERATIONS) iterations = FINETUNE_MIN_ITERATIONS;
+    }
+  }
+  
+  return TrainingScheduler::WARM_START;
+}
+
+
+bool ResonanzEngine::engine_resumeOptimization(unsigned int& currentHMMModel)
+{
+  checkpointFile = currentCommand.modelDir + "/" +
+    calculateHashName("checkpoint" + eeg->getDataSourceName()) + ".checkpoint";
+  
+  ModelInfo info;
+  
+  if(info.calculate(eegData, eegData.dimension(0)) == false){
+    checkpoint.clear();
+    return false;
+  }
+  
+  if(checkpoint.load(checkpointFile) == false || checkpoint.eeg.sameData(info) == false){
+    // no checkpoint or EEG data has changed: starts from the beginning
+    checkpoint.clear();
+    checkpoint.eeg = info;
+    checkpoint.save(checkpointFile);
+    return false;
+  }
+  
+  if(checkpoint.stage == OptimizeCheckpoint::NONE)
+    return true;
+  
+  // loads K-Means and HMM models computed earlier from the same EEG data
+  std::string filename = currentCommand.modelDir + "/" +
+    calculateHashName("KMeans" + eeg->getDataSourceName()) + ".kmeans";
+  
+  auto newkmeans = new whiteice::KMeans<>();
+  auto newhmm = new whiteice::HMM();
+  
+  if(newkmeans->load(filename) == false){
+    logging.warn("resuming optimization: loading K-Means model failed");
+    delete newkmeans;
+    delete newhmm;
+    checkpoint.stage = OptimizeCheckpoint::NONE;
+    return false;
+  }
+  
+  if(checkpoint.stage >= OptimizeCheckpoint::HMM){
+    filename = currentCommand.modelDir + "/" +
+      calculateHashName("HMM" + eeg->getDataSourceName()) + ".hmm";
+    
+    if(newhmm->loadArbitrary(filename) == false ||
+       newhmm->getNumVisibleStates() != newkmeans->size()){
+      logging.warn("resuming optimization: loading HMM model failed");
+      delete newhmm;
+      newhmm = nullptr;
+      checkpoint.stage = OptimizeCheckpoint::KMEANS;
+    }
+  }
+  else{
+    delete newhmm;
+    newhmm = nullptr;
+  }
+  
+  {
+    std::lock_guard<std::mutex> lock(hmm_mutex);
+    
+    if(kmeans) delete kmeans;
+    if(hmm) delete hmm;
+    
+    kmeans = newkmeans;
+    hmm = newhmm;
+  }
+  
+  if(checkpoint.stage == OptimizeCheckpoint::RELABEL) currentHMMModel = 2;
+  else if(checkpoint.stage == OptimizeCheckpoint::HMM) currentHMMModel = 1;
+  else currentHMMModel = 0; // HMM is optimized using loaded K-Means model
+  
+  {
+    char buffer[512];
+    snprintf(buffer, 512, "resuming stopped model optimization (stage %d, %d completed models)",
+	     (int)checkpoint.stage, (int)checkpoint.models.size());
+    logging.info(buffer);
+  }
+  
+  return true;
+}
+
+
+bool ResonanzEngine::engine_saveCheckpoint(OptimizeCheckpoint::Stage stage)
+{
+  if(checkpointFile.size() == 0) return false;
+  
+  checkpoint.stage = stage;
+  
+  if(checkpoint.save(checkpointFile) == false){
+    logging.warn("saving optimization checkpoint file failed");
+    return false;
+  }
+  
+  return true;
+}
+
+
 // estimate output value N(m,cov) for x given dataset data uses nearest neighbourhood estimation (distance)
 bool ResonanzEngine::engine_estimateNN(const whiteice::math::vertex<>& x,
 				       const whiteice::dataset<>& data,
 				       whiteice::math::vertex<>& m,
-				       whiteice::math::matrix<>& cov)
+				       whiteice::math::matrix<>& cov,
+				       const RBFSnapshot* index)
 {
   bool bad_data = false;
   
@@ -3804,6 +4285,38 @@ bool ResonanzEngine::engine_estimateNN(const whiteice::math::vertex<>& x,
   }
 
   const unsigned int YMAX = data.access(1,0).size();
+
+  // uses SoA snapshot of the data (SIMD kernel, no allocations) if it matches the data
+  if(index != nullptr && index->size() == data.size(0) &&
+     index->inputs() == x.size() && index->outputs() == YMAX)
+  {
+    float xf[RBFSnapshot::MAX_INPUTS];
+    float mf[RBFSnapshot::MAX_OUTPUTS];
+    float cf[RBFSnapshot::MAX_OUTPUTS*RBFSnapshot::MAX_OUTPUTS];
+    
+    for(unsigned int i=0;i<x.size();i++)
+      xf[i] = x[i].c[0];
+    
+    bool ok = false;
+    
+    if(rbfNeighbours > 0 || rbfRadius > 0.0f)
+      ok = index->estimate(xf, rbfNeighbours, rbfRadius, rbfEpsilon, mf, cf);
+    else
+      ok = index->estimate(xf, mf, cf);
+    
+    if(ok){
+      m.resize(YMAX);
+      cov.resize(YMAX,YMAX);
+      
+      for(unsigned int j=0;j<YMAX;j++){
+	m[j] = mf[j];
+	for(unsigned int k=0;k<YMAX;k++)
+	  cov(j,k) = cf[j*YMAX + k];
+      }
+      
+      return true;
+    }
+  }
   
   m.resize(YMAX);
   m.zero();
@@ -3811,7 +4324,6 @@ bool ResonanzEngine::engine_estimateNN(const whiteice::math::vertex<>& x,
   cov.zero();
   const float epsilon    = 0.01f;
   math::blas_real<float> sumweights = 0.0f;
-
   
   for(unsigned int i=0;i<data.size(0);i++){
     auto delta = x - data.access(0, i);
@@ -3835,6 +4347,54 @@ bool ResonanzEngine::engine_estimateNN(const whiteice::math::vertex<>& x,
 }
 
 
+// builds RBF model snapshots (and search indexes) of keyword and picture data
+bool ResonanzEngine::engine_buildIndexes()
+{
+  keywordIndex.resize(keywordData.size());
+  pictureIndex.resize(pictureData.size());
+  
+  bool ok = true;
+  
+#pragma omp parallel for schedule(dynamic)
+  for(unsigned int i=0;i<keywordData.size();i++){
+    if(keywordData[i].getNumberOfClusters() != 2 ||
+       keywordIndex[i].build(keywordData[i]) == false){
+      keywordIndex[i].clear();
+      ok = false;
+    }
+  }
+  
+#pragma omp parallel for schedule(dynamic)
+  for(unsigned int i=0;i<pictureData.size();i++){
+    if(pictureData[i].getNumberOfClusters() != 2 ||
+       pictureIndex[i].build(pictureData[i]) == false){
+      pictureIndex[i].clear();
+      ok = false;
+    }
+  }
+  
+  if(RBFSnapshot::hasSIMD())
+    logging.info("RBF model snapshots built (AVX2 kernel)");
+  else
+    logging.info("RBF model snapshots built");
+  
+  // expected response indexes for shortlisting stimulus
+  const unsigned int numSignals = eeg->getNumberOfSignals();
+  
+  if(keywordResponses.build(keywordData, numSignals, HMM_NUM_CLUSTERS) == false){
+    logging.warn("building keyword response index failed");
+    ok = false;
+  }
+  
+  if(pictureResponses.build(pictureData, numSignals, HMM_NUM_CLUSTERS) == false){
+    logging.warn("building picture response index failed");
+    ok = false;
+  }
+  
+  return ok;
+}
+
+
 
 void ResonanzEngine::engine_setStatus(const std::string& msg) throw()
 {
@@ -3850,10 +4410,13 @@ void ResonanzEngine::engine_setStatus(const std::string& msg) throw()
 void ResonanzEngine::engine_sleep(int msecs)
 {
   // sleeps for given number of milliseconds
-  
-  // currently just sleeps()
-  std::chrono::milliseconds duration(msecs);
-  std::this_thread::sleep_for(duration);
+  engine_sleepUntil(TickScheduler::clock::now() + std::chrono::milliseconds(msecs));
+}
+
+
+void ResonanzEngine::engine_sleepUntil(TickScheduler::clock::time_point t)
+{
+  TickScheduler::sleepUntil(t);
 }
 
 
@@ -3955,6 +4518,30 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
   float keyword_num_samples = 0.0f;
   float picture_num_samples = 0.0f;
   float synth_num_samples   = 0.0f;
+  
+  bool synthLoaded = true;
+  
+  // datasets are saved only if they change
+  eegDirty = false;
+  synthDirty = false;
+  
+  // finishes saving of datasets if it was stopped by a crash
+  if(MeasurementJournal::recover(engine_journalFilename(modelDir)) == false)
+    logging.warn("finishing interrupted database save failed");
+  
+  // normalization statistics of saved datasets. statistics of datasets
+  // which are not used anymore are dropped
+  std::map<std::string, RunningStatistics> savedStatistics;
+  RunningStatistics::load(engine_statisticsFilename(modelDir), savedStatistics);
+  
+  statistics.clear();
+  
+  auto restoreStatistics = [&](const std::string& key) -> RunningStatistics& {
+    RunningStatistics& stats = statistics[key];
+    auto i = savedStatistics.find(key);
+    if(i != savedStatistics.end()) stats = i->second;
+    return stats;
+  };
 
   // loads EEG stream values
   {
@@ -3979,6 +4566,7 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
 	if(eegData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
 	  logging.info("PCA preprocessing EEG measurements [input]");
 	  eegData.preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
+	  eegDirty = true;
 	}
 	// keywordData[i].convert(1);
       }
@@ -3986,159 +4574,100 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
 	if(eegData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
 	  logging.info("Removing PCA processing of EEG measurements [input]");
 	  eegData.convert(0); // removes all preprocessings from input
+	  eegDirty = true;
 	}
 	
-	eegData.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
+	// saved EEG data keeps its normalization: recomputed only if it is missing
+	if(eegData.hasPreprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization) == false)
+	  eegData.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
       }
     }
-  }
     
-  
-  // loads databases into memory or initializes new ones
-  for(unsigned int i=0;i<keywords.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".ds";
+    // rows of old EEG data without retention information are treated as new
+    if(eegRetention.load(engine_retentionFilename(modelDir)) == false ||
+       eegRetention.size() != eegData.size(0))
+      eegRetention.reset(eegData.size(0));
     
-    keywordData[i].clear();
+    eegRetention.startSession();
     
-    if(keywordData[i].load(dbFilename) == false){
-      logging.info("Couldn't load keyword data => creating empty database");
-      
-      keywordData[i].createCluster(name1, eeg->getNumberOfSignals() + HMM_NUM_CLUSTERS);
-      keywordData[i].createCluster(name2, eeg->getNumberOfSignals());
-    }
-    else{
-      if(keywordData[i].getNumberOfClusters() != 2){
-	logging.error("Keyword data wrong number of clusters or data corruption => reset database");
-	
-	keywordData[i].clear();
-	keywordData[i].createCluster(name1, eeg->getNumberOfSignals() + HMM_NUM_CLUSTERS);
-	keywordData[i].createCluster(name2, eeg->getNumberOfSignals());
-      }
-    }
+    RunningStatistics& stats = restoreStatistics(engine_statisticsKey("eeg", 0));
     
-    const unsigned int datasize = keywordData[i].size(0);
+    if(engine_validStatistics(stats, eegData, 0) == false)
+      engine_rebuildStatistics(stats, eegData, 0);
+  }
     
-    if(keywordData[i].removeBadData() == false)
-      logging.warn("keywordData: bad data removal failed");
+  
+  // loads databases into memory or initializes new ones (in parallel)
+  {
+    const unsigned int K = keywords.size();
+    const unsigned int N = K + pictures.size();
     
-    if(datasize != keywordData[i].size(0)){
-      char buffer[80];
-      snprintf(buffer, 80, "Keyword %d: bad data removal reduced data: %d => %d\n",
-	       i, datasize, keywordData[i].size(0));
-      logging.warn(buffer);
-    }
+    const unsigned int inputs = eeg->getNumberOfSignals() + HMM_NUM_CLUSTERS;
+    const unsigned int outputs = eeg->getNumberOfSignals();
     
-    keyword_num_samples += keywordData[i].size(0);
+    // keyword and picture measurements are read from the store file
+    MeasurementStore store;
     
-    {
-      if(pcaPreprocess){
-	if(keywordData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing keyword measurements [input]");
-	  keywordData[i].preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	if(keywordData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing keyword measurements [output]");
-	  keywordData[i].preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	// keywordData[i].convert(1);
-      }
-      else{
-	if(keywordData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA processing of keyword measurements [input]");
-	  keywordData[i].convert(0); // removes all preprocessings from input
-	}
-	if(keywordData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA processing of keyword measurements [output]");
-	  keywordData[i].convert(1); // removes all preprocessings from output
-	}
-	
-	keywordData[i].preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
-	keywordData[i].preprocess(1, whiteice::dataset<>::dnMeanVarianceNormalization);
-	
-	// keywordData[i].convert(1);
+    if(store.open(engine_storeFilename(modelDir))){
+      if(store.getInputs() != inputs || store.getOutputs() != outputs){
+	logging.warn("measurement store has wrong dimensions => ignored");
+	store.close();
       }
-      
-      // keywordData[i].convert(1); // removes all preprocessings from output
     }
     
-  }
-  
-  logging.info("keywords measurement database loaded");
-	
-  
-  
-  for(unsigned int i=0;i<pictures.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(pictures[i] + eeg->getDataSourceName()) + ".ds";
-    
-    pictureData[i].clear();
+    std::vector<std::string> keys(N), filenames(N);
     
-    if(pictureData[i].load(dbFilename) == false){
-      logging.info("Couldn't load picture data => creating empty database");
+    for(unsigned int i=0;i<N;i++){
+      keys[i] = (i < K) ? engine_storeKey(keywords[i], true) : engine_storeKey(pictures[i-K], false);
       
-      pictureData[i].createCluster(name1, eeg->getNumberOfSignals() + HMM_NUM_CLUSTERS);
-      pictureData[i].createCluster(name2, eeg->getNumberOfSignals());
+      unsigned int s = 0;
+      if(store.find(keys[i], s)) continue; // old .ds file is not needed
       
-    }
-    else{
-      if(pictureData[i].getNumberOfClusters() != 2){
-	logging.error("Picture data wrong number of clusters or data corruption => reset database");
-	
-	pictureData[i].clear();
-	pictureData[i].createCluster(name1, eeg->getNumberOfSignals() + HMM_NUM_CLUSTERS);
-	pictureData[i].createCluster(name2, eeg->getNumberOfSignals());
-      }
+      if(i < K)
+	filenames[i] = modelDir + "/" + calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".ds";
+      else
+	filenames[i] = modelDir + "/" + calculateHashName(pictures[i-K] + eeg->getDataSourceName()) + ".ds";
     }
     
-    const unsigned int datasize = pictureData[i].size(0);
+    keywordDirty.resize(keywordData.size());
+    pictureDirty.resize(pictureData.size());
     
-    if(pictureData[i].removeBadData() == false)
-      logging.warn("pictureData: bad data removal failed");
+    // map is not modified by I/O threads
+    std::vector<RunningStatistics*> inputStats(N), outputStats(N);
     
-    if(datasize != pictureData[i].size(0)){
-      char buffer[80];
-      snprintf(buffer, 80, "Picture %d: bad data removal reduced data: %d => %d\n",
-	       i, datasize, pictureData[i].size(0));
-      logging.warn(buffer);
+    for(unsigned int i=0;i<N;i++){
+      inputStats[i] = &restoreStatistics(engine_statisticsKey(keys[i], 0));
+      outputStats[i] = &restoreStatistics(engine_statisticsKey(keys[i], 1));
     }
     
-    picture_num_samples += pictureData[i].size(0);
-    
-    
-    {
-      if(pcaPreprocess){
-	if(pictureData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing picture measurements [input]");
-	  pictureData[i].preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	
-	if(pictureData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing picture measurements [output]");
-	  pictureData[i].preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	
-	// pictureData[i].convert(1);
+#pragma omp parallel for schedule(dynamic) num_threads(DATABASE_IO_THREADS)
+    for(unsigned int i=0;i<N;i++){
+      if(i < K){
+	bool dirty = false;
+	engine_loadStimulusData(keywordData[i], store, keys[i], filenames[i],
+				"keyword", i, inputs, outputs,
+				*inputStats[i], *outputStats[i], dirty);
+	keywordDirty[i] = dirty;
       }
       else{
-	if(pictureData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA processing of picture measurements [input]");
-	  pictureData[i].convert(0); // removes all preprocessings from input
-	}
-	if(pictureData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA processing of picture measurements [output]");
-	  pictureData[i].convert(1); // removes all preprocessings from output
-	}
-	
-	pictureData[i].preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
-	pictureData[i].preprocess(1, whiteice::dataset<>::dnMeanVarianceNormalization);
-	
-	// pictureData[i].convert(1);
+	bool dirty = false;
+	engine_loadStimulusData(pictureData[i-K], store, keys[i], filenames[i],
+				"picture", i-K, inputs, outputs,
+				*inputStats[i], *outputStats[i], dirty);
+	pictureDirty[i-K] = dirty;
       }
-      
-      // pictureData[i].convert(1); // removes all preprocessings from output
     }
+    
+    store.close();
+    
+    for(unsigned int i=0;i<keywordData.size();i++)
+      keyword_num_samples += keywordData[i].size(0);
+    
+    for(unsigned int i=0;i<pictureData.size();i++)
+      picture_num_samples += pictureData[i].size(0);
   }
   
-  logging.info("picture measurement database loaded");
+  logging.info("keyword and picture measurement database loaded");
   
   // loads synth parameters data into memory
   // FIXME synth code doesn't use HMM brain state classification
@@ -4151,7 +4680,7 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
       synthData.createCluster(name1, eeg->getNumberOfSignals() + 2*synth->getNumberOfParameters());
       synthData.createCluster(name2, eeg->getNumberOfSignals());
       logging.info("Couldn't load synth data => creating empty database");
-      return false;
+      synthLoaded = false;
     }
     else{
       if(synthData.getNumberOfClusters() != 2){
@@ -4159,7 +4688,7 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
 	synthData.clear();
 	synthData.createCluster(name1, eeg->getNumberOfSignals() + 2*synth->getNumberOfParameters());
 	synthData.createCluster(name2, eeg->getNumberOfSignals());
-	return false;
+	synthLoaded = false;
       }
     }
     
@@ -4173,6 +4702,7 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
       snprintf(buffer, 80, "Synth data: bad data removal reduced data: %d => %d\n",
 	       datasize, synthData.size(0));
       logging.warn(buffer);
+      synthDirty = true;
     }
     
     synth_num_samples += synthData.size(0);
@@ -4182,11 +4712,13 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
 	if(synthData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
 	  logging.info("PCA preprocessing sound measurements [input]");
 	  synthData.preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
+	  synthDirty = true;
 	}
 	
 	if(synthData.hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
 	  logging.info("PCA preprocessing sound measurements [output]");
 	  synthData.preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
+	  synthDirty = true;
 	}
 	
       }
@@ -4194,11 +4726,13 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
 	if(synthData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
 	  logging.info("Removing PCA processing of sound measurements [input]");
 	  synthData.convert(0); // removes all preprocessings from input
+	  synthDirty = true;
 	}
 	
 	if(synthData.hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
 	  logging.info("Removing PCA processing of sound measurements [output]");
 	  synthData.convert(1); // removes all preprocessings from input
+	  synthDirty = true;
 	}
 	
 	synthData.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
@@ -4208,10 +4742,33 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
       }
     }
     
+    for(unsigned int c=0;c<2;c++){
+      RunningStatistics& stats = restoreStatistics(engine_statisticsKey("synth", c));
+      
+      if(engine_validStatistics(stats, synthData, c) == false)
+	engine_rebuildStatistics(stats, synthData, c);
+    }
+    
     logging.info("synth measurement database loaded");
   }
   
   
+  // adds measurements which were not saved to datasets
+  if(engine_replayJournal(modelDir) == false)
+    logging.warn("opening measurement journal failed");
+  
+  // policy may have changed after the data was saved
+  if(engine_applyRetention() == false)
+    logging.warn("removing old EEG data failed");
+  
+  
+  // builds nearest neighbour search structures for RBF model
+  if(dataRBFmodel){
+    if(engine_buildIndexes() == false)
+      logging.warn("building RBF model search indexes failed");
+  }
+  
+  
   // reports average samples in each dataset
   {
     if(keywordData.size() > 0){
@@ -4233,7 +4790,58 @@ bool ResonanzEngine::engine_loadDatabase(const std::string& modelDir)
   
   
   
-  return true;
+  return synthLoaded;
+}
+
+
+std::string ResonanzEngine::engine_journalFilename(const std::string& modelDir) const
+{
+  return modelDir + "/" + calculateHashName("journal" + eeg->getDataSourceName()) + ".journal";
+}
+
+
+bool ResonanzEngine::engine_replayJournal(const std::string& modelDir)
+{
+  const std::string filename = engine_journalFilename(modelDir);
+  const unsigned int E = eeg->getNumberOfSignals();
+  const unsigned int P = synth ? synth->getNumberOfParameters() : 0;
+  
+  std::vector<MeasurementJournal::Record> records;
+  
+  if(MeasurementJournal::read(filename, E, P, records) && records.size() > 0){
+    // stimuli are found using their names
+    std::map<unsigned long long, unsigned int> pics, keys;
+    
+    for(unsigned int i=0;i<pictures.size();i++)
+      pics[MeasurementJournal::hash(pictures[i])] = i;
+    
+    for(unsigned int i=0;i<keywords.size();i++)
+      keys[MeasurementJournal::hash(keywords[i])] = i;
+    
+    unsigned int replayed = 0;
+    
+    for(const auto& r : records){
+      unsigned int pic = pictures.size();
+      unsigned int key = keywords.size();
+      
+      auto p = pics.find(r.picture);
+      if(p != pics.end()) pic = p->second;
+      
+      auto k = keys.find(r.keyword);
+      if(k != keys.end()) key = k->second;
+      
+      if(engine_addMeasurement(pic, key, r.hmmState, r.eegBefore, r.eegAfter,
+			       r.synthBefore, r.synthAfter))
+	replayed++;
+    }
+    
+    char buffer[128];
+    snprintf(buffer, 128, "replayed %d/%d measurements from journal",
+	     replayed, (int)records.size());
+    logging.info(buffer);
+  }
+  
+  return measurementJournal.open(filename, E, P);
 }
 
 
@@ -4245,21 +4853,9 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
 {
   if(eegBefore.size() != eegAfter.size()) return false;
   
-  std::vector< whiteice::math::blas_real<float> > t1, t2, t3;
-  t1.resize(eegBefore.size() + HMM_NUM_CLUSTERS);
-  t2.resize(eegAfter.size());
-  t3.resize(eegAfter.size());
-  
-  // initialize to zero [no bad data possible]
-  for(auto& t : t1) t = 0.0f; 
-  for(auto& t : t2) t = 0.0f;
-  for(auto& t : t3) t = 0.0f;
-  
   // heavy checks against correctness of the data because buggy code/hardware
   // seem to introduce bad measurment data into database..
   
-  const whiteice::math::blas_real<float> delta = MEASUREMODE_DELAY_MS/1000.0f;
-  
   for(unsigned int i=0;i<eegBefore.size();i++){
     auto& before = eegBefore[i];
     auto& after  = eegAfter[i];
@@ -4289,22 +4885,50 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
       logging.error("store measurement. bad data: eegAfter is NaN or Inf");
       return false;
     }
+  }
+  
+  if(synth){
+    for(unsigned int i=0;i<synthBefore.size();i++){
+      if(synthBefore[i] < 0.0f){
+	logging.error("store measurement. bad data: synthBefore < 0.0");
+	return false;
+      }
+      else if(synthBefore[i] > 1.0f){
+	logging.error("store measurement. bad data: synthBefore > 1.0");
+	return false;
+      }
+      else if(whiteice::math::isnan(synthBefore[i]) || whiteice::math::isinf(synthBefore[i])){
+	logging.error("store measurement. bad data: synthBefore is NaN or Inf");
+	return false;
+      }
+    }
     
-	        
-    t1[i] = eegBefore[i];
-    t2[i] = (eegAfter[i] - eegBefore[i])/delta; // stores aprox "derivate": dEEG/dt
-    t3[i] = eegAfter[i];
+    for(unsigned int i=0;i<synthAfter.size();i++){
+      if(synthAfter[i] < 0.0f){
+	logging.error("store measurement. bad data: synthAfter < 0.0");
+	return false;
+      }
+      else if(synthAfter[i] > 1.0f){
+	logging.error("store measurement. bad data: synthAfter > 1.0");
+	return false;
+      }
+      else if(whiteice::math::isnan(synthAfter[i]) || whiteice::math::isinf(synthAfter[i])){
+	logging.error("store measurement. bad data: synthAfter is NaN or Inf");
+	return false;
+      }
+    }
   }
 
   
   // updates HMM brain state model's state
+  unsigned int state = HMM_NUM_CLUSTERS;
   {
     std::lock_guard<std::mutex> lock(hmm_mutex);
     
     if(kmeans == NULL || hmm == NULL){
       logging.warn("WARN: engine_storeMeasurement(): K-Means or HMM model doesn't exist. Doesn't save HMM brain state with data!");
 
-      HMMstate = t1.size(); // DISABLE ADDING BRAINSTATE CLASSIFICATION TO DATA
+      HMMstate = eegBefore.size() + HMM_NUM_CLUSTERS; // DISABLE ADDING BRAINSTATE CLASSIFICATION TO DATA
     }
     else{
 #if 0
@@ -4314,13 +4938,62 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
       hmm->next_state(HMMstate, nextState, dataCluster);
       HMMstate = nextState;
 #endif
+      state = HMMstate;
+    }
+  }
+  
+  // measurement is written to the journal before it is added to datasets
+  if(measurementJournal.isOpen()){
+    MeasurementJournal::Record r;
+    
+    if(pic < pictures.size()) r.picture = MeasurementJournal::hash(pictures[pic]);
+    if(key < keywords.size()) r.keyword = MeasurementJournal::hash(keywords[key]);
+    
+    r.hmmState = state;
+    r.eegBefore = eegBefore;
+    r.eegAfter = eegAfter;
+    
+    if(synth){
+      r.synthBefore = synthBefore;
+      r.synthAfter = synthAfter;
     }
+    
+    if(measurementJournal.append(r) == false)
+      logging.warn("writing measurement to journal failed");
   }
   
+  return engine_addMeasurement(pic, key, state, eegBefore, eegAfter, synthBefore, synthAfter);
+}
 
 
+bool ResonanzEngine::engine_addMeasurement(unsigned int pic, unsigned int key, unsigned int hmmState,
+					   const std::vector<float>& eegBefore, 
+					   const std::vector<float>& eegAfter,
+					   const std::vector<float>& synthBefore,
+					   const std::vector<float>& synthAfter)
+{
+  if(eegBefore.size() != eegAfter.size()) return false;
+  
+  std::vector< whiteice::math::blas_real<float> > t1, t2, t3;
+  t1.resize(eegBefore.size() + HMM_NUM_CLUSTERS);
+  t2.resize(eegAfter.size());
+  t3.resize(eegAfter.size());
+  
+  // initialize to zero [no bad data possible]
+  for(auto& t : t1) t = 0.0f; 
+  for(auto& t : t2) t = 0.0f;
+  for(auto& t : t3) t = 0.0f;
+  
+  const whiteice::math::blas_real<float> delta = MEASUREMODE_DELAY_MS/1000.0f;
+  
+  for(unsigned int i=0;i<eegBefore.size();i++){
+    t1[i] = eegBefore[i];
+    t2[i] = (eegAfter[i] - eegBefore[i])/delta; // stores aprox "derivate": dEEG/dt
+    t3[i] = eegAfter[i];
+  }
+
   for(unsigned int i=eegBefore.size();i<t1.size();i++){
-    if(i-eegBefore.size() == HMMstate) t1[i] = 1.0f;
+    if(i-eegBefore.size() == hmmState) t1[i] = 1.0f;
     else t1[i] = 0.0f;
   }
   
@@ -4329,6 +5002,11 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
       logging.error("Adding new keyword data FAILED");
       return false;
     }
+    
+    if(key < keywordDirty.size()) keywordDirty[key] = true;
+    
+    engine_updateStatistics(engine_statisticsKey(engine_storeKey(keywords[key], true), 0), t1);
+    engine_updateStatistics(engine_statisticsKey(engine_storeKey(keywords[key], true), 1), t2);
   }
   
   if(pic < pictureData.size()){
@@ -4336,12 +5014,28 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
       logging.error("Adding new picture data FAILED");
       return false;
     }
+    
+    if(pic < pictureDirty.size()) pictureDirty[pic] = true;
+    
+    engine_updateStatistics(engine_statisticsKey(engine_storeKey(pictures[pic], false), 0), t1);
+    engine_updateStatistics(engine_statisticsKey(engine_storeKey(pictures[pic], false), 1), t2);
   }
 
   if(eegData.add(0, t3) == false){
     logging.error("Adding EEG measurement FAILED");
     return false;
   }
+  
+  eegDirty = true;
+  
+  engine_updateStatistics(engine_statisticsKey("eeg", 0), t3);
+  
+  eegRetention.add();
+  
+  if(eegRetention.needsCompaction()){
+    if(engine_applyRetention() == false)
+      logging.warn("removing old EEG data failed");
+  }
 
   // FIXME: don't handle HMM brain states at all
   if(synth){
@@ -4354,39 +5048,11 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
     for(auto& t : input)  t = 0.0f; 
     for(auto& t : output) t = 0.0f;
     
-    for(unsigned int i=0;i<synthBefore.size();i++){
-      if(synthBefore[i] < 0.0f){
-	logging.error("store measurement. bad data: synthBefore < 0.0");
-	return false;
-      }
-      else if(synthBefore[i] > 1.0f){
-	logging.error("store measurement. bad data: synthBefore > 1.0");
-	return false;
-      }
-      else if(whiteice::math::isnan(synthBefore[i]) || whiteice::math::isinf(synthBefore[i])){
-	logging.error("store measurement. bad data: synthBefore is NaN or Inf");
-	return false;
-      }
-      
+    for(unsigned int i=0;i<synthBefore.size();i++)
       input[i] = synthBefore[i];
-    }
     
-    for(unsigned int i=0;i<synthAfter.size();i++){
-      if(synthAfter[i] < 0.0f){
-	logging.error("store measurement. bad data: synthAfter < 0.0");
-	return false;
-      }
-      else if(synthAfter[i] > 1.0f){
-	logging.error("store measurement. bad data: synthAfter > 1.0");
-	return false;
-      }
-      else if(whiteice::math::isnan(synthAfter[i]) || whiteice::math::isinf(synthAfter[i])){
-	logging.error("store measurement. bad data: synthAfter is NaN or Inf");
-	return false;
-      }
-      
+    for(unsigned int i=0;i<synthAfter.size();i++)
       input[synthBefore.size() + i] = synthAfter[i];
-    }
     
     for(unsigned int i=0;i<eegBefore.size();i++){
       input[synthBefore.size()+synthAfter.size() + i] = eegBefore[i];
@@ -4400,6 +5066,11 @@ bool ResonanzEngine::engine_storeMeasurement(unsigned int pic, unsigned int key,
       logging.error("Adding new synth data FAILED");
       return false;
     }
+    
+    synthDirty = true;
+    
+    engine_updateStatistics(engine_statisticsKey("synth", 0), input);
+    engine_updateStatistics(engine_statisticsKey("synth", 1), output);
   }
   
   return true;
@@ -4411,165 +5082,539 @@ bool ResonanzEngine::engine_saveDatabase(const std::string& modelDir)
   std::lock_guard<std::mutex> lock(database_mutex);
 
   
+  if(eegData.getNumberOfClusters() != 1) return false;
+  
+  // files are written to temporary names and committed with the journal
+  std::vector<std::string> saved;
+  bool eegSaved = false, storeSaved = false, synthSaved = false;
+  
   // saves eegData to files
-  {
+  if(eegDirty){
     std::string dbFilename = modelDir + "/" + calculateHashName("eegData" + eeg->getDataSourceName()) + ".ds";
-
-    if(eegData.getNumberOfClusters() != 1) return false;
-
-    eegData.convert(0);
-
-    if(eegData.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization) == false)
-      return false;
     
-    if(eegData.save(dbFilename) == false){
+    RunningStatistics& stats = statistics[engine_statisticsKey("eeg", 0)];
+    
+    if(engine_validStatistics(stats, eegData, 0) == false)
+      engine_rebuildStatistics(stats, eegData, 0);
+    
+    // normalization is recomputed only if new measurements have changed it
+    if(stats.changed(NORMALIZATION_TOLERANCE) ||
+       eegData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true ||
+       eegData.hasPreprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization) == false){
+      eegData.convert(0);
+      
+      if(eegData.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization) == false)
+	return false;
+      
+      stats.mark();
+    }
+    
+    if(eegData.save(MeasurementJournal::newName(dbFilename)) == false){
       logging.info("Couldn't save EEG data");
       return false;
     }
+    
+    saved.push_back(dbFilename);
+    
+    if(eegRetention.save(MeasurementJournal::newName(engine_retentionFilename(modelDir))) == false)
+      logging.warn("Couldn't save EEG retention data");
+    else
+      saved.push_back(engine_retentionFilename(modelDir));
+    
+    eegSaved = true;
   }
   
-  // saves databases from memory
-  for(unsigned int i=0;i<keywordData.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".ds";
+  // saves keyword and picture databases to the store file if any of them has changed
+  {
+    const unsigned int K = keywordData.size();
+    const unsigned int N = K + pictureData.size();
     
-    if(keywordData[i].removeBadData() == false)
-      logging.warn("keywordData: bad data removal failed");
+    std::vector<unsigned int> changed;
     
+    for(unsigned int i=0;i<K;i++)
+      if(i >= keywordDirty.size() || keywordDirty[i]) changed.push_back(i);
     
-    {
-      if(pcaPreprocess){
-	if(keywordData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing keyword measurements data [input]");
-	  keywordData[i].preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
+    for(unsigned int i=K;i<N;i++)
+      if(i-K >= pictureDirty.size() || pictureDirty[i-K]) changed.push_back(i);
+    
+    if(changed.size() > 0){
+      std::vector<std::string> keys(N);
+      
+      for(unsigned int i=0;i<N;i++)
+	keys[i] = (i < K) ? engine_storeKey(keywords[i], true) : engine_storeKey(pictures[i-K], false);
+      
+      // map is not modified by I/O threads
+      std::vector<RunningStatistics*> inputStats(changed.size()), outputStats(changed.size());
+      
+      for(unsigned int c=0;c<changed.size();c++){
+	inputStats[c] = &statistics[engine_statisticsKey(keys[changed[c]], 0)];
+	outputStats[c] = &statistics[engine_statisticsKey(keys[changed[c]], 1)];
+      }
+      
+      // bad data removal and preprocessing of changed datasets (in parallel)
+#pragma omp parallel for schedule(dynamic) num_threads(DATABASE_IO_THREADS)
+      for(unsigned int c=0;c<changed.size();c++){
+	const unsigned int i = changed[c];
+	
+	if(i < K) engine_prepareStimulusData(keywordData[i], "keyword", *inputStats[c], *outputStats[c]);
+	else engine_prepareStimulusData(pictureData[i-K], "picture", *inputStats[c], *outputStats[c]);
+      }
+      
+      std::vector< std::vector<float> > columns(N);
+      std::vector<char> failed(N, 0);
+      std::vector<char> dirty(N, 0);
+      
+      for(const auto& i : changed) dirty[i] = 1;
+      
+      // unchanged datasets are copied from the current store file
+      MeasurementStore store;
+      store.open(engine_storeFilename(modelDir));
+      
+      // changed datasets (and datasets already there) are written to the segment
+      // file. whole store is rewritten only when segment has grown too large
+      std::vector<char> segment(N, 0);
+      unsigned long long segmentRows = 0, totalRows = 0;
+      
+      for(unsigned int i=0;i<N;i++){
+	const unsigned int rows = (i < K) ? keywordData[i].size(0) : pictureData[i-K].size(0);
+	unsigned int s = 0;
+	
+	if(dirty[i] || store.find(keys[i], s) == false || store.inSegment(s)){
+	  segment[i] = 1;
+	  segmentRows += rows;
+	}
+	
+	totalRows += rows;
+      }
+      
+      const bool merge = (store.isOpen() == false ||
+			  segmentRows > STORE_SEGMENT_MAX*totalRows);
+      
+#pragma omp parallel for schedule(dynamic) num_threads(DATABASE_IO_THREADS)
+      for(unsigned int i=0;i<N;i++){
+	if(merge == false && segment[i] == 0) continue; // stays in the store file
+	
+	const whiteice::dataset<>& data = (i < K) ? keywordData[i] : pictureData[i-K];
+	
+	unsigned int s = 0;
+	
+	if(dirty[i] == 0 && store.find(keys[i], s) && store.rows(s) == data.size(0) &&
+	   store.getInputs() == data.dimension(0) && store.getOutputs() == data.dimension(1)){
+	  const unsigned int R = store.rows(s);
+	  const unsigned int C = store.getInputs() + store.getOutputs();
+	  
+	  columns[i].resize((unsigned long long)R*C);
+	  
+	  for(unsigned int c=0;c<C && R>0;c++)
+	    memcpy(columns[i].data() + (unsigned long long)c*R, store.column(s, c), R*sizeof(float));
 	}
-	if(keywordData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing keyword measurements data [output]");
-	  keywordData[i].preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
+	else if(MeasurementStore::extract(data, columns[i]) == false){
+	  failed[i] = 1;
 	}
+      }
+      
+      store.close(); // store file is replaced
+      
+      for(const auto& f : failed){
+	if(f){
+	  logging.error("Converting keyword or picture data for saving failed");
+	  return false;
+	}
+      }
+      
+      const unsigned int inputs = eeg->getNumberOfSignals() + HMM_NUM_CLUSTERS;
+      const unsigned int outputs = eeg->getNumberOfSignals();
+      
+      const std::string storeFilename = engine_storeFilename(modelDir);
+      const std::string segmentFilename = MeasurementStore::segmentName(storeFilename);
+      
+      bool ok = true;
+      
+      if(merge){
+	// store file has all datasets and segment is empty
+	ok = MeasurementStore::write(MeasurementJournal::newName(storeFilename),
+				     inputs, outputs, keys, columns) &&
+	  MeasurementStore::write(MeasurementJournal::newName(segmentFilename),
+				  inputs, outputs, std::vector<std::string>(),
+				  std::vector< std::vector<float> >());
 	
-	// keywordData[i].convert(1); // removes preprocessigns from output
+	if(ok){
+	  saved.push_back(storeFilename);
+	  saved.push_back(segmentFilename);
+	}
       }
       else{
-	if(keywordData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA preprocessing from keyword measurements data [input]");
-	  keywordData[i].convert(0); // removes all preprocessings from input
-	}
+	std::vector<std::string> segmentKeys;
+	std::vector< std::vector<float> > segmentColumns;
 	
-	if(keywordData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA preprocessing from keyword measurements data [output]");
-	  keywordData[i].convert(1); // removes all preprocessings from input
+	for(unsigned int i=0;i<N;i++){
+	  if(segment[i] == 0) continue;
+	  segmentKeys.push_back(keys[i]);
+	  segmentColumns.push_back(std::move(columns[i]));
 	}
-
-	keywordData[i].convert(0);
-	keywordData[i].convert(1);
 	
-	keywordData[i].preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
-	keywordData[i].preprocess(1, whiteice::dataset<>::dnMeanVarianceNormalization);
+	ok = MeasurementStore::write(MeasurementJournal::newName(segmentFilename),
+				     inputs, outputs, segmentKeys, segmentColumns);
 	
-	// keywordData[i].convert(1); // removes preprocessigns from output
+	if(ok) saved.push_back(segmentFilename);
+      }
+      
+      if(ok == false){
+	logging.error("Saving keyword and picture data failed");
+	return false;
       }
       
-      // keywordData[i].convert(1); // removes all preprocessings from output
+      storeSaved = true;
+      
+      char buffer[128];
+      snprintf(buffer, 128, "saved measurement store (%d/%d datasets changed, %s)",
+	       (int)changed.size(), (int)N, merge ? "merged" : "segment");
+      logging.info(buffer);
     }
+  }
+  
+  // stores sound synthesis measurements
+  if(synth && synthDirty){
+    std::string dbFilename = modelDir + "/" + calculateHashName(eeg->getDataSourceName() + synth->getSynthesizerName()) + ".ds";
     
-    if(keywordData[i].save(dbFilename) == false){
-      logging.error("Saving keyword data failed");
+    engine_prepareStimulusData(synthData, "sound",
+			       statistics[engine_statisticsKey("synth", 0)],
+			       statistics[engine_statisticsKey("synth", 1)]);
+    
+    if(synthData.save(MeasurementJournal::newName(dbFilename)) == false){
+      logging.info("Saving synth data failed");
       return false;
     }
+    
+    saved.push_back(dbFilename);
+    synthSaved = true;
   }
   
+  if(RunningStatistics::save(MeasurementJournal::newName(engine_statisticsFilename(modelDir)), statistics) == false)
+    logging.warn("saving normalization statistics failed");
+  else
+    saved.push_back(engine_statisticsFilename(modelDir));
   
-  for(unsigned int i=0;i<pictureData.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(pictures[i] + eeg->getDataSourceName()) + ".ds";
-    
-    if(pictureData[i].removeBadData() == false)
-      logging.warn("pictureData: bad data removal failed");
-    
-    
-    {
-      if(pcaPreprocess){
-	if(pictureData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing picture measurements data [input]");
-	  pictureData[i].preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	if(pictureData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing picture measurements data [output]");
-	  pictureData[i].preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	// pictureData[i].convert(1); // removes preprocessigns from output
-      }
-      else{
-	if(pictureData[i].hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA preprocessing from picture measurements data [input]");
-	  pictureData[i].convert(0); // removes all preprocessings from input
-	}
-	if(pictureData[i].hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA preprocessing from picture measurements data [output]");
-	  pictureData[i].convert(1); // removes all preprocessings from input
-	}
+  // files are synced and replace the old ones, journal has been folded into them
+  if(measurementJournal.commit(saved) == false){
+    logging.error("committing saved database files failed");
+    return false;
+  }
+  
+  if(measurementJournal.isOpen() == false)
+    remove(engine_journalFilename(modelDir).c_str());
+  
+  if(eegSaved) eegDirty = false;
+  if(synthSaved) synthDirty = false;
+  
+  if(storeSaved){
+    keywordDirty.assign(keywordData.size(), false);
+    pictureDirty.assign(pictureData.size(), false);
+  }
+  
+  return true;
+}
 
-	pictureData[i].convert(0);
-	pictureData[i].convert(1);
-	
-	pictureData[i].preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
-	pictureData[i].preprocess(1, whiteice::dataset<>::dnMeanVarianceNormalization);
-	
-	// pictureData[i].convert(1);
-      }
+
+// loads (or creates) stimulus dataset and applies preprocessing, dirty is set
+// if dataset was changed and needs to be saved. stimulus is loaded from the store
+// or imported from its old .ds file. called concurrently for different datasets
+bool ResonanzEngine::engine_loadStimulusData(whiteice::dataset<>& data,
+					     const MeasurementStore& store,
+					     const std::string& key,
+					     const std::string& dbFilename,
+					     const std::string& type,
+					     unsigned int index,
+					     unsigned int inputs, unsigned int outputs,
+					     RunningStatistics& inputStats,
+					     RunningStatistics& outputStats,
+					     bool& dirty)
+{
+  std::string name1 = "input";
+  std::string name2 = "output";
+  
+  dirty = false;
+  
+  data.clear();
+  
+  unsigned int s = 0;
+  
+  // store has values without preprocessing: adding preprocessing doesn't change it
+  bool raw = false;
+  
+  if(store.find(key, s) && store.get(s, data)){
+    raw = true;
+  }
+  else if(data.load(dbFilename) == false){
+    logging.info("Couldn't load " + type + " data => creating empty database");
+    
+    data.clear();
+    data.createCluster(name1, inputs);
+    data.createCluster(name2, outputs);
+  }
+  else{
+    if(data.getNumberOfClusters() != 2){
+      logging.error(type + " data wrong number of clusters or data corruption => reset database");
       
-      // pictureData[i].convert(1); // removes all preprocessings from output
+      data.clear();
+      data.createCluster(name1, inputs);
+      data.createCluster(name2, outputs);
     }
     
-    if(pictureData[i].save(dbFilename) == false){
-      logging.error("Saving picture data failed");
-      return false;
+    dirty = true; // imported to the store
+  }
+  
+  const unsigned int datasize = data.size(0);
+  
+  // bad data was removed from store data before it was saved
+  if(raw == false && data.removeBadData() == false)
+    logging.warn(type + "Data: bad data removal failed");
+  
+  if(datasize != data.size(0)){
+    char buffer[80];
+    snprintf(buffer, 80, "%s %d: bad data removal reduced data: %d => %d\n",
+	     type.c_str(), index, datasize, data.size(0));
+    logging.warn(buffer);
+    dirty = true;
+  }
+  
+  if(pcaPreprocess){
+    if(data.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
+      logging.info("PCA preprocessing " + type + " measurements [input]");
+      data.preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
+      if(!raw) dirty = true;
+    }
+    if(data.hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
+      logging.info("PCA preprocessing " + type + " measurements [output]");
+      data.preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
+      if(!raw) dirty = true;
+    }
+  }
+  else{
+    if(data.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
+      logging.info("Removing PCA processing of " + type + " measurements [input]");
+      data.convert(0); // removes all preprocessings from input
+      dirty = true;
+    }
+    if(data.hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
+      logging.info("Removing PCA processing of " + type + " measurements [output]");
+      data.convert(1); // removes all preprocessings from output
+      dirty = true;
     }
+    
+    data.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
+    data.preprocess(1, whiteice::dataset<>::dnMeanVarianceNormalization);
   }
   
-  // stores sound synthesis measurements
-  if(synth){
-    std::string dbFilename = modelDir + "/" + calculateHashName(eeg->getDataSourceName() + synth->getSynthesizerName()) + ".ds";
+  for(unsigned int c=0;c<2;c++){
+    RunningStatistics& stats = (c == 0) ? inputStats : outputStats;
     
-    if(synthData.removeBadData() == false)
-      logging.warn("synthData: bad data removal failed");
+    if(engine_validStatistics(stats, data, c) == false)
+      engine_rebuildStatistics(stats, data, c);
     
-    {
-      if(pcaPreprocess){
-	if(synthData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing sound measurements [input]");
-	  synthData.preprocess(0, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	
-	if(synthData.hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == false){
-	  logging.info("PCA preprocessing sound measurements [output]");
-	  synthData.preprocess(1, whiteice::dataset<>::dnCorrelationRemoval);
-	}
-	
-	// synthData.convert(1);
-      }
-      else{
-	if(synthData.hasPreprocess(0, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA processing of sound measurements [input]");
-	  synthData.convert(0); // removes all preprocessings from input
-	}
-	if(synthData.hasPreprocess(1, whiteice::dataset<>::dnCorrelationRemoval) == true){
-	  logging.info("Removing PCA processing of sound measurements [output]");
-	  synthData.convert(1); // removes all preprocessings from input
-	}
-	
-	synthData.preprocess(0, whiteice::dataset<>::dnMeanVarianceNormalization);
-	synthData.preprocess(1, whiteice::dataset<>::dnMeanVarianceNormalization);
-	
-	// synthData.convert(1);
-      }
+    // preprocessing of store data was just computed from all measurements
+    if(raw) stats.mark();
+  }
+  
+  return true;
+}
+
+
+// removes bad data and recomputes preprocessing of stimulus (or sound) dataset
+// before it is saved if its statistics have changed. called concurrently for
+// different datasets
+bool ResonanzEngine::engine_prepareStimulusData(whiteice::dataset<>& data,
+						const std::string& type,
+						RunningStatistics& inputStats,
+						RunningStatistics& outputStats)
+{
+  const unsigned int datasize = data.size(0);
+  
+  if(data.removeBadData() == false)
+    logging.warn(type + "Data: bad data removal failed");
+  
+  // statistics still include removed measurements
+  for(unsigned int c=0;c<2;c++){
+    RunningStatistics& stats = (c == 0) ? inputStats : outputStats;
+    
+    if(datasize != data.size(0) || engine_validStatistics(stats, data, c) == false)
+      engine_rebuildStatistics(stats, data, c);
+  }
+  
+  const auto norm = pcaPreprocess ?
+    whiteice::dataset<>::dnCorrelationRemoval : whiteice::dataset<>::dnMeanVarianceNormalization;
+  
+  bool recompute =
+    inputStats.changed(NORMALIZATION_TOLERANCE) || outputStats.changed(NORMALIZATION_TOLERANCE);
+  
+  for(unsigned int c=0;c<2;c++){
+    if(data.hasPreprocess(c, norm) == false) recompute = true;
+    
+    if(pcaPreprocess == false &&
+       data.hasPreprocess(c, whiteice::dataset<>::dnCorrelationRemoval) == true)
+      recompute = true;
+  }
+  
+  if(recompute){
+    logging.info("recomputing preprocessing of " + type + " measurements");
+    
+    data.convert(0); // removes old preprocessings
+    data.convert(1);
+    
+    data.preprocess(0, norm);
+    data.preprocess(1, norm);
+    
+    inputStats.mark();
+    outputStats.mark();
+  }
+  
+  return true;
+}
+
+
+std::string ResonanzEngine::engine_storeFilename(const std::string& modelDir) const
+{
+  return modelDir + "/" + calculateHashName("measurements" + eeg->getDataSourceName()) + ".store";
+}
+
+
+std::string ResonanzEngine::engine_storeKey(const std::string& stimulus, bool keyword) const
+{
+  return (keyword ? "keyword:" : "picture:") + stimulus;
+}
+
+
+std::string ResonanzEngine::engine_retentionFilename(const std::string& modelDir) const
+{
+  return modelDir + "/" + calculateHashName("eegRetention" + eeg->getDataSourceName()) + ".retention";
+}
+
+
+// removes EEG stream rows not selected by the retention policy
+bool ResonanzEngine::engine_applyRetention()
+{
+  const unsigned int N = eegData.size(0);
+  
+  if(eegRetention.size() != N) eegRetention.reset(N);
+  
+  std::vector<unsigned int> keep;
+  
+  if(eegRetention.select(keep) == false) return true; // nothing to remove
+  
+  std::vector< whiteice::math::vertex<> > rows(keep.size());
+  
+  for(unsigned int i=0;i<keep.size();i++)
+    rows[i] = eegData.access(0, keep[i]);
+  
+  // rows are already preprocessed. preprocessing is recomputed
+  // when saved because statistics don't match the data anymore
+  if(eegData.clearData(0) == false) return false;
+  
+  if(rows.size() > 0)
+    if(eegData.add(0, rows, true) == false) return false;
+  
+  eegDirty = true;
+  
+  char buffer[128];
+  snprintf(buffer, 128, "EEG retention: %d => %d stream samples", N, (int)rows.size());
+  logging.info(buffer);
+  
+  return true;
+}
+
+
+std::string ResonanzEngine::engine_statisticsFilename(const std::string& modelDir) const
+{
+  return modelDir + "/" + calculateHashName("statistics" + eeg->getDataSourceName()) + ".stats";
+}
+
+
+std::string ResonanzEngine::engine_statisticsKey(const std::string& dataset, unsigned int cluster) const
+{
+  return dataset + "#" + std::to_string(cluster);
+}
+
+
+// statistics describe all measurements of the dataset cluster
+bool ResonanzEngine::engine_validStatistics(const RunningStatistics& stats,
+					    const whiteice::dataset<>& data, unsigned int cluster) const
+{
+  return (stats.dimension() == data.dimension(cluster) &&
+	  stats.count() == data.size(cluster) &&
+	  stats.hasCovariance() == pcaPreprocess);
+}
+
+
+// computes statistics from all measurements (no reference statistics so
+// preprocessing is recomputed when the dataset is saved next time)
+bool ResonanzEngine::engine_rebuildStatistics(RunningStatistics& stats,
+					      const whiteice::dataset<>& data, unsigned int cluster) const
+{
+  const unsigned int D = data.dimension(cluster);
+  
+  stats.reset(D, pcaPreprocess);
+  
+  std::vector<float> v(D);
+  whiteice::math::vertex<> x;
+  
+  for(unsigned int i=0;i<data.size(cluster);i++){
+    x = data.access(cluster, i);
+    
+    if(data.invpreprocess(cluster, x) == false || x.size() != D){
+      stats.reset(D, pcaPreprocess);
+      return false;
     }
     
-    if(synthData.save(dbFilename) == false){
-      logging.info("Saving synth data failed");
-      return false;
-    }
+    for(unsigned int d=0;d<D;d++)
+      v[d] = x[d].c[0];
+    
+    stats.add(v);
+  }
+  
+  return true;
+}
+
+
+void ResonanzEngine::engine_updateStatistics(const std::string& key,
+					     const std::vector< whiteice::math::blas_real<float> >& x)
+{
+  auto i = statistics.find(key);
+  if(i == statistics.end()) return; // rebuilt from data when saved
+  
+  std::vector<float> v(x.size());
+  
+  for(unsigned int d=0;d<x.size();d++)
+    v[d] = x[d].c[0];
+  
+  i->second.add(v);
+}
+
+
+// loads stimulus data for read only analysis from the store (or old .ds file)
+// with the same preprocessing as used by the engine
+bool ResonanzEngine::engine_loadStimulusView(const MeasurementStore& store,
+					     const std::string& stimulus, bool keyword,
+					     const std::string& modelDir,
+					     whiteice::dataset<>& data) const
+{
+  unsigned int s = 0;
+  
+  data.clear();
+  
+  if(store.find(engine_storeKey(stimulus, keyword), s) == false){
+    const std::string dbFilename = modelDir + "/" +
+      calculateHashName(stimulus + eeg->getDataSourceName()) + ".ds";
+    
+    return data.load(dbFilename);
   }
   
+  if(store.get(s, data) == false) return false;
+  
+  const auto norm = pcaPreprocess ?
+    whiteice::dataset<>::dnCorrelationRemoval : whiteice::dataset<>::dnMeanVarianceNormalization;
+  
+  data.preprocess(0, norm);
+  data.preprocess(1, norm);
   
   return true;
 }
@@ -4617,14 +5662,6 @@ std::string ResonanzEngine::calculateHashName(const std::string& filename) const
 bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int picture,
 				       const std::vector<float>& synthParams)
 {
-  SDL_Surface* surface = SDL_GetWindowSurface(window);
-  if(surface == nullptr)
-    return false;
-  
-  if(SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0, 0, 0)) != 0)
-    return false;
-  
-  int bgcolor = 0;
   int elementsDisplayed = 0;
   
   {
@@ -4634,6 +5671,62 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
     logging.info(buffer);
   }
   
+  if(renderer){
+    // render thread draws and presents the scene (engine_renderScene())
+    lastSceneSequence = renderer->post(message, picture, tick);
+    elementsDisplayed++;
+  }
+  else if(window != nullptr){
+    elementsDisplayed += engine_drawScreen(SDL_GetWindowSurface(window), message, picture, tick);
+  }
+  
+  
+  ///////////////////////////////////////////////////////////////////////
+  // plays sound
+  if(synth)
+  {
+    // changes synth parameters only as fast sound synthesis can generate
+    // meaningful sounds (sound has time to evolve)
+    
+    auto t1 = TickScheduler::clock::now().time_since_epoch();
+    auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
+    unsigned long long now = (unsigned long long)t1ms;
+    
+    if(now - synthParametersChangedTime >= MEASUREMODE_DELAY_MS){
+      synthParametersChangedTime = now;
+      
+      if(synth->setParameters(synthParams) == true){
+	elementsDisplayed++;
+      }
+      else
+	logging.warn("synth setParameters FAILED");
+    }
+  }
+  
+  {
+    char buffer[256];
+    snprintf(buffer, 256, "engine_showScreen(%s %d/%d dim(%d)) = %d. DONE",
+	     message.c_str(), picture, pictures.size(), synthParams.size(), elementsDisplayed);
+    logging.info(buffer);
+  }
+  
+  return (elementsDisplayed > 0);
+}
+
+
+// draws picture, curve and message to window surface, returns number of displayed elements
+int ResonanzEngine::engine_drawScreen(SDL_Surface* surface, const std::string& message,
+				      unsigned int picture, long long sceneTick)
+{
+  if(surface == nullptr)
+    return 0;
+  
+  if(SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0, 0, 0)) != 0)
+    return 0;
+  
+  int bgcolor = 0;
+  int elementsDisplayed = 0;
+  
   if(picture < pictures.size()){ // shows a picture
     if(images[picture] == NULL){
       SDL_Surface* image = IMG_Load(pictures[picture].c_str());
@@ -4658,7 +5751,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
 					0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
 	  
 	  if(SDL_BlitScaled(image, NULL, scaled, NULL) != 0)
-	    return false;
+	    return elementsDisplayed;
 	  
 	}
 	else{
@@ -4669,7 +5762,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
 					0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
 	  
 	  if(SDL_BlitScaled(image, NULL, scaled, NULL) != 0)
-	    return false;
+	    return elementsDisplayed;
 	}
 	
 	images[picture] = scaled;
@@ -4687,7 +5780,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
 	imageRect.y = (SCREEN_HEIGHT - scaled->h)/2;
 	
 	if(SDL_BlitSurface(images[picture], NULL, surface, &imageRect) != 0)
-	  return false;
+	  return elementsDisplayed;
 	
 	elementsDisplayed++;
       }
@@ -4713,7 +5806,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
       imageRect.y = (SCREEN_HEIGHT - scaled->h)/2;
       
       if(SDL_BlitSurface(images[picture], NULL, surface, &imageRect) != 0)
-	return false;
+	return elementsDisplayed;
       
       elementsDisplayed++;
     }
@@ -4732,7 +5825,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
       const unsigned int DIMENSION = 2; // 3
       
       const double TICKSPERCURVE = CURVETIME/(TICK_MS/1000.0); // 0.5 second long buffer
-      curveParameter = (tick - latestTickCurveDrawn)/TICKSPERCURVE;
+      curveParameter = (sceneTick - latestTickCurveDrawn)/TICKSPERCURVE;
       double stdev = 0.0;
       
       // estimates sound dbel variance during latest CURVETIME and 
@@ -4791,8 +5884,8 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
 	if(startPoint.size() == 0)
 	  startPoint = points;
 	
-	latestTickCurveDrawn = tick;
-	curveParameter = (tick - latestTickCurveDrawn)/TICKSPERCURVE;
+	latestTickCurveDrawn = sceneTick;
+	curveParameter = (sceneTick - latestTickCurveDrawn)/TICKSPERCURVE;
       }
       
       {
@@ -4864,7 +5957,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
       messageRect.h = msg->h;
       
       if(SDL_BlitSurface(msg, NULL, surface, &messageRect) != 0)
-	return false;
+	return elementsDisplayed;
       
       SDL_FreeSurface(msg);
     }
@@ -4876,7 +5969,7 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
   // video encoding (if activated)
   {
     if(video && programStarted > 0){
-      auto t1 = std::chrono::system_clock::now().time_since_epoch();
+      auto t1 = TickScheduler::clock::now().time_since_epoch();
       auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
       
       logging.info("adding frame to theora encoding queue");
@@ -4887,40 +5980,289 @@ bool ResonanzEngine::engine_showScreen(const std::string& message, unsigned int
   }
   
   
-  ///////////////////////////////////////////////////////////////////////
-  // plays sound
-  if(synth)
-  {
-    // changes synth parameters only as fast sound synthesis can generate
-    // meaningful sounds (sound has time to evolve)
-    
-    auto t1 = std::chrono::system_clock::now().time_since_epoch();
-    auto t1ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1).count();
-    unsigned long long now = (unsigned long long)t1ms;
+  return elementsDisplayed;
+}
+
+
+// shows stimulus and measures EEG values at stimulus onset (the moment the frame
+// was presented) and MEASUREMODE_DELAY_MS after it. values are interpolated from
+// timestamped samples so that drawing time and wakeup jitter don't affect them
+bool ResonanzEngine::engine_measureResponse(const std::string& message, unsigned int picture,
+					    const std::vector<float>& synthParams,
+					    std::vector<float>& eegBefore,
+					    std::vector<float>& eegAfter)
+{
+  const auto delay = std::chrono::milliseconds(MEASUREMODE_DELAY_MS);
+  const auto poll = std::chrono::milliseconds(EEG_POLL_MS);
+  
+  SampleTimeline timeline;
+  
+  // uses device timestamped sample stream if available (starting from the
+  // latest sample before stimulus) and otherwise polls latest values
+  unsigned long long cursor = eeg->getSampleCursor();
+  if(cursor > 0) cursor--;
+  
+  std::vector<SampleTimeline::clock::time_point> times;
+  std::vector< std::vector<float> > samples;
+  
+  const bool stream = eeg->readSince(cursor, times, samples);
+  
+  auto collect = [&](){
+    if(stream){
+      times.clear();
+      samples.clear();
+      eeg->readSince(cursor, times, samples);
+      
+      for(unsigned int i=0;i<times.size();i++)
+	timeline.add(times[i], samples[i]);
+    }
+    else{
+      std::vector<float> x;
+      if(eeg->data(x)) timeline.add(TickScheduler::clock::now(), x);
+    }
+  };
+  
+  // waits for the next sample (stream) or polling interval
+  auto waitUntil = [&](TickScheduler::clock::time_point t){
+    if(stream) eeg->waitForSample(cursor, t);
+    else engine_sleepUntil(t);
+  };
+  
+  for(unsigned int i=0;i<times.size();i++)
+    timeline.add(times[i], samples[i]);
+  
+  const auto start = TickScheduler::clock::now();
+  if(stream == false) collect();
+  
+  engine_showScreen(message, picture, synthParams);
+  engine_updateScreen(); // always updates window if it exists
+  
+  auto onset = TickScheduler::clock::now(); // engine_updateScreen() presented the frame
+  
+  if(renderer){
+    // waits until render thread has presented the scene (or a newer one)
+    bool presented = false;
     
-    if(now - synthParametersChangedTime >= MEASUREMODE_DELAY_MS){
-      synthParametersChangedTime = now;
+    while(TickScheduler::clock::now() < start + delay){
+      unsigned long long sequence = 0;
+      RenderThread::clock::time_point t;
       
-      if(synth->setParameters(synthParams) == true){
-	elementsDisplayed++;
+      if(renderer->getPresented(sequence, t) && sequence >= lastSceneSequence){
+	onset = t;
+	presented = true;
+	break;
       }
-      else
-	logging.warn("synth setParameters FAILED");
+      
+      collect();
+      renderer->waitPresented(lastSceneSequence, TickScheduler::clock::now() + poll);
+    }
+    
+    if(presented == false){
+      logging.warn("measure: stimulus was not presented in time");
+      onset = TickScheduler::clock::now();
+    }
+  }
+  
+  const auto end = onset + delay;
+  
+  // collects samples until onset + delay
+  while(true){
+    collect();
+    
+    const auto now = TickScheduler::clock::now();
+    if(now >= end) break;
+    
+    waitUntil(std::min(now + poll, end));
+  }
+  
+  // stream samples arrive at device's rate: waits for a sample after the end
+  if(stream){
+    const auto timeout = end + std::chrono::milliseconds(TICK_MS);
+    
+    while(timeline.size() == 0 || timeline.getLastTime() < end){
+      if(eeg->waitForSample(cursor, timeout) == false) break;
+      collect();
     }
   }
   
+  if(timeline.interpolate(onset, eegBefore) == false) return false;
+  if(timeline.interpolate(end, eegAfter) == false) return false;
+  
   {
-    char buffer[256];
-    snprintf(buffer, 256, "engine_showScreen(%s %d/%d dim(%d)) = %d. DONE",
-	     message.c_str(), picture, pictures.size(), synthParams.size(), elementsDisplayed);
+    char buffer[128];
+    snprintf(buffer, 128, "measure: stimulus onset %.1f ms after request (%d EEG samples)",
+	     std::chrono::duration<float, std::milli>(onset - start).count(), timeline.size());
     logging.info(buffer);
   }
   
-  return (elementsDisplayed > 0);
+  return true;
+}
+
+
+// draws scene in render thread
+bool ResonanzEngine::engine_renderScene(const RenderScene& scene)
+{
+  if(window == nullptr) return false;
+  
+  SDL_Surface* surface = SDL_GetWindowSurface(window);
+  if(surface == nullptr) return false;
+  
+  return (engine_drawScreen(surface, scene.message, scene.picture, scene.tick) > 0);
+}
+
+
+// presents scene drawn by render thread
+bool ResonanzEngine::engine_presentScene()
+{
+  if(window == nullptr) return false;
+  
+  if(SDL_UpdateWindowSurface(window) != 0){
+    logging.error(std::string("presenting scene failed: ") + SDL_GetError());
+    return false;
+  }
+  
+  return true;
+}
+
+
+void ResonanzEngine::engine_startTracker()
+{
+  if(hmmTracker != nullptr) return;
+  
+  std::lock_guard<std::mutex> lock(hmm_mutex);
+  
+  if(hmm == nullptr || kmeans == nullptr) return;
+  
+  hmmTracker = new HMMStateTracker(*kmeans, *hmm, eeg, eeg_mutex, eeg_wait_mutex, HMMstate);
+  
+  if(hmmTracker->start() == false){
+    logging.warn("starting HMM state tracker failed (invalid K-Means or HMM model)");
+    delete hmmTracker;
+    hmmTracker = nullptr;
+  }
+}
+
+
+void ResonanzEngine::engine_stopTracker()
+{
+  if(hmmTracker == nullptr) return;
+  
+  hmmTracker->stop();
+  delete hmmTracker;
+  hmmTracker = nullptr;
+}
+
+
+bool ResonanzEngine::engine_startRenderer(const std::string& fontname)
+{
+  if(renderer != nullptr) return true;
+  
+  // SDL window functions must be called from the thread that created the window
+  renderer = new RenderThread([this, fontname](){ return engine_openWindow(fontname); },
+			      [this](const RenderScene& scene){ return engine_renderScene(scene); },
+			      [this](){ return engine_presentScene(); },
+			      [this](){ engine_pumpEvents(); },
+			      [this](){ engine_closeWindow(); });
+  
+  if(renderer->start() == false){
+    logging.warn("starting render thread failed (cannot open window)");
+    delete renderer;
+    renderer = nullptr;
+    return false;
+  }
+  
+  return true;
+}
+
+
+void ResonanzEngine::engine_stopRenderer()
+{
+  if(renderer == nullptr) return;
+  
+  renderer->stop();
+  delete renderer;
+  renderer = nullptr;
+}
+
+
+// opens window (or empties already open window with blank screen) and
+// loads font scaled to window size
+bool ResonanzEngine::engine_openWindow(const std::string& fontname)
+{
+  SDL_DisplayMode mode;
+  
+  if(SDL_GetCurrentDisplayMode(0, &mode) == 0){
+    SCREEN_WIDTH = mode.w;
+    SCREEN_HEIGHT = mode.h;
+  }
+  
+  if(window == nullptr){
+    if(fullscreen){
+      window = SDL_CreateWindow(windowTitle.c_str(),
+				SDL_WINDOWPOS_CENTERED,
+				SDL_WINDOWPOS_CENTERED,
+				SCREEN_WIDTH, SCREEN_HEIGHT,
+				SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN_DESKTOP);
+    }
+    else{
+      window = SDL_CreateWindow(windowTitle.c_str(),
+				SDL_WINDOWPOS_CENTERED,
+				SDL_WINDOWPOS_CENTERED,
+				(3*SCREEN_WIDTH)/4, (3*SCREEN_HEIGHT)/4,
+				SDL_WINDOW_SHOWN);
+    }
+  }
+  
+  if(window == nullptr) return false;
+  
+  SDL_GetWindowSize(window, &SCREEN_WIDTH, &SCREEN_HEIGHT);
+  if(font) TTF_CloseFont(font);
+  double fontSize = 100.0*sqrt(((float)(SCREEN_WIDTH*SCREEN_HEIGHT))/(640.0*480.0));
+  unsigned int fs = (unsigned int)fontSize;
+  if(fs <= 0) fs = 10;
+  
+  font = 0;
+  font = TTF_OpenFont(fontname.c_str(), fs);
+  
+  SDL_Surface* icon = IMG_Load(iconFile.c_str());
+  if(icon != nullptr){
+    SDL_SetWindowIcon(window, icon);
+    SDL_FreeSurface(icon);
+  }
+  
+  SDL_Surface* surface = SDL_GetWindowSurface(window);
+  if(surface == nullptr) return false;
+  
+  SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0, 0, 0));
+  SDL_RaiseWindow(window);
+  // SDL_SetWindowGrab(window, SDL_TRUE);
+  SDL_UpdateWindowSurface(window);
+  SDL_RaiseWindow(window);
+  // SDL_SetWindowGrab(window, SDL_FALSE);
+  
+  return true;
+}
+
+
+void ResonanzEngine::engine_closeWindow()
+{
+  if(window != nullptr) SDL_DestroyWindow(window);
+  window = nullptr;
 }
 
 
+
+
 void ResonanzEngine::engine_pollEvents()
+{
+  if(renderer) return; // render thread handles events of its window
+  
+  engine_pumpEvents();
+}
+
+
+// handles window events (called by the thread owning the window)
+void ResonanzEngine::engine_pumpEvents()
 {
   SDL_Event event;
   
@@ -4938,6 +6280,8 @@ void ResonanzEngine::engine_pollEvents()
 
 void ResonanzEngine::engine_updateScreen()
 {
+  if(renderer) return; // render thread presents scenes
+  
   if(window != nullptr){
     if(SDL_UpdateWindowSurface(window) != 0){
       printf("engine_updateScreen() failed: %s\n", SDL_GetError());
@@ -5364,21 +6708,53 @@ std::string ResonanzEngine::analyzeModel(const std::string& modelDir) const
   // std::lock_guard<std::mutex> lock(database_mutex);
   // (we do read only operations so these are relatively safe) => no mutex
   
-  for(auto filename : databaseFiles){
+  // keyword and picture datasets in the store file replace their .ds files
+  MeasurementStore store;
+  std::vector<std::string> storeModels;
+  
+  if(store.open(engine_storeFilename(modelDir))){
+    for(unsigned int s=0;s<store.size();s++){
+      const std::string& key = store.getName(s);
+      const std::string stimulus = key.substr(key.find(':') + 1);
+      const std::string hashname = calculateHashName(stimulus + eeg->getDataSourceName());
+      
+      auto i = std::find(databaseFiles.begin(), databaseFiles.end(), hashname + ".ds");
+      if(i != databaseFiles.end()) databaseFiles.erase(i);
+      
+      storeModels.push_back(modelDir + "/" + hashname + ".model");
+    }
+  }
+  
+  for(unsigned int d=0;d<storeModels.size() + databaseFiles.size();d++){
     // calculate statistics
     whiteice::dataset<> ds;
-    std::string fullname = modelDir + "/" + filename;
-    if(ds.load(fullname) == false){
-      failed++;
-      continue; // couldn't load this dataset
+    std::string modelFilename;
+    
+    if(d < storeModels.size()){
+      const std::string& key = store.getName(d);
+      const std::string stimulus = key.substr(key.find(':') + 1);
+      
+      if(engine_loadStimulusView(store, stimulus, key.compare(0, 8, "keyword:") == 0, modelDir, ds) == false){
+	failed++;
+	continue;
+      }
+      
+      modelFilename = storeModels[d];
+    }
+    else{
+      std::string fullname = modelDir + "/" + databaseFiles[d - storeModels.size()];
+      if(ds.load(fullname) == false){
+	failed++;
+	continue; // couldn't load this dataset
+      }
+      
+      modelFilename = fullname.substr(0, fullname.length()-3) + ".model";
     }
     
     if(ds.size(0) < minDSSamples) minDSSamples = ds.size(0);
     avgDSSamples += ds.size(0);
     N++;
     
-    std::string modelFilename = fullname.substr(0, fullname.length()-3) + ".model";
-    
     // check if there is a model file and load it into memory and TODO: calculate average error
     whiteice::bayesian_nnetwork<> nnet;
     
@@ -5462,19 +6838,21 @@ std::string ResonanzEngine::analyzeModel2(const std::string& pictureDir,
      loadPictures(pictureDir, pictureFiles) == false)
     return "";
   
-  // 2. loads dataset files (.ds) one by one if possible and calculates prediction error
+  // 2. loads datasets one by one if possible and calculates prediction error
   
   std::string report = "MODEL PREDICTION ERRORS:\n\n";
   
+  MeasurementStore store;
+  store.open(engine_storeFilename(modelDir));
+  
   // loads databases into memory
   for(unsigned int i=0;i<keywords.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".ds";
     std::string modelFilename = modelDir + "/" + calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".model";
     
     whiteice::dataset<> data;
     whiteice::bayesian_nnetwork<> bnn;
     
-    if(data.load(dbFilename) == true && bnn.load(modelFilename)){
+    if(engine_loadStimulusView(store, keywords[i], true, modelDir, data) && bnn.load(modelFilename)){
       if(data.getNumberOfClusters() == 2){
 	// calculates average error
 	float error = 0.0f;
@@ -5515,15 +6893,13 @@ std::string ResonanzEngine::analyzeModel2(const std::string& pictureDir,
   report += "\n";
   
   for(unsigned int i=0;i<pictureFiles.size();i++){
-    std::string dbFilename = 
-      modelDir + "/" + calculateHashName(pictureFiles[i] + eeg->getDataSourceName()) + ".ds";
     std::string modelFilename = 
       modelDir + "/" + calculateHashName(pictureFiles[i] + eeg->getDataSourceName()) + ".model";
     
     whiteice::dataset<> data;
     whiteice::bayesian_nnetwork<> bnn;
     
-    if(data.load(dbFilename) == true && bnn.load(modelFilename)){
+    if(engine_loadStimulusView(store, pictureFiles[i], false, modelDir, data) && bnn.load(modelFilename)){
       if(data.getNumberOfClusters() == 2){
 	// calculates average error
 	float error = 0.0f;
@@ -5669,16 +7045,15 @@ std::string ResonanzEngine::deltaStatistics(const std::string& pictureDir, const
   unsigned int input_dimension = 0;
   unsigned int output_dimension = 0;
   
-  // 2. loads dataset files (.ds) one by one if possible and calculates mean delta
+  // 2. loads datasets one by one if possible and calculates mean delta
   whiteice::dataset<> data;
   
+  MeasurementStore store;
+  store.open(engine_storeFilename(modelDir));
+  
   // loads databases into memory or initializes new ones
   for(unsigned int i=0;i<keywords.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".ds";
-    
-    data.clear();
-    
-    if(data.load(dbFilename) == true){
+    if(engine_loadStimulusView(store, keywords[i], true, modelDir, data)){
       if(data.getNumberOfClusters() == 2){
 	float delta = 0.0f;
 	
@@ -5719,11 +7094,7 @@ std::string ResonanzEngine::deltaStatistics(const std::string& pictureDir, const
   var_delta_keywords  *= num_keywords/(num_keywords - 1.0f);
   
   for(unsigned int i=0;i<pictureFiles.size();i++){
-    std::string dbFilename = modelDir + "/" + calculateHashName(pictureFiles[i] + eeg->getDataSourceName()) + ".ds";
-    
-    data.clear();
-    
-    if(data.load(dbFilename) == true){
+    if(engine_loadStimulusView(store, pictureFiles[i], false, modelDir, data)){
       if(data.getNumberOfClusters() == 2){
 	float delta = 0.0f;
 	
@@ -5857,6 +7228,22 @@ std::string ResonanzEngine::executedProgramStatistics() const
 }
 
 
+std::string ResonanzEngine::tickStatistics() const
+{
+  if(ticker.getTicks() > 0){
+    char buffer[256];
+    snprintf(buffer, 256, "Engine ticks: %llu (%d ms). Lateness: %.3f ms (average %.3f ms, max %.3f ms). Overruns: %llu ticks.\n",
+	     ticker.getTicks(), TICK_MS, ticker.getLatenessMs(), ticker.getMeanLatenessMs(),
+	     ticker.getMaxLatenessMs(), ticker.getOverruns());
+    
+    return std::string(buffer);
+  }
+  else{
+    return "No engine tick statistics available.\n";
+  }
+}
+
+
 // exports data to ASCII format files (.txt files)
 bool ResonanzEngine::exportDataAscii(const std::string& pictureDir, 
 				     const std::string& keywordsFile, 
@@ -5870,8 +7257,11 @@ bool ResonanzEngine::exportDataAscii(const std::string& pictureDir,
      loadPictures(pictureDir, pictureFiles) == false)
     return false;
   
-  // 2. loads dataset files (.ds) one by one if possible and calculates mean delta
+  // 2. loads datasets one by one if possible and calculates mean delta
   whiteice::dataset<> data;
+  
+  MeasurementStore store;
+  store.open(engine_storeFilename(modelDir));
 
   // 0. loads and dumps eegData file
   {
@@ -5892,14 +7282,10 @@ bool ResonanzEngine::exportDataAscii(const std::string& pictureDir,
   
   // loads databases into memory or initializes new ones
   for(unsigned int i=0;i<keywords.size();i++){
-    std::string dbFilename = modelDir + "/" + 
-      calculateHashName(keywords[i] + eeg->getDataSourceName()) + ".ds";
     std::string txtFilename = modelDir + "/" + "KEYWORD_" + 
       keywords[i] + "_" + eeg->getDataSourceName() + ".txt";
     
-    data.clear();
-    
-    if(data.load(dbFilename) == true){
+    if(engine_loadStimulusView(store, keywords[i], true, modelDir, data)){
       if(data.exportAscii(txtFilename) == false)
 	return false;
     }
@@ -5907,18 +7293,13 @@ bool ResonanzEngine::exportDataAscii(const std::string& pictureDir,
   }
   
   for(unsigned int i=0;i<pictureFiles.size();i++){
-    std::string dbFilename = modelDir + "/" + 
-      calculateHashName(pictureFiles[i] + eeg->getDataSourceName()) + ".ds";
-    
     char filename[2048];
     snprintf(filename, 2048, "%s", pictureFiles[i].c_str());
     
     std::string txtFilename = modelDir + "/" + "PICTURE_" + 
       basename(filename) + "_" + eeg->getDataSourceName() + ".txt";
     
-    data.clear();
-    
-    if(data.load(dbFilename) == true){
+    if(engine_loadStimulusView(store, pictureFiles[i], false, modelDir, data)){
       if(data.exportAscii(txtFilename) == false)
 	return false;
     }
@@ -5964,6 +7345,7 @@ bool ResonanzEngine::exportDataAscii(const std::string& pictureDir,
 bool ResonanzEngine::deleteModelData(const std::string& modelDir)
 {
   // we go through database directory and delete all *.ds and *.model files
+  // (and keyword and picture measurements store and journal)
   std::vector<std::string> databaseFiles;
   std::vector<std::string> modelFiles;
   
@@ -6054,6 +7436,13 @@ bool ResonanzEngine::deleteModelData(const std::string& modelDir)
     remove(f.c_str());
   }
   
+  remove(engine_storeFilename(modelDir).c_str());
+  remove(MeasurementStore::segmentName(engine_storeFilename(modelDir)).c_str());
+  remove(engine_journalFilename(modelDir).c_str());
+  remove(MeasurementJournal::markName(engine_journalFilename(modelDir)).c_str());
+  remove(engine_statisticsFilename(modelDir).c_str());
+  remove(engine_retentionFilename(modelDir).c_str());
+  
   for(auto filename : modelFiles){
     auto f = modelDir + "/" + filename;
     remove(f.c_str());
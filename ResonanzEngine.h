@@ -40,6 +40,26 @@
 #include "SDLTheora.h"
 
 #include "HMMStateUpdator.h"
+#include "HMMStateTracker.h"
+#include "CentroidTable.h"
+
+#include "RBFSnapshot.h"
+#include "BatchedModelEvaluator.h"
+#include "PreprocessFolding.h"
+#include "PredictionCache.h"
+#include "ResponseIndex.h"
+#include "StimulusPlanner.h"
+#include "SpeculativeWorker.h"
+#include "TickScheduler.h"
+#include "RenderThread.h"
+#include "SampleTimeline.h"
+#include "TrainingScheduler.h"
+#include "ModelInfo.h"
+#include "OptimizeCheckpoint.h"
+#include "MeasurementJournal.h"
+#include "MeasurementStore.h"
+#include "RunningStatistics.h"
+#include "EEGRetention.h"
 
 namespace whiteice {
 namespace resonanz {
@@ -144,6 +164,9 @@ public:
 	// returns collected program performance statistics [program weighted RMS]
 	std::string executedProgramStatistics() const;
 	
+	// returns engine tick timing statistics (lateness and overruns)
+	std::string tickStatistics() const;
+	
 	// exports data to ASCII format files (.txt files)
 	bool exportDataAscii(const std::string& pictureDir, 
 			     const std::string& keywordsFile, 
@@ -207,11 +230,36 @@ private:
 	bool engine_showScreen(const std::string& message, 
 			       unsigned int picture,
 			       const std::vector<float>& synthparams);
+	
+	int engine_drawScreen(SDL_Surface* surface, const std::string& message,
+			      unsigned int picture, long long sceneTick);
+	
+	// shows stimulus and gets EEG values at its presentation time and MEASUREMODE_DELAY_MS after it
+	bool engine_measureResponse(const std::string& message, unsigned int picture,
+				    const std::vector<float>& synthParams,
+				    std::vector<float>& eegBefore, std::vector<float>& eegAfter);
+	
+	// render thread owns the window: opens it, draws and presents scenes given
+	// by engine_showScreen() and handles window events. engine thread doesn't
+	// touch the window while renderer is running (only runs while command is
+	// executed, stopped during state transitions)
+	bool renderThreaded = false;
+	RenderThread* renderer = nullptr;
+	unsigned long long lastSceneSequence = 0; // latest scene posted to renderer
+	
+	bool engine_renderScene(const RenderScene& scene);
+	bool engine_presentScene();
+	bool engine_startRenderer(const std::string& fontname);
+	void engine_stopRenderer();
+	
+	bool engine_openWindow(const std::string& fontname);
+	void engine_closeWindow();
 
 	bool engine_playAudioFile(const std::string& audioFile);
 	bool engine_stopAudioFile();
 
 	void engine_pollEvents();
+	void engine_pumpEvents();
 
 	void engine_updateScreen();
 
@@ -230,6 +278,12 @@ private:
 	// set to 100ms (set tick back to 1000ms = 1 sec)
 	static const unsigned int TICK_MS = 100;               // how fast engine runs: engine measures ticks and executes (one) command only when tick changes
 	static const unsigned int MEASUREMODE_DELAY_MS = 200; // how long each screen is shown when measuring response
+	static const unsigned int EEG_POLL_MS = 5;            // EEG sampling interval when measuring response
+	
+	// absolute deadlines of engine ticks (monotonic clock)
+	TickScheduler ticker { std::chrono::microseconds(TICK_MS*1000) };
+	
+	void engine_sleepUntil(TickScheduler::clock::time_point t); // sleeps until absolute time
 
 	// media resource
 	std::vector<std::string> keywords;
@@ -255,7 +309,69 @@ private:
 				     const std::vector<float>& synthBefore,
 				     const std::vector<float>& synthAfter);
 	
+	// adds validated measurement to datasets (hmmState >= HMM_NUM_CLUSTERS: no state)
+	bool engine_addMeasurement(unsigned int pic, unsigned int key, unsigned int hmmState,
+				   const std::vector<float>& eegBefore, 
+				   const std::vector<float>& eegAfter,
+				   const std::vector<float>& synthBefore,
+				   const std::vector<float>& synthAfter);
+	
 	bool engine_saveDatabase(const std::string& modelDir);
+	
+	// stimulus datasets are loaded and saved in parallel by at most DATABASE_IO_THREADS threads
+	const unsigned int DATABASE_IO_THREADS = 8;
+	const float STORE_SEGMENT_MAX = 0.25f; // store file is rewritten when 25% of rows are in its segment file
+	
+	bool engine_loadStimulusData(whiteice::dataset<>& data,
+				     const MeasurementStore& store,
+				     const std::string& key,
+				     const std::string& dbFilename,
+				     const std::string& type,
+				     unsigned int index,
+				     unsigned int inputs, unsigned int outputs,
+				     RunningStatistics& inputStats,
+				     RunningStatistics& outputStats,
+				     bool& dirty);
+	
+	bool engine_prepareStimulusData(whiteice::dataset<>& data,
+					const std::string& type,
+					RunningStatistics& inputStats,
+					RunningStatistics& outputStats);
+	
+	// keyword and picture measurements are saved to a single columnar store
+	// file (old per stimulus .ds files are imported when loaded)
+	std::string engine_storeFilename(const std::string& modelDir) const;
+	std::string engine_storeKey(const std::string& stimulus, bool keyword) const;
+	
+	bool engine_loadStimulusView(const MeasurementStore& store,
+				     const std::string& stimulus, bool keyword,
+				     const std::string& modelDir,
+				     whiteice::dataset<>& data) const;
+	
+	// stored measurements are appended to the journal and replayed when database
+	// is loaded. datasets are rewritten after measurements only when journal is large
+	MeasurementJournal measurementJournal;
+	const unsigned int JOURNAL_COMPACT_RECORDS = 2000;
+	
+	std::string engine_journalFilename(const std::string& modelDir) const;
+	bool engine_replayJournal(const std::string& modelDir);
+	
+	// running mean/variance (covariance with PCA) of dataset clusters without
+	// preprocessing. updated with each measurement and saved to statistics file,
+	// preprocessing is recomputed only when they have moved more than tolerance
+	std::map<std::string, RunningStatistics> statistics;
+	const float NORMALIZATION_TOLERANCE = 0.05f;
+	
+	std::string engine_statisticsFilename(const std::string& modelDir) const;
+	std::string engine_statisticsKey(const std::string& dataset, unsigned int cluster) const;
+	
+	bool engine_validStatistics(const RunningStatistics& stats,
+				    const whiteice::dataset<>& data, unsigned int cluster) const;
+	bool engine_rebuildStatistics(RunningStatistics& stats,
+				      const whiteice::dataset<>& data, unsigned int cluster) const;
+	void engine_updateStatistics(const std::string& key,
+				     const std::vector< whiteice::math::blas_real<float> >& x);
+	
 	std::string calculateHashName(const std::string& filename) const;
 
         whiteice::dataset<> eegData; // EEG values data for KMeans and HMM brain state detection
@@ -265,12 +381,34 @@ private:
 	std::vector< whiteice::dataset<> > pictureData;
 	whiteice::dataset<>                synthData; // sound synthesis data
 	
+	// datasets changed after loading (only they are saved)
+	std::vector<char> keywordDirty, pictureDirty; // char: set concurrently by I/O threads
+	bool eegDirty = false, synthDirty = false;
+	
+	// retention policy of EEG stream (eegData) rows, set using parameters
+	// eeg-retention, eeg-retention-rows and eeg-retention-halflife-days
+	EEGRetention eegRetention;
+	
+	std::string engine_retentionFilename(const std::string& modelDir) const;
+	bool engine_applyRetention();
+	
+	// SoA copies and spatial indexes of keywordData and pictureData (used by RBF model)
+	std::vector< RBFSnapshot > keywordIndex;
+	std::vector< RBFSnapshot > pictureIndex;
+	
+	// per HMM state indexes of stimulus expected responses (used by RBF model)
+	ResponseIndex keywordResponses;
+	ResponseIndex pictureResponses;
+	
+	bool engine_buildIndexes();
+	
         mutable std::mutex database_mutex;  // mutex to synchronize I/O access to dataset files
 	bool pcaPreprocess = false; // should measured data be preprocessed using PCA (no pca preprocessing as the default!)
 
 
 	DataSource* eeg = nullptr;
 	std::mutex eeg_mutex;
+	std::mutex eeg_wait_mutex; // held with eeg_mutex when device changes (HMMStateTracker waits holding only this)
 	int eegDeviceType = RE_EEG_NO_DEVICE;
 	
         bool engine_optimizeModels(unsigned int& currentHMMModel,
@@ -283,21 +421,47 @@ private:
         whiteice::HMM* hmm = nullptr;
         unsigned int HMMstate = 0; // current HMM state
         HMMStateUpdatorThread* hmmUpdator = nullptr;
+        HMMStateTracker* hmmTracker = nullptr; // updates HMM state from EEG samples in measure/execute
+        
+        void engine_startTracker();
+        void engine_stopTracker();
   
         const unsigned int KMEANS_NUM_CLUSTERS = 50;
         const unsigned int HMM_NUM_CLUSTERS = 10; // number of HMM hidden brain states
 	
-	// whiteice::pLBFGS_nnetwork<>* optimizer = nullptr;
-	whiteice::math::NNGradDescent<>* optimizer = nullptr;
+	// trains prediction models concurrently (synth, picture and keyword groups)
+	TrainingScheduler* trainer = nullptr;
+	enum { TRAIN_SYNTH = 0, TRAIN_PICTURE = 1, TRAIN_KEYWORD = 2 };
 	
-	const unsigned int NUM_OPTIMIZER_THREADS = 1;
+	unsigned int optimizeConcurrency = 0; // models trained at the same time (0 = number of CPUs)
 	const unsigned int NUM_OPTIMIZER_ITERATIONS = 750; // was: 150
+	const float FINETUNE_MAX_NEW = 0.25f; // fine-tunes models with at most 25% new measurements
+	const unsigned int FINETUNE_MIN_ITERATIONS = 75;
+	const unsigned int NN_MIN_SAMPLES = 30; // stimulus with less data use data RBF estimate only
+	
+	// chooses how model is (re)trained using its .modelinfo sidecar file,
+	// iterations is set for fine-tuning (0 = default). states is hash of
+	// K-Means and HMM models that labelled HMM state columns (0 = none)
+	TrainingScheduler::Start engine_planTraining(const whiteice::dataset<>& data,
+						     unsigned int inputColumns,
+						     unsigned long long states,
+						     const std::string& modelFilename,
+						     unsigned int& iterations,
+						     ModelInfo& info);
+	
+	// progress of optimization saved to model directory so that stopped
+	// optimization continues from completed K-Means/HMM models and prediction models
+	OptimizeCheckpoint checkpoint;
+	std::string checkpointFile;
+	
+	bool engine_resumeOptimization(unsigned int& currentHMMModel);
+	bool engine_saveCheckpoint(OptimizeCheckpoint::Stage stage);
+	
 	bool optimizeSynthOnly = false;
 
   	whiteice::nnetwork<>* nn = nullptr;
 	whiteice::nnetwork<>* nnsynth = nullptr; // synth data neural network
 	whiteice::bayesian_nnetwork<>* bnn = nullptr;
-	whiteice::UHMC<>* bayes_optimizer = nullptr;
 
 	const int NEURALNETWORK_COMPLEXITY = 10; // values above 10 seem to make sense (was: 25, 10)
 	const int NEURALNETWORK_DEPTH = 6; // how many layers neural network have (was: 3, 6)
@@ -309,6 +473,82 @@ private:
 	bool engine_executeProgram(const std::vector<float>& eegCurrent,
 			const std::vector<float>& eegTarget, const std::vector<float>& eegTargetVariance, float timedelta);
 
+	// anytime stimulus selection: engine_executeProgram() scores stimulus in priority
+	// order and stops computing new predictions after time budget (0 = scores all)
+	unsigned int selectionBudgetMs = 0;
+	const unsigned int SELECTION_TOPK = 10;
+	
+	std::vector<unsigned int> keywordTop, pictureTop;  // last tick's best stimulus
+	std::vector<float> keywordQuality, pictureQuality; // latest errors (NaN = not scored)
+	
+	void engine_selectionOrder(const std::vector<unsigned int>& top,
+				   const std::vector<float>& quality,
+				   unsigned int N,
+				   std::vector<unsigned int>& order) const;
+	
+	// stores errors of scored stimulus and SELECTION_TOPK best stimulus for the next tick
+	unsigned int engine_updateSelection(const std::vector< std::pair<float, int> >& results,
+					    const std::vector<char>& scored,
+					    std::vector<unsigned int>& top,
+					    std::vector<float>& quality);
+	
+	// scores only responseShortlist stimulus with the closest expected responses (0 = all)
+	unsigned int responseShortlist = 0;
+	
+	void engine_shortlistOrder(const ResponseIndex& responses,
+				   const std::vector<unsigned int>& top,
+				   const std::vector<float>& eegCurrent,
+				   const std::vector<float>& eegTarget,
+				   float timestep,
+				   std::vector<unsigned int>& order) const;
+	
+	// multi-step lookahead planning of pictures (plannerDepth <= 1 means greedy selection)
+	StimulusPlanner planner;
+	unsigned int plannerDepth = 0;
+	unsigned int plannerBeam = 8;
+	unsigned int plannerBudgetMs = 20;
+	const unsigned int PLANNER_CANDIDATES = 32; // number of best greedy pictures used in planning
+	
+	// program targets and variances of the current and following steps
+	std::vector< std::vector<float> > planTargets, planVariances;
+	
+	bool engine_predictResponse(PredictionCache::stimulus_type type,
+				    unsigned int index,
+				    const std::vector<float>& eegCurrent,
+				    unsigned int state,
+				    float* m, float* var);
+	
+	// scores all stimulus for the next tick's targets in background thread while the
+	// current stimulus is shown. engine_executeProgram() then only rescores the
+	// speculated best stimulus with the latest EEG values (confirms the choice) unless
+	// HMM state, targets or EEG values have changed too much (full selection)
+	bool speculativeExecute = false;
+	SpeculativeWorker* speculator = nullptr;
+	
+	struct Speculation
+	{
+	  // inputs set by the main loop before resuming worker
+	  unsigned int state = 0;
+	  std::vector<float> target, targetVariance;
+	  float timestep = 0.0f;
+	  
+	  // results (valid only after a completed speculation)
+	  bool valid = false;
+	  std::vector<float> eeg; // EEG values used
+	  std::vector<unsigned int> keywords, pictures; // best stimulus first
+	};
+	
+	Speculation speculation; // only accessed by main loop when speculator is paused
+	const unsigned int SPECULATION_SHORTLIST = 10;  // rescored stimulus per type
+	const float SPECULATION_TOLERANCE = 0.05f;      // max change of EEG values since speculation
+	
+	bool engine_speculate(const std::atomic<bool>& cancel);
+	
+	bool engine_speculationConfirmed(const std::vector<float>& eegCurrent,
+					 const std::vector<float>& eegTarget,
+					 const std::vector<float>& eegTargetVariance,
+					 float timestep) const;
+	
 	// executes program blindly based on Monte Carlo sampling and prediction models
 	bool engine_executeProgramMonteCarlo(const std::vector<float>& eegTarget,
 			const std::vector<float>& eegTargetVariance, float timedelta);
@@ -318,6 +558,15 @@ private:
 	std::vector< whiteice::bayesian_nnetwork<> > keywordModels;
 	std::vector< whiteice::bayesian_nnetwork<> > pictureModels;
 	whiteice::bayesian_nnetwork<>                synthModel;
+	
+	// packed keywordModels and pictureModels (faster evaluation of neural network models)
+	BatchedModelEvaluator keywordBatch;
+	BatchedModelEvaluator pictureBatch;
+	
+	// cached predictions of stimulus responses (cleared when models are loaded),
+	// disabled unless prediction-cache-size parameter is set
+	PredictionCache predictionCache;
+	
 	bool dataRBFmodel = true; // don't calculate neural networks but use simple model to directly predict response from stimulus
 	
 	// number of parameters to test with synthModel before selecting the optimium one 
@@ -326,8 +575,14 @@ private:
 	unsigned long long synthParametersChangedTime = 0ULL;
 
 	// estimate output value N(m,cov) for x given dataset data uses nearest neighbourhood estimation
+	// (only uses rbfNeighbours nearest points if index for the data is given)
 	bool engine_estimateNN(const whiteice::math::vertex<>& x, const whiteice::dataset<>& data,
-			whiteice::math::vertex<>& m, whiteice::math::matrix<>& cov);
+			whiteice::math::vertex<>& m, whiteice::math::matrix<>& cov,
+			const RBFSnapshot* index = nullptr);
+	
+	unsigned int rbfNeighbours = 50; // number of nearest neighbours used by RBF model (0 = all data)
+	float rbfRadius = 0.0f;          // uses all neighbours within radius instead (0 = disabled)
+	float rbfEpsilon = 0.0f;         // approximation error bound in nearest neighbour search (0 = exact)
 
 	// for calculating program performance: RMS statistic
 	float programRMS = 0.0f;
@@ -337,7 +592,7 @@ private:
 	std::vector< math::vertex<> > mcsamples;
 	const unsigned int MONTE_CARLO_SIZE = 1000; // number of samples used
 
-	long long programStarted; // 0 = program has not been started
+	long long programStarted; // TickScheduler::clock milliseconds (0 = program has not been started)
 	SDLTheora* video = nullptr; // used to encode program into video
 
 
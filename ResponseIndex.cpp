@@ -0,0 +1,179 @@
+
+#include "ResponseIndex.h"
+#include "PreprocessFolding.h"
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    ResponseIndex::ResponseIndex()
+    {
+    }
+
+    ResponseIndex::~ResponseIndex()
+    {
+    }
+
+
+    bool ResponseIndex::build(const std::vector< whiteice::dataset<> >& data,
+			      unsigned int numInputs, unsigned int numStates)
+    {
+      clear();
+
+      if(numInputs == 0 || numStates == 0) return false;
+
+      E = numInputs;
+      S = numStates;
+
+      // responses[i] has S*E values: expected response of stimulus i in each state
+      std::vector< std::vector<float> > responses(data.size());
+      std::vector<char> valid(data.size(), 0);
+
+#pragma omp parallel for schedule(dynamic)
+      for(unsigned int i=0;i<data.size();i++){
+	valid[i] = expected_responses(data[i], responses[i]) ? 1 : 0;
+      }
+
+      // stimulus without expected responses are always in the shortlist
+      numStimulus = data.size();
+
+      for(unsigned int i=0;i<numStimulus;i++){
+	if(valid[i]) indexed.push_back(i);
+	else unindexed.push_back(i);
+      }
+
+      if(indexed.size() == 0) return true;
+
+      index.resize(S);
+
+      std::vector<char> built(S, 0);
+
+#pragma omp parallel for schedule(dynamic)
+      for(unsigned int s=0;s<S;s++){
+	std::vector<float> points(indexed.size()*E);
+
+	for(unsigned int i=0;i<indexed.size();i++)
+	  for(unsigned int j=0;j<E;j++)
+	    points[i*E + j] = responses[indexed[i]][s*E + j];
+
+	built[s] = index[s].build(points, E) ? 1 : 0;
+      }
+
+      for(unsigned int s=0;s<S;s++){
+	if(built[s] == 0){
+	  clear();
+	  return false;
+	}
+      }
+
+      return true;
+    }
+
+
+    void ResponseIndex::clear()
+    {
+      E = 0;
+      S = 0;
+      numStimulus = 0;
+      index.clear();
+      indexed.clear();
+      unindexed.clear();
+    }
+
+
+    bool ResponseIndex::query(unsigned int state, const std::vector<float>& response,
+			      unsigned int k, std::vector<unsigned int>& stimulus) const
+    {
+      stimulus.clear();
+
+      if(numStimulus == 0 || state >= S || response.size() != E) return false;
+
+      if(indexed.size() > 0){
+	std::vector<unsigned int> nearest;
+	std::vector<float> distances;
+
+	if(index[state].knearest(&(response[0]), k, 0.0f, nearest, distances) == false)
+	  return false;
+
+	for(const auto& i : nearest)
+	  stimulus.push_back(indexed[i]);
+      }
+
+      stimulus.insert(stimulus.end(), unindexed.begin(), unindexed.end());
+
+      return true;
+    }
+
+
+    bool ResponseIndex::expected_responses(const whiteice::dataset<>& data,
+					   std::vector<float>& responses) const
+    {
+      responses.resize(S*E);
+      for(auto& r : responses) r = 0.0f;
+
+      if(data.getNumberOfClusters() != 2) return false;
+      if(data.dimension(0) != E + S || data.dimension(1) != E) return false;
+
+      // data is stored preprocessed: gets raw values using affine inverse transforms
+      std::vector<float> A, a, B, b;
+
+      if(getPreprocessTransform(data, 0, true, A, a) == false) return false;
+      if(getPreprocessTransform(data, 1, true, B, b) == false) return false;
+
+      const unsigned int I = E + S;
+
+      std::vector<float> total(E, 0.0f);
+      std::vector<unsigned int> counts(S, 0);
+      std::vector<float> y(E);
+      unsigned int N = 0;
+
+      for(unsigned int n=0;n<data.size(0) && n<data.size(1);n++){
+	const auto& xp = data.access(0, n);
+	const auto& yp = data.access(1, n);
+
+	// HMM state is the largest one-hot input
+	unsigned int state = 0;
+	float best = -1e30f;
+
+	for(unsigned int s=0;s<S;s++){
+	  float v = a[E+s];
+	  for(unsigned int j=0;j<I;j++)
+	    v += A[(E+s)*I + j]*xp[j].c[0];
+
+	  if(v > best){
+	    best = v;
+	    state = s;
+	  }
+	}
+
+	for(unsigned int i=0;i<E;i++){
+	  float v = b[i];
+	  for(unsigned int j=0;j<E;j++)
+	    v += B[i*E + j]*yp[j].c[0];
+	  y[i] = v;
+	}
+
+	for(unsigned int i=0;i<E;i++){
+	  responses[state*E + i] += y[i];
+	  total[i] += y[i];
+	}
+
+	counts[state]++;
+	N++;
+      }
+
+      // states without measurements use mean over all measurements
+      for(unsigned int s=0;s<S;s++){
+	for(unsigned int i=0;i<E;i++){
+	  if(counts[s] > 0) responses[s*E + i] /= counts[s];
+	  else if(N > 0) responses[s*E + i] = total[i]/N;
+	}
+      }
+
+      return true;
+    }
+
+  };
+};
@@ -0,0 +1,64 @@
+/*
+ * ResponseIndex
+ *
+ * per HMM state nearest neighbour index of stimulus expected responses
+ * (mean measured EEG change per time unit while in the HMM state). used to
+ * find a shortlist of stimulus whose response is closest to the wanted
+ * change (target - current)/timestep so that only the shortlist needs to be
+ * scored exactly
+ */
+
+#ifndef ResponseIndex_h
+#define ResponseIndex_h
+
+#include <dinrhiw.h>
+#include <vector>
+
+#include "KDTree.h"
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class ResponseIndex
+    {
+    public:
+
+      ResponseIndex();
+      ~ResponseIndex();
+
+      // calculates expected responses of stimulus from (preprocessed) measurements.
+      // inputs are numInputs EEG values followed by one-hot HMM state
+      bool build(const std::vector< whiteice::dataset<> >& data,
+		 unsigned int numInputs, unsigned int numStates);
+
+      void clear();
+
+      // number of indexed stimulus
+      unsigned int size() const { return numStimulus; }
+
+      // finds k stimulus with expected response closest to response in HMM state,
+      // stimulus whose responses couldn't be calculated are always returned too
+      bool query(unsigned int state, const std::vector<float>& response,
+		 unsigned int k, std::vector<unsigned int>& stimulus) const;
+
+    private:
+
+      bool expected_responses(const whiteice::dataset<>& data,
+			      std::vector<float>& responses) const;
+
+      unsigned int E = 0, S = 0;
+      unsigned int numStimulus = 0;
+
+      std::vector<KDTree> index; // one index per HMM state
+
+      std::vector<unsigned int> indexed;   // stimulus of index points
+      std::vector<unsigned int> unindexed; // stimulus without expected responses
+
+    };
+
+  };
+};
+
+
+#endif
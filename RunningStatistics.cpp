@@ -0,0 +1,264 @@
+
+#include "RunningStatistics.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    static const char STATS_MAGIC[8] = { 'R','Z','S','T','A','T','S','1' };
+
+
+    RunningStatistics::RunningStatistics()
+    {
+    }
+
+
+    RunningStatistics::RunningStatistics(unsigned int dimension, bool covariance_)
+    {
+      reset(dimension, covariance_);
+    }
+
+
+    void RunningStatistics::reset(unsigned int dimension, bool covariance_)
+    {
+      D = dimension;
+      N = 0;
+      covariance = covariance_;
+
+      M.assign(D, 0.0);
+      M2.assign(D, 0.0);
+
+      if(covariance) C.assign(D*D, 0.0);
+      else C.clear();
+
+      reference = false;
+      refMean.clear();
+      refVar.clear();
+      refCov.clear();
+    }
+
+
+    bool RunningStatistics::add(const float* x, unsigned int dimension)
+    {
+      if(dimension != D) return false;
+
+      N++;
+
+      std::vector<double> delta(D), delta2(D);
+
+      for(unsigned int i=0;i<D;i++){
+	delta[i] = x[i] - M[i];
+	M[i] += delta[i]/N;
+	delta2[i] = x[i] - M[i];
+	M2[i] += delta[i]*delta2[i];
+      }
+
+      if(covariance){
+	for(unsigned int i=0;i<D;i++)
+	  for(unsigned int j=0;j<D;j++)
+	    C[i*D + j] += delta[i]*delta2[j];
+      }
+
+      return true;
+    }
+
+
+    float RunningStatistics::variance(unsigned int i) const
+    {
+      if(N < 2) return 0.0f;
+      return (float)(M2[i]/(N - 1));
+    }
+
+
+    void RunningStatistics::covarianceMatrix(std::vector<double>& cov) const
+    {
+      cov.assign(D*D, 0.0);
+
+      if(covariance == false || N < 2) return;
+
+      for(unsigned int k=0;k<D*D;k++)
+	cov[k] = C[k]/(N - 1);
+    }
+
+
+    void RunningStatistics::mark()
+    {
+      reference = true;
+
+      refMean = M;
+      refVar.resize(D);
+
+      for(unsigned int i=0;i<D;i++)
+	refVar[i] = variance(i);
+
+      if(covariance) covarianceMatrix(refCov);
+      else refCov.clear();
+    }
+
+
+    bool RunningStatistics::changed(float tolerance) const
+    {
+      if(reference == false || refMean.size() != D || refVar.size() != D)
+	return true;
+
+      const double epsilon = 1e-12;
+
+      for(unsigned int i=0;i<D;i++){
+	const double v = refVar[i] > epsilon ? refVar[i] : epsilon;
+
+	if(fabs(M[i] - refMean[i]) > tolerance*sqrt(v)) return true;
+	if(fabs(variance(i) - refVar[i]) > tolerance*v) return true;
+      }
+
+      if(covariance){
+	if(refCov.size() != D*D) return true;
+
+	std::vector<double> cov;
+	covarianceMatrix(cov);
+
+	double diff = 0.0, norm = 0.0;
+
+	for(unsigned int k=0;k<D*D;k++){
+	  diff += (cov[k] - refCov[k])*(cov[k] - refCov[k]);
+	  norm += refCov[k]*refCov[k];
+	}
+
+	if(sqrt(diff) > tolerance*sqrt(norm > epsilon ? norm : epsilon)) return true;
+      }
+
+      return false;
+    }
+
+
+    static bool write_doubles(FILE* handle, const std::vector<double>& v)
+    {
+      if(v.size() == 0) return true;
+      return (fwrite(v.data(), sizeof(double), v.size(), handle) == v.size());
+    }
+
+
+    static bool read_doubles(FILE* handle, std::vector<double>& v, unsigned int n)
+    {
+      v.resize(n);
+      if(n == 0) return true;
+      return (fread(v.data(), sizeof(double), n, handle) == n);
+    }
+
+
+    bool RunningStatistics::load(const std::string& filename,
+				 std::map<std::string, RunningStatistics>& stats)
+    {
+      stats.clear();
+
+      FILE* handle = fopen(filename.c_str(), "rb");
+      if(handle == NULL) return false;
+
+      char magic[sizeof(STATS_MAGIC)];
+      unsigned int count = 0;
+
+      bool ok = (fread(magic, 1, sizeof(magic), handle) == sizeof(magic) &&
+		 memcmp(magic, STATS_MAGIC, sizeof(magic)) == 0 &&
+		 fread(&count, sizeof(count), 1, handle) == 1);
+
+      for(unsigned int k=0;k<count && ok;k++){
+	unsigned int length = 0, d = 0;
+	unsigned char flags[2] = { 0, 0 };
+	unsigned long long n = 0;
+
+	ok = (fread(&length, sizeof(length), 1, handle) == 1 && length < 65536);
+	if(!ok) break;
+
+	std::string name(length, ' ');
+
+	ok = (fread(&name[0], 1, length, handle) == length &&
+	      fread(&d, sizeof(d), 1, handle) == 1 && d < 65536 &&
+	      fread(flags, 1, 2, handle) == 2 &&
+	      fread(&n, sizeof(n), 1, handle) == 1);
+	if(!ok) break;
+
+	RunningStatistics s(d, flags[0] != 0);
+	s.N = n;
+
+	ok = read_doubles(handle, s.M, d) && read_doubles(handle, s.M2, d);
+
+	if(ok && s.covariance) ok = read_doubles(handle, s.C, d*d);
+
+	if(ok && flags[1]){
+	  s.reference = true;
+	  ok = read_doubles(handle, s.refMean, d) && read_doubles(handle, s.refVar, d);
+	  if(ok && s.covariance) ok = read_doubles(handle, s.refCov, d*d);
+	}
+
+	if(ok) stats[name] = s;
+      }
+
+      fclose(handle);
+
+      if(ok == false) stats.clear();
+
+      return ok;
+    }
+
+
+    bool RunningStatistics::save(const std::string& filename,
+				 const std::map<std::string, RunningStatistics>& stats)
+    {
+      const std::string tmpname = filename + ".tmp";
+
+      FILE* handle = fopen(tmpname.c_str(), "wb");
+      if(handle == NULL) return false;
+
+      const unsigned int count = stats.size();
+
+      bool ok = (fwrite(STATS_MAGIC, 1, sizeof(STATS_MAGIC), handle) == sizeof(STATS_MAGIC) &&
+		 fwrite(&count, sizeof(count), 1, handle) == 1);
+
+      for(const auto& i : stats){
+	if(!ok) break;
+
+	const RunningStatistics& s = i.second;
+	const unsigned int length = i.first.size();
+	const unsigned char flags[2] = { (unsigned char)s.covariance, (unsigned char)s.reference };
+
+	ok = (fwrite(&length, sizeof(length), 1, handle) == 1 &&
+	      fwrite(i.first.data(), 1, length, handle) == length &&
+	      fwrite(&s.D, sizeof(s.D), 1, handle) == 1 &&
+	      fwrite(flags, 1, 2, handle) == 2 &&
+	      fwrite(&s.N, sizeof(s.N), 1, handle) == 1);
+
+	ok = ok && write_doubles(handle, s.M) && write_doubles(handle, s.M2);
+
+	if(ok && s.covariance) ok = write_doubles(handle, s.C);
+
+	if(ok && s.reference){
+	  ok = write_doubles(handle, s.refMean) && write_doubles(handle, s.refVar);
+	  if(ok && s.covariance) ok = write_doubles(handle, s.refCov);
+	}
+      }
+
+      if(fclose(handle) != 0) ok = false;
+
+      if(ok == false){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+#ifdef _WIN32
+      remove(filename.c_str()); // rename() doesn't replace files on windows
+#endif
+
+      if(rename(tmpname.c_str(), filename.c_str()) != 0){
+	remove(tmpname.c_str());
+	return false;
+      }
+
+      return true;
+    }
+
+  };
+};
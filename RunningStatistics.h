@@ -0,0 +1,77 @@
+/*
+ * RunningStatistics
+ *
+ * incrementally updated (Welford) mean and variance of measurement columns
+ * and optionally covariance matrix (PCA preprocessing). statistics are
+ * updated when measurements are added and saved to a statistics file so
+ * they are never recomputed from all data. mark() records statistics the
+ * current dataset preprocessing was computed with and changed() tells when
+ * new measurements have moved them enough that preprocessing must be
+ * recomputed
+ */
+
+#ifndef RunningStatistics_h
+#define RunningStatistics_h
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class RunningStatistics
+    {
+    public:
+
+      RunningStatistics();
+      RunningStatistics(unsigned int dimension, bool covariance = false);
+
+      // removes all values and reference statistics
+      void reset(unsigned int dimension, bool covariance = false);
+
+      bool add(const float* x, unsigned int dimension);
+      bool add(const std::vector<float>& x){ return add(x.data(), x.size()); }
+
+      unsigned int dimension() const { return D; }
+      unsigned long long count() const { return N; }
+      bool hasCovariance() const { return covariance; }
+
+      float mean(unsigned int i) const { return (float)M[i]; }
+      float variance(unsigned int i) const; // sample variance
+
+      // current statistics are used by dataset preprocessing
+      void mark();
+
+      // statistics have no reference or mean, variance (or covariance) has
+      // changed more than tolerance relative to standard deviation (variance)
+      bool changed(float tolerance) const;
+
+      // statistics file of many datasets (writes temporary file and renames it)
+      static bool load(const std::string& filename, std::map<std::string, RunningStatistics>& stats);
+      static bool save(const std::string& filename, const std::map<std::string, RunningStatistics>& stats);
+
+    private:
+
+      unsigned int D = 0;
+      unsigned long long N = 0;
+      bool covariance = false;
+
+      std::vector<double> M;    // mean
+      std::vector<double> M2;   // sum of squared differences from mean
+      std::vector<double> C;    // co-moment matrix C[i*D + j] (if covariance)
+
+      // statistics when dataset preprocessing was computed
+      bool reference = false;
+      std::vector<double> refMean, refVar, refCov;
+
+      void covarianceMatrix(std::vector<double>& cov) const;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -0,0 +1,127 @@
+
+#include "SampleRing.h"
+#include <algorithm>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    SampleRing::SampleRing(unsigned int dimension_, unsigned int capacity_) :
+      dimension(dimension_), capacity(capacity_ > 0 ? capacity_ : 1)
+    {
+      stamps.reset(new std::atomic<unsigned long long>[capacity]);
+      times.reset(new std::atomic<long long>[capacity]);
+      values.reset(new std::atomic<float>[capacity*dimension + 1]);
+
+      for(unsigned int i=0;i<capacity;i++){
+	stamps[i] = 0;
+	times[i] = 0;
+      }
+
+      for(unsigned int i=0;i<capacity*dimension;i++)
+	values[i] = 0.0f;
+
+      head = 0;
+    }
+
+
+    SampleRing::~SampleRing()
+    {
+    }
+
+
+    bool SampleRing::push(clock::time_point t, const std::vector<float>& x)
+    {
+      if(x.size() != dimension) return false;
+
+      const unsigned long long n = head.load(std::memory_order_relaxed);
+      const unsigned int slot = n % capacity;
+
+      stamps[slot].store(2*n+1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      times[slot].store(std::chrono::duration_cast<std::chrono::nanoseconds>
+			(t.time_since_epoch()).count(), std::memory_order_relaxed);
+
+      for(unsigned int i=0;i<dimension;i++)
+	values[slot*dimension + i].store(x[i], std::memory_order_relaxed);
+
+      stamps[slot].store(2*n+2, std::memory_order_release);
+      head.store(n+1, std::memory_order_release);
+
+      wait_cond.notify_all();
+
+      return true;
+    }
+
+
+    bool SampleRing::read(unsigned long long n, clock::time_point& t, std::vector<float>& x) const
+    {
+      const unsigned int slot = n % capacity;
+
+      const unsigned long long s1 = stamps[slot].load(std::memory_order_acquire);
+      if(s1 != 2*n+2) return false; // overwritten or not yet written
+
+      const long long ns = times[slot].load(std::memory_order_relaxed);
+
+      x.resize(dimension);
+      for(unsigned int i=0;i<dimension;i++)
+	x[i] = values[slot*dimension + i].load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      const unsigned long long s2 = stamps[slot].load(std::memory_order_relaxed);
+      if(s2 != s1) return false; // producer wrote over the slot while reading
+
+      t = clock::time_point(std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(ns)));
+
+      return true;
+    }
+
+
+    unsigned int SampleRing::readSince(unsigned long long& cursor,
+				       std::vector<clock::time_point>& t,
+				       std::vector< std::vector<float> >& x) const
+    {
+      const unsigned long long end = head.load(std::memory_order_acquire);
+
+      if(cursor > end) cursor = end;
+
+      // samples older than capacity have already been overwritten
+      if(end - cursor > capacity) cursor = end - capacity;
+
+      unsigned int count = 0;
+
+      clock::time_point ti;
+      std::vector<float> xi;
+
+      for(;cursor<end;cursor++){
+	if(read(cursor, ti, xi)){
+	  t.push_back(ti);
+	  x.push_back(xi);
+	  count++;
+	}
+      }
+
+      return count;
+    }
+
+
+    bool SampleRing::waitForSample(unsigned long long cursor, clock::time_point deadline) const
+    {
+      while(head.load(std::memory_order_acquire) <= cursor){
+	const auto now = clock::now();
+	if(now >= deadline) return false;
+
+	// short waits because push() notifies without holding the mutex
+	std::unique_lock<std::mutex> lock(wait_mutex);
+	wait_cond.wait_until(lock, std::min(deadline, now + std::chrono::milliseconds(2)));
+      }
+
+      return true;
+    }
+
+  };
+};
@@ -0,0 +1,77 @@
+/*
+ * SampleRing
+ *
+ * lock-free ring buffer of timestamped samples (single producer, any number
+ * of consumers). producer is the device thread receiving measurements and each
+ * consumer keeps its own cursor (number of the next sample to read) so that
+ * consumers get every sample without locking the device. samples older than
+ * capacity are overwritten and skipped by readers
+ */
+
+#ifndef SampleRing_h
+#define SampleRing_h
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class SampleRing
+    {
+    public:
+
+      typedef std::chrono::steady_clock clock;
+
+      SampleRing(unsigned int dimension, unsigned int capacity = 1024);
+      ~SampleRing();
+
+      unsigned int getDimension() const { return dimension; }
+      unsigned int getCapacity() const { return capacity; }
+
+      // adds new sample (only one thread may call push())
+      bool push(clock::time_point t, const std::vector<float>& x);
+
+      // number of the next sample to be pushed (cursor that reads only new samples)
+      unsigned long long getCursor() const { return head.load(); }
+
+      // appends samples [cursor, head) to times and values and moves cursor to
+      // head. returns number of samples read (overwritten samples are skipped)
+      unsigned int readSince(unsigned long long& cursor,
+			     std::vector<clock::time_point>& times,
+			     std::vector< std::vector<float> >& values) const;
+
+      // waits until sample number cursor exists or deadline has passed
+      bool waitForSample(unsigned long long cursor, clock::time_point deadline) const;
+
+    private:
+
+      // copies sample n if it is still in the buffer
+      bool read(unsigned long long n, clock::time_point& t, std::vector<float>& x) const;
+
+      const unsigned int dimension;
+      const unsigned int capacity;
+
+      // per slot sequence lock: 2n+1 while sample n is written, 2n+2 when it is ready
+      std::unique_ptr< std::atomic<unsigned long long>[] > stamps;
+      std::unique_ptr< std::atomic<long long>[] > times;  // nanoseconds since clock epoch
+      std::unique_ptr< std::atomic<float>[] > values;
+
+      std::atomic<unsigned long long> head;
+
+      // only used to sleep in waitForSample()
+      mutable std::mutex wait_mutex;
+      mutable std::condition_variable wait_cond;
+
+    };
+
+  };
+};
+
+
+#endif
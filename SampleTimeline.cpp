@@ -0,0 +1,91 @@
+
+#include "SampleTimeline.h"
+#include <algorithm>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    SampleTimeline::SampleTimeline()
+    {
+    }
+
+
+    SampleTimeline::~SampleTimeline()
+    {
+    }
+
+
+    void SampleTimeline::clear()
+    {
+      times.clear();
+      values.clear();
+    }
+
+
+    bool SampleTimeline::add(clock::time_point t, const std::vector<float>& x)
+    {
+      if(x.size() == 0) return false;
+
+      if(times.size() > 0){
+	if(t < times.back()) return false;
+	if(x.size() != values.back().size()) return false;
+      }
+
+      times.push_back(t);
+      values.push_back(x);
+
+      return true;
+    }
+
+
+    bool SampleTimeline::interpolate(clock::time_point t, std::vector<float>& x) const
+    {
+      if(times.size() == 0) return false;
+
+      if(t <= times.front()){
+	x = values.front();
+	return true;
+      }
+
+      if(t >= times.back()){
+	x = values.back();
+	return true;
+      }
+
+      // first sample after t
+      const unsigned int j = std::upper_bound(times.begin(), times.end(), t) - times.begin();
+      const unsigned int i = j - 1;
+
+      const double dt = std::chrono::duration<double>(times[j] - times[i]).count();
+      double p = 0.0;
+
+      if(dt > 0.0)
+	p = std::chrono::duration<double>(t - times[i]).count()/dt;
+
+      x.resize(values[i].size());
+
+      for(unsigned int k=0;k<x.size();k++)
+	x[k] = (float)((1.0 - p)*values[i][k] + p*values[j][k]);
+
+      return true;
+    }
+
+
+    SampleTimeline::clock::time_point SampleTimeline::getFirstTime() const
+    {
+      if(times.size() == 0) return clock::time_point();
+      return times.front();
+    }
+
+
+    SampleTimeline::clock::time_point SampleTimeline::getLastTime() const
+    {
+      if(times.size() == 0) return clock::time_point();
+      return times.back();
+    }
+
+  };
+};
@@ -0,0 +1,53 @@
+/*
+ * SampleTimeline
+ *
+ * timestamped signal samples from a short time window. used to
+ * interpolate signal values at exact time points (stimulus onset and
+ * onset + delay) instead of using whatever value was latest when polled
+ */
+
+#ifndef SampleTimeline_h
+#define SampleTimeline_h
+
+#include <vector>
+#include <chrono>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class SampleTimeline
+    {
+    public:
+
+      typedef std::chrono::steady_clock clock;
+
+      SampleTimeline();
+      ~SampleTimeline();
+
+      void clear();
+
+      // adds sample, timestamps must not decrease and dimensions must match
+      bool add(clock::time_point t, const std::vector<float>& x);
+
+      // linearly interpolated value at time t (clamps to the first or
+      // the last sample outside of the timeline)
+      bool interpolate(clock::time_point t, std::vector<float>& x) const;
+
+      unsigned int size() const { return times.size(); }
+
+      clock::time_point getFirstTime() const;
+      clock::time_point getLastTime() const;
+
+    private:
+
+      std::vector<clock::time_point> times;
+      std::vector< std::vector<float> > values;
+
+    };
+
+  };
+};
+
+
+#endif
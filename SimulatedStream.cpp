@@ -0,0 +1,80 @@
+
+#include "SimulatedStream.h"
+#include <thread>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    SimulatedStream::SimulatedStream(unsigned int dimension, unsigned int hz, source data_) :
+      data(data_), samples(dimension),
+      period(std::chrono::microseconds(1000000/(hz > 0 ? hz : 1))),
+      started(clock::now())
+    {
+    }
+
+
+    // generates samples for the time passed since the latest call
+    void SimulatedStream::generate()
+    {
+      std::lock_guard<std::mutex> lock(generate_mutex);
+
+      const unsigned long long n = (clock::now() - started)/period + 1;
+
+      if(n > generated + samples.getCapacity())
+	generated = n - samples.getCapacity();
+
+      std::vector<float> x;
+
+      for(;generated<n;generated++){
+	data(x);
+	samples.push(started + period*(clock::rep)generated, x);
+      }
+    }
+
+
+    bool SimulatedStream::readSince(unsigned long long& cursor,
+				    std::vector<clock::time_point>& times,
+				    std::vector< std::vector<float> >& x)
+    {
+      generate();
+      samples.readSince(cursor, times, x);
+      return true;
+    }
+
+
+    unsigned long long SimulatedStream::getCursor()
+    {
+      generate();
+      return samples.getCursor();
+    }
+
+
+    bool SimulatedStream::waitForSample(unsigned long long cursor, clock::time_point deadline)
+    {
+      generate();
+
+      clock::time_point t;
+
+      {
+	std::lock_guard<std::mutex> lock(generate_mutex);
+
+	// stream cursor isn't generation index after samples older than
+	// ring capacity were skipped: next pushed sample is number generated
+	const unsigned long long head = samples.getCursor();
+	if(cursor < head) return true;
+
+	t = started + period*(clock::rep)(generated + (cursor - head));
+      }
+
+      std::this_thread::sleep_until(t < deadline ? t : deadline);
+
+      generate();
+
+      return (samples.getCursor() > cursor);
+    }
+
+  };
+};
@@ -0,0 +1,63 @@
+/*
+ * SimulatedStream
+ *
+ * timestamped sample stream of a simulated device without its own sampling
+ * thread. samples are generated lazily at fixed times (hz) from the device's
+ * current value whenever the stream is read, so readers see the same stream
+ * interface as with real devices (see SampleRing)
+ */
+
+#ifndef SimulatedStream_h
+#define SimulatedStream_h
+
+#include "SampleRing.h"
+
+#include <vector>
+#include <mutex>
+#include <functional>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class SimulatedStream
+    {
+    public:
+
+      typedef SampleRing::clock clock;
+
+      // gets the current value of the device
+      typedef std::function<bool (std::vector<float>& x)> source;
+
+      SimulatedStream(unsigned int dimension, unsigned int hz, source data);
+
+      // see DataSource::readSince()
+      bool readSince(unsigned long long& cursor,
+		     std::vector<clock::time_point>& times,
+		     std::vector< std::vector<float> >& samples);
+
+      unsigned long long getCursor();
+
+      // sleeps until sample's time or deadline
+      bool waitForSample(unsigned long long cursor, clock::time_point deadline);
+
+    private:
+
+      // adds samples up to current time to stream
+      void generate();
+
+      source data;
+      SampleRing samples;
+      const clock::duration period;
+      const clock::time_point started;
+
+      std::mutex generate_mutex;
+      unsigned long long generated = 0; // number of generated samples
+
+    };
+
+  };
+};
+
+
+#endif
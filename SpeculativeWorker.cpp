@@ -0,0 +1,150 @@
+
+#include "SpeculativeWorker.h"
+#include <chrono>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    SpeculativeWorker::SpeculativeWorker(job j)
+    {
+      work = j;
+      cancel = false;
+      completed = 0;
+    }
+
+
+    SpeculativeWorker::~SpeculativeWorker()
+    {
+      this->stop();
+    }
+
+
+    bool SpeculativeWorker::start()
+    {
+      if(!work) return false;
+
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running){
+	return false; // thread is already running
+      }
+
+      {
+	std::lock_guard<std::mutex> slock(state_mutex);
+	active = false;
+	busy = false;
+	cancel = false;
+	thread_running = true;
+      }
+
+      try{
+	if(worker_thread){ delete worker_thread; worker_thread = nullptr; }
+	worker_thread = new std::thread(std::bind(&SpeculativeWorker::worker_loop, this));
+      }
+      catch(std::exception& e){
+	std::lock_guard<std::mutex> slock(state_mutex);
+	thread_running = false;
+	worker_thread = nullptr;
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool SpeculativeWorker::isRunning()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running && worker_thread != nullptr)
+	return true;
+      else
+	return false;
+    }
+
+
+    bool SpeculativeWorker::stop()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running == false)
+	return false;
+
+      {
+	std::lock_guard<std::mutex> slock(state_mutex);
+	thread_running = false;
+	active = false;
+	cancel = true;
+	state_cond.notify_all();
+      }
+
+      if(worker_thread){
+	worker_thread->join();
+	delete worker_thread;
+      }
+
+      worker_thread = nullptr;
+
+      return true;
+    }
+
+
+    void SpeculativeWorker::resume()
+    {
+      std::lock_guard<std::mutex> lock(state_mutex);
+      cancel = false;
+      active = true;
+      state_cond.notify_all();
+    }
+
+
+    void SpeculativeWorker::pause()
+    {
+      std::unique_lock<std::mutex> lock(state_mutex);
+
+      active = false;
+      cancel = true;
+
+      while(busy)
+	state_cond.wait(lock);
+
+      cancel = false;
+    }
+
+
+    void SpeculativeWorker::worker_loop()
+    {
+      while(true){
+	{
+	  std::unique_lock<std::mutex> lock(state_mutex);
+
+	  while(thread_running && active == false)
+	    state_cond.wait(lock);
+
+	  if(thread_running == false)
+	    break;
+
+	  busy = true;
+	}
+
+	const bool computed = work(cancel);
+
+	{
+	  std::lock_guard<std::mutex> lock(state_mutex);
+	  busy = false;
+	  if(computed && cancel == false) completed++;
+	  state_cond.notify_all();
+	}
+
+	if(computed == false){
+	  // nothing new to compute: waits for fresher data
+	  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+      }
+    }
+
+  };
+};
@@ -0,0 +1,73 @@
+/*
+ * SpeculativeWorker
+ *
+ * background thread that repeatedly runs a job (scoring stimulus for the next
+ * tick) while the current stimulus is displayed.
+ * pause() cancels the job and waits until the worker is idle so that the
+ * main loop can use the precomputed results
+ */
+
+#ifndef SpeculativeWorker_h
+#define SpeculativeWorker_h
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class SpeculativeWorker
+    {
+    public:
+
+      // job must return quickly after cancel is set. returns false
+      // if there was nothing to compute (worker waits a while)
+      typedef std::function<bool (const std::atomic<bool>& cancel)> job;
+
+      SpeculativeWorker(job j);
+      ~SpeculativeWorker();
+
+      bool start();
+
+      bool isRunning();
+
+      bool stop();
+
+      // starts running job in background
+      void resume();
+
+      // cancels job and waits until worker is idle
+      void pause();
+
+      // number of completed (non-cancelled) jobs
+      unsigned long long getCompleted() const { return completed; }
+
+    private:
+
+      void worker_loop();
+
+      job work;
+
+      std::mutex thread_mutex;
+      bool thread_running = false;
+      std::thread* worker_thread = nullptr;
+
+      std::mutex state_mutex;
+      std::condition_variable state_cond;
+      bool active = false; // job should be run
+      bool busy = false;   // job is running
+
+      std::atomic<bool> cancel;
+      std::atomic<unsigned long long> completed;
+
+    };
+
+  };
+};
+
+
+#endif
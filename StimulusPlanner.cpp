@@ -0,0 +1,311 @@
+
+#include "StimulusPlanner.h"
+#include <algorithm>
+#include <math.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    StimulusPlanner::StimulusPlanner()
+    {
+    }
+
+    StimulusPlanner::~StimulusPlanner()
+    {
+    }
+
+
+    bool StimulusPlanner::setParameters(unsigned int depth_, unsigned int beamWidth_)
+    {
+      if(beamWidth_ == 0) return false;
+
+      if(depth != depth_ || beamWidth != beamWidth_)
+	previous.clear();
+
+      depth = depth_;
+      beamWidth = beamWidth_;
+
+      return true;
+    }
+
+
+    bool StimulusPlanner::setTransitions(const std::vector<float>& A_, unsigned int S_)
+    {
+      if(A_.size() != S_*S_) return false;
+
+      A = A_;
+      S = S_;
+      previous.clear();
+      predictions.clear();
+      previousPredictions.clear();
+
+      return true;
+    }
+
+
+    bool StimulusPlanner::setGrid(float grid_)
+    {
+      if(grid_ <= 0.0f) return false;
+
+      if(grid != grid_){
+	grid = grid_;
+	predictions.clear(); // keys are not valid anymore
+	previousPredictions.clear();
+      }
+
+      return true;
+    }
+
+
+    void StimulusPlanner::reset()
+    {
+      previous.clear();
+      predictions.clear();
+      previousPredictions.clear();
+      expanded = 0;
+      depthReached = 0;
+      reused = 0;
+    }
+
+
+    bool StimulusPlanner::plan(const std::vector<float>& eeg, unsigned int state,
+			       const std::vector<unsigned int>& candidates,
+			       const std::vector< std::vector<float> >& targets,
+			       const std::vector< std::vector<float> >& variances,
+			       float timestep, const predictor& f, unsigned int budgetMs,
+			       std::vector<unsigned int>& sequence)
+    {
+      sequence.clear();
+      expanded = 0;
+      depthReached = 0;
+      reused = 0;
+
+      if(depth == 0 || candidates.size() == 0 || eeg.size() == 0) return false;
+      if(targets.size() == 0 || targets.size() != variances.size()) return false;
+
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budgetMs);
+
+      // predictions of the latest call can be reused, older ones are forgotten
+      previousPredictions.swap(predictions);
+      predictions.clear();
+
+      node root;
+      root.eeg = eeg;
+      root.state = state;
+      root.cost = 0.0f;
+
+      if(S > 0){
+	root.belief.resize(S);
+	for(unsigned int i=0;i<S;i++)
+	  root.belief[i] = (state < S) ? (i == state ? 1.0f : 0.0f) : 1.0f/S;
+      }
+
+      // the previous plan without its first (already shown) stimulus is kept in the beam
+      std::vector<unsigned int> seed;
+
+      for(unsigned int i=1;i<previous.size();i++){
+	if(std::find(candidates.begin(), candidates.end(), previous[i]) == candidates.end())
+	  break;
+	seed.push_back(previous[i]);
+      }
+
+      node seedNode = root;
+      bool seedAlive = (seed.size() > 0);
+
+      std::vector<node> beam;
+      beam.push_back(root);
+
+      for(unsigned int k=0;k<depth;k++){
+	// the first step is always computed fully so that there is some result
+	if(k > 0 && std::chrono::steady_clock::now() > deadline)
+	  break;
+
+	const unsigned int C = candidates.size();
+
+	std::vector<node> children(beam.size()*C);
+	std::vector<char> ok(children.size(), 0);
+	unsigned int count = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+:count)
+	for(unsigned int n=0;n<children.size();n++){
+	  if(k > 0 && std::chrono::steady_clock::now() > deadline)
+	    continue;
+
+	  if(expand(beam[n/C], candidates[n%C], k, targets, variances, timestep, f, children[n]))
+	    ok[n] = 1;
+
+	  count++;
+	}
+
+	expanded += count;
+
+	for(unsigned int n=0;n<children.size();n++)
+	  if(ok[n]) remember(children[n]);
+
+	if(seedAlive && k < seed.size()){
+	  node c;
+	  if(expand(seedNode, seed[k], k, targets, variances, timestep, f, c)){
+	    remember(c);
+	    seedNode = c;
+	  }
+	  else
+	    seedAlive = false;
+	}
+	else seedAlive = false;
+
+	std::vector<node> next;
+
+	for(unsigned int n=0;n<children.size();n++)
+	  if(ok[n]) next.push_back(children[n]);
+
+	if(next.size() == 0) break;
+
+	const unsigned int B = std::min((unsigned int)next.size(), beamWidth);
+
+	std::partial_sort(next.begin(), next.begin() + B, next.end(),
+			  [](const node& a, const node& b){ return (a.cost < b.cost); });
+
+	next.resize(B);
+
+	if(seedAlive){
+	  bool found = false;
+
+	  for(const auto& n : next)
+	    if(n.sequence == seedNode.sequence) found = true;
+
+	  if(found == false){
+	    if(next.size() >= beamWidth) next.back() = seedNode;
+	    else next.push_back(seedNode);
+	  }
+	}
+
+	beam = next;
+	depthReached = k+1;
+      }
+
+      if(depthReached == 0) return false;
+
+      unsigned int best = 0;
+
+      for(unsigned int i=0;i<beam.size();i++)
+	if(beam[i].cost < beam[best].cost) best = i;
+
+      sequence = beam[best].sequence;
+      previous = sequence;
+
+      return true;
+    }
+
+
+    bool StimulusPlanner::expand(const node& parent, unsigned int stimulus, unsigned int k,
+				 const std::vector< std::vector<float> >& targets,
+				 const std::vector< std::vector<float> >& variances,
+				 float timestep, const predictor& f, node& child) const
+    {
+      const unsigned int E = parent.eeg.size();
+
+      child.key.resize(E + 2);
+      child.key[0] = (int)stimulus;
+      child.key[1] = (int)parent.state;
+
+      for(unsigned int i=0;i<E;i++)
+	child.key[i+2] = (int)floorf(parent.eeg[i]/grid + 0.5f);
+
+      std::vector<float>& m = child.m;
+      std::vector<float>& var = child.var;
+
+      // prediction maps are not modified while nodes are expanded
+      const prediction* found = nullptr;
+
+      auto current = predictions.find(child.key);
+
+      if(current != predictions.end()) found = &(current->second);
+      else{
+	auto latest = previousPredictions.find(child.key);
+	if(latest != previousPredictions.end()) found = &(latest->second);
+      }
+
+      if(found != nullptr && found->m.size() == E && found->var.size() == E){
+	m = found->m;
+	var = found->var;
+	child.reused = true;
+      }
+      else{
+	m.resize(E);
+	var.resize(E);
+	child.reused = false;
+
+	if(f(stimulus, parent.eeg, parent.state, &(m[0]), &(var[0])) == false)
+	  return false;
+      }
+
+      const unsigned int t = std::min(k, (unsigned int)(targets.size()-1));
+      const auto& target = targets[t];
+      const auto& targetVariance = variances[t];
+
+      if(target.size() != E || targetVariance.size() != E) return false;
+
+      child.sequence = parent.sequence;
+      child.sequence.push_back(stimulus);
+      child.eeg.resize(E);
+
+      // the same error measure as in greedy selection
+      float error = 0.0f;
+
+      for(unsigned int i=0;i<E;i++){
+	float p = parent.eeg[i] + m[i]*timestep;
+	if(p < 0.0f) p = 0.0f;
+	else if(p > 1.0f) p = 1.0f;
+
+	child.eeg[i] = p;
+
+	const float stdev = sqrtf(fabsf(var[i]))*timestep;
+	const float d = (fabsf(target[i] - p) + 0.50f*stdev)/sqrtf(targetVariance[i]);
+
+	error += d*d;
+      }
+
+      child.cost = parent.cost + sqrtf(error);
+
+      // HMM state probabilities of the next step
+      child.state = parent.state;
+      child.belief.resize(S);
+
+      if(S > 0 && parent.belief.size() == S){
+	float sum = 0.0f;
+
+	for(unsigned int j=0;j<S;j++){
+	  float p = 0.0f;
+	  for(unsigned int i=0;i<S;i++)
+	    p += parent.belief[i]*A[i*S + j];
+	  child.belief[j] = p;
+	  sum += p;
+	}
+
+	if(sum > 0.0f){
+	  for(auto& p : child.belief) p /= sum;
+	}
+
+	child.state = std::max_element(child.belief.begin(), child.belief.end()) - child.belief.begin();
+      }
+
+      return true;
+    }
+
+
+    void StimulusPlanner::remember(const node& n)
+    {
+      if(n.reused) reused++;
+
+      if(predictions.find(n.key) != predictions.end()) return;
+
+      prediction& p = predictions[n.key];
+      p.m = n.m;
+      p.var = n.var;
+    }
+
+  };
+};
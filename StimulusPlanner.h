@@ -0,0 +1,132 @@
+/*
+ * StimulusPlanner
+ *
+ * multi-step lookahead selection of stimulus. rolls predicted EEG values
+ * forward using stimulus response models and HMM state transition
+ * probabilities and searches best N-step long stimulus sequence using
+ * beam search within a time budget (anytime). the best plan of the
+ * previous tick is kept in the beam and response predictions of the
+ * previous tick are kept (keyed by stimulus, HMM state and EEG values
+ * quantized to a grid) so that the part of the search tree the measured
+ * EEG values follow doesn't have to be predicted again
+ */
+
+#ifndef StimulusPlanner_h
+#define StimulusPlanner_h
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class StimulusPlanner
+    {
+    public:
+
+      // predicts response mean m and variance var (per time unit) of stimulus
+      // for EEG values and HMM state. must be thread-safe
+      typedef std::function<bool (unsigned int stimulus, const std::vector<float>& eeg,
+				  unsigned int state, float* m, float* var)> predictor;
+
+      StimulusPlanner();
+      ~StimulusPlanner();
+
+      // sets length of planned sequences and number of sequences kept in beam
+      bool setParameters(unsigned int depth, unsigned int beamWidth);
+
+      unsigned int getDepth() const { return depth; }
+
+      // sets HMM transition probabilities A[i*S + j] = p(next = j | current = i)
+      bool setTransitions(const std::vector<float>& A, unsigned int S);
+
+      // sets quantization step of EEG values in prediction keys
+      bool setGrid(float grid);
+      float getGrid() const { return grid; }
+
+      // forgets previous plan and predictions (models have changed)
+      void reset();
+
+      // plans sequence of candidate stimulus that moves EEG towards targets[k] at
+      // steps k = 0..depth-1 (targets beyond the end repeat the last one).
+      // returns best sequence found within budgetMs milliseconds
+      bool plan(const std::vector<float>& eeg, unsigned int state,
+		const std::vector<unsigned int>& candidates,
+		const std::vector< std::vector<float> >& targets,
+		const std::vector< std::vector<float> >& variances,
+		float timestep, const predictor& f, unsigned int budgetMs,
+		std::vector<unsigned int>& sequence);
+
+      // statistics of the latest plan() call
+      unsigned int getExpanded() const { return expanded; }
+      unsigned int getDepthReached() const { return depthReached; }
+      unsigned int getReused() const { return reused; } // predictions not recomputed
+
+    private:
+
+      struct node {
+	std::vector<unsigned int> sequence;
+	std::vector<float> eeg;
+	std::vector<float> belief; // HMM state probabilities
+	unsigned int state;        // most probable HMM state
+	float cost;
+
+	// prediction of the last stimulus and its key
+	std::vector<int> key;
+	std::vector<float> m, var;
+	bool reused = false;
+      };
+
+      struct prediction {
+	std::vector<float> m, var;
+      };
+
+      struct key_hash {
+	size_t operator()(const std::vector<int>& k) const {
+	  size_t h = 14695981039346656037ULL; // FNV-1a
+	  for(const auto& v : k){
+	    h ^= (size_t)(unsigned int)v;
+	    h *= 1099511628211ULL;
+	  }
+	  return h;
+	}
+      };
+
+      typedef std::unordered_map< std::vector<int>, prediction, key_hash > prediction_map;
+
+      // expands node with stimulus for step k, returns false if prediction fails
+      bool expand(const node& parent, unsigned int stimulus, unsigned int k,
+		  const std::vector< std::vector<float> >& targets,
+		  const std::vector< std::vector<float> >& variances,
+		  float timestep, const predictor& f, node& child) const;
+
+      // stores prediction used by node so that it is available in the next plan() call
+      void remember(const node& n);
+
+      unsigned int depth = 0;
+      unsigned int beamWidth = 8;
+
+      unsigned int S = 0;
+      std::vector<float> A;
+
+      std::vector<unsigned int> previous; // best plan of the latest call
+
+      // predictions used by this and the latest call. only read while
+      // nodes are expanded in parallel
+      prediction_map predictions, previousPredictions;
+      float grid = 0.01f;
+
+      unsigned int expanded = 0;
+      unsigned int depthReached = 0;
+      unsigned int reused = 0;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -0,0 +1,127 @@
+
+#include "TickScheduler.h"
+#include <thread>
+
+#ifndef _WIN32
+#include <time.h>
+#include <errno.h>
+#endif
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    TickScheduler::TickScheduler(std::chrono::microseconds tickLength_) :
+      tickLength(tickLength_.count() > 0 ? tickLength_ : std::chrono::microseconds(1))
+    {
+      reset();
+    }
+
+
+    TickScheduler::~TickScheduler()
+    {
+    }
+
+
+    void TickScheduler::reset()
+    {
+      start = clock::now();
+      resetStatistics();
+    }
+
+
+    long long TickScheduler::getTick() const
+    {
+      return (clock::now() - start)/tickLength;
+    }
+
+
+    TickScheduler::clock::time_point TickScheduler::deadline(long long tick) const
+    {
+      return start + tick*tickLength;
+    }
+
+
+    long long TickScheduler::getMilliseconds() const
+    {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+    }
+
+
+    long long TickScheduler::wait(long long lastTick)
+    {
+      const long long next = lastTick + 1;
+
+      sleepUntil(deadline(next));
+
+      const auto now = clock::now();
+      long long tick = (now - start)/tickLength;
+      if(tick < next) tick = next; // clock granularity
+
+      const long long late =
+	std::chrono::duration_cast<std::chrono::microseconds>(now - deadline(next)).count();
+
+      latenessUs = late > 0 ? late : 0;
+      totalLatenessUs += latenessUs;
+      if(latenessUs > maxLatenessUs) maxLatenessUs = (long long)latenessUs;
+
+      if(lastTick >= 0 && tick > next)
+	overruns += (tick - next);
+
+      ticks++;
+
+      return tick;
+    }
+
+
+    void TickScheduler::sleepUntil(clock::time_point t)
+    {
+#ifndef _WIN32
+      // steady_clock uses CLOCK_MONOTONIC: sleeps to absolute time so that
+      // signal interruptions and scheduling delays don't accumulate
+      const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+      if(ns <= 0) return;
+
+      struct timespec ts;
+      ts.tv_sec  = (time_t)(ns / 1000000000LL);
+      ts.tv_nsec = (long)(ns % 1000000000LL);
+
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#else
+      std::this_thread::sleep_until(t);
+#endif
+    }
+
+
+    float TickScheduler::getLatenessMs() const
+    {
+      return latenessUs/1000.0f;
+    }
+
+
+    float TickScheduler::getMeanLatenessMs() const
+    {
+      if(ticks == 0) return 0.0f;
+      return (totalLatenessUs/1000.0f)/ticks;
+    }
+
+
+    float TickScheduler::getMaxLatenessMs() const
+    {
+      return maxLatenessUs/1000.0f;
+    }
+
+
+    void TickScheduler::resetStatistics()
+    {
+      ticks = 0;
+      overruns = 0;
+      latenessUs = 0;
+      totalLatenessUs = 0;
+      maxLatenessUs = 0;
+    }
+
+  };
+};
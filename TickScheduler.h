@@ -0,0 +1,76 @@
+/*
+ * TickScheduler
+ *
+ * absolute deadline scheduler for engine ticks. tick n starts at
+ * start + n*tickLength of the monotonic clock so that wakeup jitter
+ * does not accumulate. records how late each tick started and how
+ * many ticks were skipped because processing took too long (overruns)
+ */
+
+#ifndef TickScheduler_h
+#define TickScheduler_h
+
+#include <chrono>
+#include <atomic>
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class TickScheduler
+    {
+    public:
+
+      typedef std::chrono::steady_clock clock;
+
+      TickScheduler(std::chrono::microseconds tickLength);
+      ~TickScheduler();
+
+      // starts counting ticks from now and resets statistics
+      void reset();
+
+      std::chrono::microseconds getTickLength() const { return tickLength; }
+
+      // tick that is currently running
+      long long getTick() const;
+
+      // start time of the tick
+      clock::time_point deadline(long long tick) const;
+
+      // milliseconds since reset() in monotonic time
+      long long getMilliseconds() const;
+
+      // waits until the start of the first tick after lastTick
+      // and returns current tick (>= lastTick+1)
+      long long wait(long long lastTick);
+
+      // sleeps until the given absolute time (returns immediately if it has passed)
+      static void sleepUntil(clock::time_point t);
+
+      // statistics
+      unsigned long long getTicks() const { return ticks; }
+      unsigned long long getOverruns() const { return overruns; }
+      float getLatenessMs() const;     // lateness of the latest tick
+      float getMeanLatenessMs() const;
+      float getMaxLatenessMs() const;
+
+      void resetStatistics();
+
+    private:
+
+      const std::chrono::microseconds tickLength;
+      clock::time_point start;
+
+      std::atomic<unsigned long long> ticks;
+      std::atomic<unsigned long long> overruns; // skipped ticks
+      std::atomic<long long> latenessUs;
+      std::atomic<long long> totalLatenessUs;
+      std::atomic<long long> maxLatenessUs;
+
+    };
+
+  };
+};
+
+
+#endif
@@ -0,0 +1,550 @@
+
+#include "TrainingScheduler.h"
+#include <functional>
+#include <algorithm>
+#include <stdio.h>
+
+
+namespace whiteice
+{
+  namespace resonanz
+  {
+
+    const unsigned int TrainingScheduler::POLL_MS;
+    const unsigned int TrainingScheduler::SNAPSHOT_SECONDS;
+    const unsigned int TrainingScheduler::PATIENCE;
+    const unsigned int TrainingScheduler::ITERATIONS_PER_SAMPLE;
+    const unsigned int TrainingScheduler::MIN_ITERATIONS;
+    constexpr float TrainingScheduler::MIN_IMPROVEMENT;
+    
+
+    TrainingScheduler::TrainingScheduler(unsigned int concurrency_,
+					 unsigned int iterations_,
+					 unsigned int bayesSamples_) :
+      concurrency(concurrency_ > 0 ? concurrency_ : 1),
+      iterations(iterations_ > 0 ? iterations_ : 1),
+      bayesSamples(bayesSamples_)
+    {
+      for(unsigned int i=0;i<MAX_GROUPS;i++)
+	groupCompleted[i] = 0;
+
+      started = std::chrono::steady_clock::now();
+    }
+
+
+    TrainingScheduler::~TrainingScheduler()
+    {
+      this->stop();
+
+      for(auto t : queue){
+	freeTask(*t);
+	delete t;
+      }
+
+      queue.clear();
+    }
+
+
+    bool TrainingScheduler::add(const whiteice::dataset<>& data,
+				const whiteice::nnetwork<>& nn,
+				const std::string& filename,
+				unsigned int group,
+				Start start,
+				unsigned int iters,
+				const ModelInfo* info)
+    {
+      if(group >= MAX_GROUPS) return false;
+
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running) return false; // models cannot be added while running
+
+      Task* t = new Task;
+      t->data = &data;
+      t->nn = nn;
+      t->filename = filename;
+      t->group = group;
+      t->start = start;
+      t->iterations = (iters > 0 && start != RANDOM_START) ? iters : iterations;
+      t->iterations = std::min(t->iterations, budget(data));
+
+      if(info){
+	t->hasInfo = true;
+	t->info = *info;
+      }
+
+      queue.push_back(t);
+      total++;
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::start()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running){
+	return false; // thread is already running
+      }
+
+      started = std::chrono::steady_clock::now();
+
+      try{
+	thread_running = true;
+	if(scheduler_thread){ delete scheduler_thread; scheduler_thread = nullptr; }
+	scheduler_thread = new std::thread(std::bind(&TrainingScheduler::scheduler_loop, this));
+      }
+      catch(std::exception& e){
+	thread_running = false;
+	scheduler_thread = nullptr;
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::isRunning()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      if(thread_running && scheduler_thread != nullptr)
+	return true;
+      else
+	return false;
+    }
+
+
+    bool TrainingScheduler::stop()
+    {
+      std::lock_guard<std::mutex> lock(thread_mutex);
+
+      thread_running = false;
+
+      if(scheduler_thread == nullptr)
+	return false;
+
+      scheduler_thread->join();
+      delete scheduler_thread;
+      scheduler_thread = nullptr;
+
+      return true;
+    }
+
+
+    unsigned int TrainingScheduler::getCompleted(unsigned int group) const
+    {
+      if(group >= MAX_GROUPS) return 0;
+      return groupCompleted[group];
+    }
+
+
+    double TrainingScheduler::getETA() const
+    {
+      const float p = progress;
+      if(p <= 0.0f) return -1.0;
+
+      const double elapsed = std::chrono::duration<double>
+	(std::chrono::steady_clock::now() - started).count();
+
+      return elapsed*(1.0 - p)/p;
+    }
+
+
+    unsigned int TrainingScheduler::budget(const whiteice::dataset<>& data) const
+    {
+      const unsigned int n = ITERATIONS_PER_SAMPLE*data.size(0);
+      return std::min(iterations, std::max(n, MIN_ITERATIONS));
+    }
+
+
+    bool TrainingScheduler::loadTask(Task& t, const std::string& filename,
+				     std::vector< whiteice::math::vertex<> >& weights)
+    {
+      whiteice::bayesian_nnetwork<> bnn;
+      whiteice::nnetwork<> net;
+
+      weights.clear();
+
+      if(bnn.load(filename) == false) return false;
+      if(bnn.exportSamples(net, weights) == false || weights.size() == 0) return false;
+
+      std::vector<unsigned int> a1, a2;
+      net.getArchitecture(a1);
+      t.nn.getArchitecture(a2);
+
+      if(a1 != a2) return false; // network architecture has changed
+
+      // latest sample is the starting point
+      return t.nn.importdata(weights[weights.size()-1]);
+    }
+
+
+    bool TrainingScheduler::resumeTask(Task& t)
+    {
+      if(t.hasInfo == false) return false;
+
+      const std::string filename = ModelInfo::partial(t.filename);
+
+      ModelInfo info;
+
+      if(info.load(ModelInfo::sidecar(filename)) == false || info.sameData(t.info) == false)
+	return false; // snapshot is from different data
+
+      std::vector< whiteice::math::vertex<> > weights;
+
+      if(loadTask(t, filename, weights) == false)
+	return false;
+
+      if(info.hmcSamples > 0 && bayesSamples > 0){
+	// continues sampling: collected samples are kept
+	t.priorSamples = weights;
+	t.info.iterations = info.iterations;
+	t.info.error = info.error;
+	t.iterations = 0;
+      }
+      else{
+	// continues gradient descent with remaining iterations
+	t.priorIterations = info.iterations;
+	t.iterations = (t.iterations > info.iterations) ? (t.iterations - info.iterations) : 0;
+	t.iterations = std::max(t.iterations, MIN_ITERATIONS);
+      }
+
+      t.priorSeconds = info.seconds;
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::startTask(Task& t)
+    {
+      t.priorSamples.clear();
+      t.priorIterations = 0;
+      t.priorSeconds = 0.0f;
+
+      std::vector< whiteice::math::vertex<> > weights;
+
+      if(resumeTask(t) == false){
+	if(t.start != WARM_START || loadTask(t, t.filename, weights) == false){
+	  t.nn.randomize();
+	  t.iterations = budget(*t.data); // full training from random weights
+	}
+      }
+
+      t.bestError = 0.0f;
+      t.bestIteration = 0;
+      t.started = std::chrono::steady_clock::now();
+      t.snapshot = t.started;
+
+      if(t.priorSamples.size() > 0)
+	return startSampler(t);
+
+      t.optimizer = new whiteice::math::NNGradDescent<>();
+
+      // each model uses single thread, parallelism comes from concurrent models
+      if(t.optimizer->startOptimize(*t.data, t.nn, 1) == false){
+	delete t.optimizer;
+	t.optimizer = nullptr;
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::startSampler(Task& t)
+    {
+      // uncertainty analysis
+      const bool adaptive = true;
+
+      t.sampler = new whiteice::UHMC<>(t.nn, *t.data, adaptive);
+
+      if(t.sampler->startSampler() == false){
+	delete t.sampler;
+	t.sampler = nullptr;
+	return false;
+      }
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::pollTask(Task& t, float& done)
+    {
+      // sampling (if used) is the second half of the work of the model
+      const float share = (bayesSamples > 0) ? 0.5f : 1.0f;
+
+      if(t.optimizer){
+	whiteice::math::blas_real<float> error = 1000.0f;
+	unsigned int iters = 0;
+
+	t.optimizer->getSolutionStatistics(error, iters);
+
+	// error is measured by NNGradDescent<> using its held-out part of the data
+	const float e = error.c[0];
+
+	if(t.bestIteration == 0 || e < t.bestError*(1.0f - MIN_IMPROVEMENT)){
+	  t.bestError = e;
+	  t.bestIteration = iters > 0 ? iters : 1;
+	}
+
+	const bool converged = (iters >= t.bestIteration + PATIENCE);
+
+	if(iters < t.iterations && converged == false){
+	  done = share*iters/(float)t.iterations;
+	  return false;
+	}
+
+	// gets finished solution
+	t.optimizer->stopComputation();
+	t.optimizer->getSolution(t.nn, error, iters);
+
+	t.info.iterations = t.priorIterations + iters;
+	t.info.error = error.c[0];
+
+	delete t.optimizer;
+	t.optimizer = nullptr;
+
+	if(bayesSamples > 0){
+	  // switches to uncertainty analysis
+	  if(startSampler(t) == false){
+	    failed++;
+	    return true;
+	  }
+
+	  done = share;
+	  return false;
+	}
+
+	whiteice::bayesian_nnetwork<> bnn;
+
+	if(bnn.importNetwork(t.nn) == false || saveTask(t, bnn) == false)
+	  failed++;
+
+	return true;
+      }
+      else if(t.sampler){
+	const unsigned int samples = t.priorSamples.size() + t.sampler->getNumberOfSamples();
+
+	if(samples < bayesSamples){
+	  done = share + share*samples/(float)bayesSamples;
+	  return false;
+	}
+
+	t.sampler->stopSampler();
+
+	whiteice::bayesian_nnetwork<> bnn;
+
+	if(samplerNetwork(t, bnn) == false || saveTask(t, bnn) == false)
+	  failed++;
+
+	return true;
+      }
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::samplerNetwork(Task& t, whiteice::bayesian_nnetwork<>& bnn)
+    {
+      if(t.sampler->getNetwork(bnn) == false) return false;
+
+      if(t.priorSamples.size() == 0) return true;
+
+      // adds samples collected before optimization was stopped
+      whiteice::nnetwork<> net;
+      std::vector< whiteice::math::vertex<> > samples;
+
+      if(bnn.exportSamples(net, samples) == false) return false;
+
+      samples.insert(samples.begin(), t.priorSamples.begin(), t.priorSamples.end());
+
+      return bnn.importSamples(net, samples);
+    }
+
+
+    bool TrainingScheduler::snapshotTask(Task& t)
+    {
+      if(t.hasInfo == false) return false;
+
+      whiteice::bayesian_nnetwork<> bnn;
+      ModelInfo info = t.info;
+
+      if(t.optimizer){
+	whiteice::nnetwork<> net;
+	whiteice::math::blas_real<float> error = 1000.0f;
+	unsigned int iters = 0;
+
+	if(t.optimizer->getSolution(net, error, iters) == false) return false;
+	if(bnn.importNetwork(net) == false) return false;
+
+	info.iterations = t.priorIterations + iters;
+	info.error = error.c[0];
+	info.hmcSamples = 0;
+      }
+      else if(t.sampler){
+	if(samplerNetwork(t, bnn) == false) return false;
+
+	info.hmcSamples = bnn.getNumberOfSamples();
+	if(info.hmcSamples == 0) return false;
+      }
+      else return false;
+
+      info.seconds = t.priorSeconds +
+	std::chrono::duration<float>(std::chrono::steady_clock::now() - t.started).count();
+
+      // model is written before its sidecar file
+      const std::string filename = ModelInfo::partial(t.filename);
+
+      if(bnn.save(filename) == false) return false;
+
+      return info.save(ModelInfo::sidecar(filename));
+    }
+
+
+    bool TrainingScheduler::saveTask(Task& t, whiteice::bayesian_nnetwork<>& bnn)
+    {
+      if(bnn.save(t.filename) == false) return false;
+
+      t.info.seconds = t.priorSeconds +
+	std::chrono::duration<float>(std::chrono::steady_clock::now() - t.started).count();
+
+      // snapshot of unfinished model is not needed anymore
+      const std::string partial = ModelInfo::partial(t.filename);
+      remove(ModelInfo::sidecar(partial).c_str());
+      remove(partial.c_str());
+
+      if(t.hasInfo == false)
+	return true;
+
+      // sidecar is written after the model so it never describes older model
+      if(t.info.save(ModelInfo::sidecar(t.filename)) == false)
+	return false;
+
+      {
+	std::lock_guard<std::mutex> lock(finished_mutex);
+	finished.push_back(std::make_pair(t.filename, t.info));
+      }
+
+      return true;
+    }
+
+
+    bool TrainingScheduler::getFinished(std::vector< std::pair<std::string, ModelInfo> >& models)
+    {
+      std::lock_guard<std::mutex> lock(finished_mutex);
+
+      models.clear();
+      std::swap(models, finished);
+
+      return models.size() > 0;
+    }
+
+
+    void TrainingScheduler::freeTask(Task& t)
+    {
+      if(t.optimizer){
+	t.optimizer->stopComputation();
+	delete t.optimizer;
+	t.optimizer = nullptr;
+      }
+
+      if(t.sampler){
+	t.sampler->stopSampler();
+	delete t.sampler;
+	t.sampler = nullptr;
+      }
+    }
+
+
+    void TrainingScheduler::scheduler_loop()
+    {
+      while(thread_running){
+	// fills free slots from the work queue
+	while(tasks.size() < concurrency && queue.size() > 0){
+	  Task* t = queue.front();
+	  queue.pop_front();
+
+	  if(t->start == DATA_ONLY){
+	    // old model would be used instead of data
+	    remove(t->filename.c_str());
+	    remove(ModelInfo::sidecar(t->filename).c_str());
+	  }
+
+	  if(t->start == UP_TO_DATE || t->start == DATA_ONLY){
+	    completed++;
+	    groupCompleted[t->group]++;
+	    delete t;
+	  }
+	  else if(startTask(*t)){
+	    tasks.push_back(t);
+	  }
+	  else{
+	    failed++;
+	    completed++;
+	    groupCompleted[t->group]++;
+	    delete t;
+	  }
+	}
+
+	active = tasks.size();
+
+	if(tasks.size() == 0 && queue.size() == 0)
+	  break; // all models have been trained
+
+	float partial = 0.0f;
+
+	for(unsigned int i=0;i<tasks.size();){
+	  float done = 0.0f;
+
+	  if(pollTask(*tasks[i], done)){
+	    // model was saved (or failed): slot is free
+	    completed++;
+	    groupCompleted[tasks[i]->group]++;
+
+	    freeTask(*tasks[i]);
+	    delete tasks[i];
+	    tasks.erase(tasks.begin() + i);
+	  }
+	  else{
+	    partial += done;
+
+	    // periodic snapshot of unfinished model for resuming stopped optimization
+	    const auto now = std::chrono::steady_clock::now();
+
+	    if(now - tasks[i]->snapshot >= std::chrono::seconds(SNAPSHOT_SECONDS)){
+	      snapshotTask(*tasks[i]);
+	      tasks[i]->snapshot = now;
+	    }
+
+	    i++;
+	  }
+	}
+
+	active = tasks.size();
+
+	if(total > 0)
+	  progress = (completed + partial)/(float)total;
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+      }
+
+      // stop() was called: saves snapshots of unfinished models (resumed later)
+      for(auto t : tasks){
+	snapshotTask(*t);
+	freeTask(*t);
+	delete t;
+      }
+
+      tasks.clear();
+      active = 0;
+
+      if(total > 0)
+	progress = completed/(float)total;
+
+      thread_running = false;
+    }
+
+  };
+};
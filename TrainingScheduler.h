@@ -0,0 +1,188 @@
+/*
+ * TrainingScheduler
+ *
+ * trains many prediction models at the same time. models are taken from
+ * a work queue and at most concurrency models are optimized at once
+ * (NNGradDescent<> and optionally UHMC<> sampling after it). each finished
+ * model is saved to its .model file immediately (and .modelinfo sidecar
+ * after it). models can be continued from the existing .model file (warm
+ * start) or skipped if they are up to date. unfinished models are
+ * saved periodically (and when stopped) to .partial.model files which
+ * are continued next time. scheduler thread polls the optimizers so the
+ * engine only needs to read progress
+ */
+
+#ifndef TrainingScheduler_h
+#define TrainingScheduler_h
+
+#include <dinrhiw/dinrhiw.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <utility>
+
+#include "ModelInfo.h"
+
+
+namespace whiteice {
+  namespace resonanz {
+
+    class TrainingScheduler
+    {
+    public:
+
+      static const unsigned int MAX_GROUPS = 8;
+
+      // model starts from random weights, continues from the saved .model
+      // file (random weights if it cannot be loaded) or is not trained at all.
+      // DATA_ONLY removes old model files (too little data: predictions use
+      // RBF estimate of the data instead of a neural network)
+      enum Start { RANDOM_START, WARM_START, UP_TO_DATE, DATA_ONLY };
+
+      // early stopping: optimization stops when error on held-out data hasn't
+      // improved more than MIN_IMPROVEMENT (relative) in PATIENCE iterations.
+      // iteration budget of a model is ITERATIONS_PER_SAMPLE*rows (at least
+      // MIN_ITERATIONS) but never more than iterations
+      static const unsigned int PATIENCE = 100;
+      static const unsigned int ITERATIONS_PER_SAMPLE = 10;
+      static const unsigned int MIN_ITERATIONS = 50;
+      static constexpr float MIN_IMPROVEMENT = 0.001f;
+
+      // iterations: maximum gradient descent iterations per model,
+      // bayesSamples: number of HMC samples per model (0 = no sampling)
+      TrainingScheduler(unsigned int concurrency,
+			unsigned int iterations,
+			unsigned int bayesSamples);
+
+      ~TrainingScheduler();
+
+      // adds model to the work queue (before start()). data must exist until
+      // scheduler has stopped. nn is the architecture of the model. group
+      // (< MAX_GROUPS) is user defined tag for getCompleted(). iterations
+      // overrides default number of iterations (0 = default, random start always
+      // uses default). info is saved to the sidecar file after the model
+      bool add(const whiteice::dataset<>& data,
+	       const whiteice::nnetwork<>& nn,
+	       const std::string& filename,
+	       unsigned int group = 0,
+	       Start start = RANDOM_START,
+	       unsigned int iterations = 0,
+	       const ModelInfo* info = nullptr);
+
+      bool start();
+
+      // scheduler thread runs until all models are trained or stop() is called
+      bool isRunning();
+
+      // stops training, unfinished models are saved to .partial.model files
+      // and continued by the next scheduler training the same models
+      bool stop();
+
+      // models finished (saved or failed) and models that could not be trained or saved
+      unsigned int getTotal() const { return total; }
+      unsigned int getCompleted() const { return completed; }
+      unsigned int getCompleted(unsigned int group) const;
+      unsigned int getFailed() const { return failed; }
+      unsigned int getActive() const { return active; }
+
+      // fraction of all work done [0,1] including partially trained models
+      float getProgress() const { return progress; }
+
+      // takes models saved since the last call (filename and data)
+      bool getFinished(std::vector< std::pair<std::string, ModelInfo> >& models);
+
+      // estimated time to finish all models in seconds (negative if unknown)
+      double getETA() const;
+
+    private:
+
+      struct Task
+      {
+	const whiteice::dataset<>* data = nullptr;
+	whiteice::nnetwork<> nn;
+	std::string filename;
+	unsigned int group = 0;
+
+	Start start = RANDOM_START;
+	unsigned int iterations = 0;
+	bool hasInfo = false;
+	ModelInfo info;
+
+	// early stopping
+	float bestError = 0.0f;
+	unsigned int bestIteration = 0;
+	std::chrono::steady_clock::time_point started, snapshot;
+
+	// resumed from snapshot of stopped optimization
+	unsigned int priorIterations = 0;
+	float priorSeconds = 0.0f;
+	std::vector< whiteice::math::vertex<> > priorSamples;
+
+	whiteice::math::NNGradDescent<>* optimizer = nullptr;
+	whiteice::UHMC<>* sampler = nullptr;
+      };
+
+      void scheduler_loop();
+
+      bool startTask(Task& t);
+
+      // loads weights of the latest sample of the saved model to t.nn
+      bool loadTask(Task& t, const std::string& filename,
+		    std::vector< whiteice::math::vertex<> >& weights);
+
+      // continues from snapshot of unfinished model (of the same data)
+      bool resumeTask(Task& t);
+
+      bool startSampler(Task& t);
+
+      // sampled network including samples from before resuming
+      bool samplerNetwork(Task& t, whiteice::bayesian_nnetwork<>& bnn);
+
+      // saves unfinished model to .partial.model file (and its sidecar)
+      bool snapshotTask(Task& t);
+
+      // returns true when task has finished (saved or failed)
+      bool pollTask(Task& t, float& done);
+
+      bool saveTask(Task& t, whiteice::bayesian_nnetwork<>& bnn);
+
+      // iteration budget sized to the dataset
+      unsigned int budget(const whiteice::dataset<>& data) const;
+
+      void freeTask(Task& t);
+
+      static const unsigned int POLL_MS = 100;
+      static const unsigned int SNAPSHOT_SECONDS = 60;
+
+      const unsigned int concurrency;
+      const unsigned int iterations;
+      const unsigned int bayesSamples;
+
+      std::mutex thread_mutex;
+      std::atomic<bool> thread_running { false };
+      std::thread* scheduler_thread = nullptr;
+
+      std::deque<Task*> queue;   // waiting models
+      std::vector<Task*> tasks;  // models being trained (scheduler thread only)
+
+      std::atomic<unsigned int> groupCompleted[MAX_GROUPS];
+
+      std::atomic<unsigned int> total { 0 }, completed { 0 }, failed { 0 }, active { 0 };
+      std::atomic<float> progress { 0.0f };
+
+      std::mutex finished_mutex;
+      std::vector< std::pair<std::string, ModelInfo> > finished;
+
+      std::chrono::steady_clock::time_point started;
+
+    };
+
+  };
+};
+
+
+#endif
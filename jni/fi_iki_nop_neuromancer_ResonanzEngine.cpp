@@ -405,6 +405,7 @@ JNIEXPORT jstring JNICALL Java_fi_iki_nop_neuromancer_ResonanzEngine_getLastExec
 {
 	try{
 		std::string line = engine.executedProgramStatistics();
+		line += engine.tickStatistics();
 
 		jstring result = env->NewStringUTF(line.c_str());
 
@@ -419,6 +419,7 @@ int main(int argc, char** argv)
 						   cmd.keywordsFile,
 						   cmd.modelDir);
 	  std::cout << msg << std::endl;
+	  std::cout << engine.tickStatistics() << std::endl;
 	}
 	else if(cmd.command == cmd.CMD_DO_OPTIMIZE){
 	  std::string msg = engine.analyzeModel(cmd.modelDir);
@@ -427,6 +428,7 @@ int main(int argc, char** argv)
 	else if(cmd.command == cmd.CMD_DO_EXECUTE){
 	  std::string msg = engine.executedProgramStatistics();
 	  std::cout << msg << std::endl;
+	  std::cout << engine.tickStatistics() << std::endl;
 	}
 
 
@@ -0,0 +1,356 @@
+/*
+ * testing measurement journal (torn records, commit and crash recovery)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <sys/stat.h>
+#include "MeasurementJournal.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace whiteice::resonanz;
+
+
+static const unsigned int E = 4; // EEG signals
+static const unsigned int P = 3; // synth parameters
+
+
+static MeasurementJournal::Record make_record(unsigned int n)
+{
+  MeasurementJournal::Record r;
+
+  r.picture = MeasurementJournal::hash("picture" + std::to_string(n));
+  r.keyword = 0;
+  r.hmmState = n;
+
+  for(unsigned int i=0;i<E;i++){
+    r.eegBefore.push_back(n + 0.1f*i);
+    r.eegAfter.push_back(n + 0.2f*i);
+  }
+
+  for(unsigned int i=0;i<P;i++){
+    r.synthBefore.push_back(n - 0.1f*i);
+    r.synthAfter.push_back(n - 0.2f*i);
+  }
+
+  return r;
+}
+
+
+static bool same_record(const MeasurementJournal::Record& a, const MeasurementJournal::Record& b)
+{
+  return (a.picture == b.picture && a.keyword == b.keyword && a.hmmState == b.hmmState &&
+	  a.eegBefore == b.eegBefore && a.eegAfter == b.eegAfter &&
+	  a.synthBefore == b.synthBefore && a.synthAfter == b.synthAfter);
+}
+
+
+static long file_size(const std::string& filename)
+{
+  FILE* handle = fopen(filename.c_str(), "rb");
+  if(handle == NULL) return -1;
+
+  fseek(handle, 0, SEEK_END);
+  const long bytes = ftell(handle);
+  fclose(handle);
+
+  return bytes;
+}
+
+
+static bool write_file(const std::string& filename, const char* contents)
+{
+  FILE* handle = fopen(filename.c_str(), "wt");
+  if(handle == NULL) return false;
+
+  fputs(contents, handle);
+
+  return (fclose(handle) == 0);
+}
+
+
+static std::string read_file(const std::string& filename)
+{
+  FILE* handle = fopen(filename.c_str(), "rt");
+  if(handle == NULL) return "";
+
+  char line[256] = { 0 };
+  if(fgets(line, sizeof(line), handle) == NULL) line[0] = 0;
+  fclose(handle);
+
+  return line;
+}
+
+
+int main(int argc, char** argv)
+{
+  const std::string journal = "journal_test.journal";
+  const std::string data1 = "journal_test.data1";
+  const std::string data2 = "journal_test.data2";
+
+  remove(journal.c_str());
+  remove(MeasurementJournal::markName(journal).c_str());
+
+
+  printf("TESTCASE1: torn final record is dropped.\n");
+
+  {
+    const unsigned int N = 5;
+
+    MeasurementJournal j;
+
+    if(j.open(journal, E, P) == false){
+      fprintf(stderr, "ERROR: cannot create journal.\n");
+      return -1;
+    }
+
+    for(unsigned int n=0;n<N;n++){
+      if(j.append(make_record(n)) == false){
+	fprintf(stderr, "ERROR: cannot append record.\n");
+	return -1;
+      }
+    }
+
+    j.close();
+
+    const long bytes = file_size(journal);
+
+    // crash in the middle of writing the next record
+    {
+      FILE* handle = fopen(journal.c_str(), "ab");
+      const unsigned char partial[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+      fwrite(partial, 1, sizeof(partial), handle);
+      fclose(handle);
+    }
+
+    std::vector<MeasurementJournal::Record> records;
+
+    if(MeasurementJournal::read(journal, E, P, records) == false || records.size() != N){
+      fprintf(stderr, "ERROR: read() returned %d records (%d expected).\n",
+	      (int)records.size(), N);
+      return -1;
+    }
+
+    for(unsigned int n=0;n<N;n++){
+      if(same_record(records[n], make_record(n)) == false){
+	fprintf(stderr, "ERROR: record %d is different from appended record.\n", n);
+	return -1;
+      }
+    }
+
+    // reopening removes torn record so new records follow the valid ones
+    if(j.open(journal, E, P) == false || j.getRecords() != N || file_size(journal) != bytes){
+      fprintf(stderr, "ERROR: open() didn't remove torn record.\n");
+      return -1;
+    }
+
+    j.append(make_record(N));
+    j.close();
+
+    if(MeasurementJournal::read(journal, E, P, records) == false || records.size() != N+1 ||
+       same_record(records[N], make_record(N)) == false){
+      fprintf(stderr, "ERROR: record appended after torn record was lost.\n");
+      return -1;
+    }
+
+    printf("torn record dropped.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE2: corrupted record stops replay.\n");
+
+  {
+    const long bytes = file_size(journal);
+
+    // flips a byte in the middle of the last record
+    {
+      FILE* handle = fopen(journal.c_str(), "r+b");
+      fseek(handle, bytes - 20, SEEK_SET);
+      const int c = fgetc(handle);
+      fseek(handle, bytes - 20, SEEK_SET);
+      fputc(c ^ 0xFF, handle);
+      fclose(handle);
+    }
+
+    std::vector<MeasurementJournal::Record> records;
+
+    if(MeasurementJournal::read(journal, E, P, records) == false || records.size() != 5){
+      fprintf(stderr, "ERROR: read() returned %d records after corruption.\n",
+	      (int)records.size());
+      return -1;
+    }
+
+    printf("corrupted record dropped.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE3: journal with different dimensions is not replayed.\n");
+
+  {
+    std::vector<MeasurementJournal::Record> records;
+
+    if(MeasurementJournal::read(journal, E+1, P, records)){
+      fprintf(stderr, "ERROR: journal was read with wrong dimensions.\n");
+      return -1;
+    }
+
+    MeasurementJournal j;
+
+    if(j.open(journal, E+1, P) == false || j.getRecords() != 0){
+      fprintf(stderr, "ERROR: journal with different dimensions was not replaced.\n");
+      return -1;
+    }
+
+    j.close();
+
+    const std::string bad = journal + ".bad";
+
+    if(file_size(bad) <= 0){
+      fprintf(stderr, "ERROR: journal with different dimensions was not kept.\n");
+      return -1;
+    }
+
+    remove(bad.c_str());
+    remove(journal.c_str());
+
+    printf("different dimensions ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE4: commit renames files and clears journal.\n");
+
+  {
+    MeasurementJournal j;
+
+    if(j.open(journal, E, P) == false){
+      fprintf(stderr, "ERROR: cannot create journal.\n");
+      return -1;
+    }
+
+    for(unsigned int n=0;n<3;n++)
+      j.append(make_record(n));
+
+    write_file(MeasurementJournal::newName(data1), "saved1\n");
+
+    if(j.commit({ data1 }) == false || j.getRecords() != 0){
+      fprintf(stderr, "ERROR: commit() FAILED.\n");
+      return -1;
+    }
+
+    if(read_file(data1) != "saved1\n" || file_size(MeasurementJournal::newName(data1)) >= 0 ||
+       file_size(MeasurementJournal::markName(journal)) >= 0){
+      fprintf(stderr, "ERROR: commit() didn't rename file or remove fold mark.\n");
+      return -1;
+    }
+
+    j.close();
+
+    std::vector<MeasurementJournal::Record> records;
+
+    if(MeasurementJournal::read(journal, E, P, records) == false || records.size() != 0){
+      fprintf(stderr, "ERROR: journal has records after commit.\n");
+      return -1;
+    }
+
+    printf("commit ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE5: recover() finishes interrupted commit.\n");
+
+  {
+    MeasurementJournal j;
+
+    if(j.open(journal, E, P) == false){
+      fprintf(stderr, "ERROR: cannot open journal.\n");
+      return -1;
+    }
+
+    for(unsigned int n=0;n<4;n++)
+      j.append(make_record(n));
+
+    write_file(MeasurementJournal::newName(data1), "saved2\n");
+    write_file(MeasurementJournal::newName(data2), "saved2\n");
+
+    // data2 is a non-empty directory so renaming data2.new fails after
+    // the fold mark has been written (like a crash in the middle of commit)
+#ifdef _WIN32
+    _mkdir(data2.c_str());
+#else
+    mkdir(data2.c_str(), 0700);
+#endif
+    const std::string blocker = data2 + "/file";
+    write_file(blocker, "x\n");
+
+    if(j.commit({ data1, data2 }) || j.getRecords() != 4){
+      fprintf(stderr, "ERROR: commit() didn't fail.\n");
+      return -1;
+    }
+
+    // records measured after saving are not in the saved files
+    j.append(make_record(100));
+    j.close();
+
+    remove(blocker.c_str());
+#ifdef _WIN32
+    _rmdir(data2.c_str());
+#else
+    rmdir(data2.c_str());
+#endif
+
+    if(MeasurementJournal::recover(journal) == false){
+      fprintf(stderr, "ERROR: recover() FAILED.\n");
+      return -1;
+    }
+
+    if(read_file(data1) != "saved2\n" || read_file(data2) != "saved2\n" ||
+       file_size(MeasurementJournal::newName(data2)) >= 0){
+      fprintf(stderr, "ERROR: recover() didn't rename saved files.\n");
+      return -1;
+    }
+
+    std::vector<MeasurementJournal::Record> records;
+
+    if(MeasurementJournal::read(journal, E, P, records) == false || records.size() != 1 ||
+       same_record(records[0], make_record(100)) == false){
+      fprintf(stderr, "ERROR: recover() kept %d records (1 expected).\n",
+	      (int)records.size());
+      return -1;
+    }
+
+    if(file_size(MeasurementJournal::markName(journal)) >= 0){
+      fprintf(stderr, "ERROR: recover() didn't remove fold mark.\n");
+      return -1;
+    }
+
+    // nothing to recover anymore
+    if(MeasurementJournal::recover(journal) == false ||
+       MeasurementJournal::read(journal, E, P, records) == false || records.size() != 1){
+      fprintf(stderr, "ERROR: second recover() changed journal.\n");
+      return -1;
+    }
+
+    printf("recovery ok.\n");
+    fflush(stdout);
+  }
+
+
+  remove(journal.c_str());
+  remove(data1.c_str());
+  remove(data2.c_str());
+
+  return 0;
+}
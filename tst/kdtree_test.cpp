@@ -0,0 +1,175 @@
+/*
+ * testing KD-tree nearest neighbour and radius search against brute force search
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "KDTree.h"
+
+using namespace whiteice::resonanz;
+
+
+// squared distances from x to all points in increasing order
+static void brute_force(const std::vector<float>& points, unsigned int dim,
+			const float* x, std::vector<float>& distances)
+{
+  const unsigned int N = points.size()/dim;
+  distances.resize(N);
+
+  for(unsigned int i=0;i<N;i++){
+    float d = 0.0f;
+    for(unsigned int j=0;j<dim;j++){
+      const float t = x[j] - points[i*dim + j];
+      d += t*t;
+    }
+    distances[i] = d;
+  }
+
+  std::sort(distances.begin(), distances.end());
+}
+
+
+int main(int argc, char** argv)
+{
+  srand(time(0));
+
+  const unsigned int N = 2000;
+  const unsigned int DIM = 6;
+
+  std::vector<float> points(N*DIM);
+
+  for(auto& p : points)
+    p = ((float)rand())/((float)RAND_MAX);
+
+  KDTree tree;
+
+  if(tree.build(points, DIM) == false || tree.size() != N || tree.dimension() != DIM){
+    fprintf(stderr, "ERROR: building KD-tree FAILED.\n");
+    return -1;
+  }
+
+
+  printf("TESTCASE1: exact k nearest neighbours against brute force search.\n");
+
+  {
+    const unsigned int K = 10;
+    std::vector<unsigned int> indices;
+    std::vector<float> distances, correct;
+
+    for(unsigned int t=0;t<100;t++){
+      float x[DIM];
+      for(unsigned int j=0;j<DIM;j++)
+	x[j] = ((float)rand())/((float)RAND_MAX);
+
+      if(tree.knearest(x, K, 0.0f, indices, distances) == false ||
+	 indices.size() != K || distances.size() != K){
+	fprintf(stderr, "ERROR: KDTree::knearest() FAILED.\n");
+	return -1;
+      }
+
+      brute_force(points, DIM, x, correct);
+
+      for(unsigned int i=0;i<K;i++){
+	if(fabs(distances[i] - correct[i]) > 1e-5f){
+	  fprintf(stderr, "ERROR: %d. nearest distance %f != %f (brute force)\n",
+		  i, distances[i], correct[i]);
+	  return -1;
+	}
+
+	// returned index must have the returned distance
+	float d = 0.0f;
+	for(unsigned int j=0;j<DIM;j++){
+	  const float e = x[j] - points[indices[i]*DIM + j];
+	  d += e*e;
+	}
+
+	if(fabs(d - distances[i]) > 1e-5f){
+	  fprintf(stderr, "ERROR: distance of returned point %d is wrong\n", indices[i]);
+	  return -1;
+	}
+      }
+    }
+
+    printf("knearest() matches brute force search.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE2: approximate k nearest neighbours are within (1+epsilon).\n");
+
+  {
+    const unsigned int K = 5;
+    const float epsilon = 0.5f;
+    std::vector<unsigned int> indices;
+    std::vector<float> distances, correct;
+
+    for(unsigned int t=0;t<100;t++){
+      float x[DIM];
+      for(unsigned int j=0;j<DIM;j++)
+	x[j] = ((float)rand())/((float)RAND_MAX);
+
+      if(tree.knearest(x, K, epsilon, indices, distances) == false || indices.size() != K){
+	fprintf(stderr, "ERROR: KDTree::knearest() FAILED.\n");
+	return -1;
+      }
+
+      brute_force(points, DIM, x, correct);
+
+      // distances are squared
+      const float limit = (1.0f + epsilon)*(1.0f + epsilon)*correct[K-1] + 1e-5f;
+
+      for(unsigned int i=0;i<K;i++){
+	if(distances[i] > limit){
+	  fprintf(stderr, "ERROR: approximate distance %f is larger than limit %f\n",
+		  distances[i], limit);
+	  return -1;
+	}
+      }
+    }
+
+    printf("approximate knearest() is within bounds.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE3: radius search against brute force search.\n");
+
+  {
+    const float r = 0.3f;
+    std::vector<unsigned int> indices;
+    std::vector<float> distances, correct;
+
+    for(unsigned int t=0;t<100;t++){
+      float x[DIM];
+      for(unsigned int j=0;j<DIM;j++)
+	x[j] = ((float)rand())/((float)RAND_MAX);
+
+      if(tree.radius(x, r, indices, distances) == false){
+	fprintf(stderr, "ERROR: KDTree::radius() FAILED.\n");
+	return -1;
+      }
+
+      brute_force(points, DIM, x, correct);
+
+      unsigned int inside = 0;
+      for(const auto& d : correct)
+	if(d <= r*r) inside++;
+
+      if(indices.size() != inside){
+	fprintf(stderr, "ERROR: radius() found %d points, brute force %d points\n",
+		(int)indices.size(), inside);
+	return -1;
+      }
+    }
+
+    printf("radius() matches brute force search.\n");
+    fflush(stdout);
+  }
+
+
+  return 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * testing prediction cache (quantization, hits and misses, LRU eviction)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include "PredictionCache.h"
+
+using namespace whiteice::resonanz;
+
+
+int main(int argc, char** argv)
+{
+  const unsigned int DIM = 3;
+
+  printf("TESTCASE1: cache is disabled by default.\n");
+
+  {
+    PredictionCache cache;
+    std::vector<int> key;
+    float m[DIM] = { 1.0f, 2.0f, 3.0f }, v[DIM] = { 0.1f, 0.2f, 0.3f };
+
+    cache.quantize(std::vector<float>(DIM, 0.5f), 0, key);
+    cache.insert(PredictionCache::PICTURE, 0, key, m, v, DIM);
+
+    if(cache.enabled() || cache.size() != 0 ||
+       cache.lookup(PredictionCache::PICTURE, 0, key, m, v, DIM)){
+      fprintf(stderr, "ERROR: disabled cache stores predictions.\n");
+      return -1;
+    }
+
+    printf("disabled cache is empty.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE2: quantization of EEG values and HMM state.\n");
+
+  {
+    PredictionCache cache(10, 0.1f);
+    std::vector<int> k1, k2, k3;
+
+    std::vector<float> eeg = { 0.52f, 0.30f, 0.71f };
+
+    cache.quantize(eeg, 1, k1);
+
+    eeg[0] = 0.53f; // same grid cell
+    cache.quantize(eeg, 1, k2);
+
+    if(k1 != k2){
+      fprintf(stderr, "ERROR: close EEG values have different keys.\n");
+      return -1;
+    }
+
+    cache.quantize(eeg, 2, k3);
+
+    if(k1 == k3){
+      fprintf(stderr, "ERROR: different HMM states have same keys.\n");
+      return -1;
+    }
+
+    eeg[0] = 0.62f; // next grid cell
+    cache.quantize(eeg, 1, k3);
+
+    if(k1 == k3){
+      fprintf(stderr, "ERROR: distant EEG values have same keys.\n");
+      return -1;
+    }
+
+    printf("quantization ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE3: hits and misses.\n");
+
+  {
+    PredictionCache cache(10);
+    std::vector<int> key;
+    float m[DIM] = { 1.0f, 2.0f, 3.0f }, v[DIM] = { 0.1f, 0.2f, 0.3f };
+    float mm[DIM], vv[DIM];
+
+    cache.quantize(std::vector<float>(DIM, 0.5f), 0, key);
+
+    if(cache.lookup(PredictionCache::KEYWORD, 5, key, mm, vv, DIM)){
+      fprintf(stderr, "ERROR: empty cache has a prediction.\n");
+      return -1;
+    }
+
+    cache.insert(PredictionCache::KEYWORD, 5, key, m, v, DIM);
+
+    if(cache.lookup(PredictionCache::KEYWORD, 5, key, mm, vv, DIM) == false){
+      fprintf(stderr, "ERROR: inserted prediction not found.\n");
+      return -1;
+    }
+
+    for(unsigned int i=0;i<DIM;i++){
+      if(mm[i] != m[i] || vv[i] != v[i]){
+	fprintf(stderr, "ERROR: cached prediction is different from inserted.\n");
+	return -1;
+      }
+    }
+
+    // same key but different stimulus or stimulus type
+    if(cache.lookup(PredictionCache::KEYWORD, 6, key, mm, vv, DIM) ||
+       cache.lookup(PredictionCache::PICTURE, 5, key, mm, vv, DIM)){
+      fprintf(stderr, "ERROR: prediction found for wrong stimulus.\n");
+      return -1;
+    }
+
+    if(cache.getHits() != 1 || cache.getMisses() != 3 ||
+       fabs(cache.getHitRate() - 0.25f) > 1e-6f){
+      fprintf(stderr, "ERROR: wrong hit statistics (%d hits, %d misses).\n",
+	      (int)cache.getHits(), (int)cache.getMisses());
+      return -1;
+    }
+
+    cache.clear();
+
+    if(cache.size() != 0 ||
+       cache.lookup(PredictionCache::KEYWORD, 5, key, mm, vv, DIM)){
+      fprintf(stderr, "ERROR: cleared cache has predictions.\n");
+      return -1;
+    }
+
+    printf("hits and misses ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE4: least recently used predictions are removed.\n");
+
+  {
+    const unsigned int CAPACITY = 5;
+    PredictionCache cache(CAPACITY);
+    std::vector<int> key;
+    float m[DIM] = { 1.0f, 2.0f, 3.0f }, v[DIM] = { 0.1f, 0.2f, 0.3f };
+
+    cache.quantize(std::vector<float>(DIM, 0.5f), 0, key);
+
+    for(unsigned int s=0;s<CAPACITY;s++)
+      cache.insert(PredictionCache::PICTURE, s, key, m, v, DIM);
+
+    // stimulus 0 is now most recently used and stimulus 1 the least
+    if(cache.lookup(PredictionCache::PICTURE, 0, key, m, v, DIM) == false){
+      fprintf(stderr, "ERROR: inserted prediction not found.\n");
+      return -1;
+    }
+
+    cache.insert(PredictionCache::PICTURE, CAPACITY, key, m, v, DIM);
+
+    if(cache.size() != CAPACITY){
+      fprintf(stderr, "ERROR: cache has %d predictions (capacity %d).\n",
+	      cache.size(), CAPACITY);
+      return -1;
+    }
+
+    if(cache.lookup(PredictionCache::PICTURE, 1, key, m, v, DIM)){
+      fprintf(stderr, "ERROR: least recently used prediction was not removed.\n");
+      return -1;
+    }
+
+    for(unsigned int s=0;s<=CAPACITY;s++){
+      if(s == 1) continue;
+
+      if(cache.lookup(PredictionCache::PICTURE, s, key, m, v, DIM) == false){
+	fprintf(stderr, "ERROR: prediction of stimulus %d was removed.\n", s);
+	return -1;
+      }
+    }
+
+    cache.setCapacity(2);
+
+    if(cache.size() != 2){
+      fprintf(stderr, "ERROR: cache has %d predictions after reducing capacity.\n",
+	      cache.size());
+      return -1;
+    }
+
+    printf("LRU eviction ok.\n");
+    fflush(stdout);
+  }
+
+
+  return 0;
+}
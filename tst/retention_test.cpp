@@ -0,0 +1,293 @@
+/*
+ * testing EEG stream retention policies (rows selected by each policy)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include "EEGRetention.h"
+
+using namespace whiteice::resonanz;
+
+
+// kept rows must be ascending row indices of the stream
+static bool ascending(const std::vector<unsigned int>& keep, unsigned int N)
+{
+  for(unsigned int i=0;i<keep.size();i++){
+    if(keep[i] >= N) return false;
+    if(i > 0 && keep[i-1] >= keep[i]) return false;
+  }
+
+  return true;
+}
+
+
+int main(int argc, char** argv)
+{
+  printf("TESTCASE1: policy parameters.\n");
+
+  {
+    EEGRetention r;
+    EEGRetention::Policy p;
+
+    if(r.setPolicy(EEGRetention::MAX_ROWS, 0, 0.0) ||
+       r.setPolicy(EEGRetention::DECAYED_RESERVOIR, 100, -1.0) ||
+       r.setPolicy(EEGRetention::KEEP_ALL, 0, 0.0) == false){
+      fprintf(stderr, "ERROR: wrong policy parameters accepted.\n");
+      return -1;
+    }
+
+    if(EEGRetention::parsePolicy("all", p) == false || p != EEGRetention::KEEP_ALL ||
+       EEGRetention::parsePolicy("max-rows", p) == false || p != EEGRetention::MAX_ROWS ||
+       EEGRetention::parsePolicy("reservoir", p) == false || p != EEGRetention::DECAYED_RESERVOIR ||
+       EEGRetention::parsePolicy("sessions", p) == false || p != EEGRetention::SESSION_STRATIFIED ||
+       EEGRetention::parsePolicy("unknown", p)){
+      fprintf(stderr, "ERROR: parsing policy names FAILED.\n");
+      return -1;
+    }
+
+    printf("policy parameters ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE2: KEEP_ALL policy keeps all rows.\n");
+
+  {
+    EEGRetention r;
+    std::vector<unsigned int> keep;
+
+    r.setPolicy(EEGRetention::KEEP_ALL, 0, 0.0);
+    r.reset(1000);
+
+    for(unsigned int n=0;n<1000;n++)
+      r.add();
+
+    if(r.needsCompaction() || r.select(keep) || r.size() != 2000){
+      fprintf(stderr, "ERROR: KEEP_ALL policy removed rows.\n");
+      return -1;
+    }
+
+    printf("KEEP_ALL ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE3: MAX_ROWS policy keeps the latest rows.\n");
+
+  {
+    const unsigned int MAXROWS = 100;
+    EEGRetention r;
+    std::vector<unsigned int> keep;
+
+    r.setPolicy(EEGRetention::MAX_ROWS, MAXROWS, 0.0);
+    r.reset(0);
+
+    // compaction only after stream has grown 10% over the limit
+    for(unsigned int n=0;n<MAXROWS + MAXROWS/10;n++)
+      r.add();
+
+    if(r.needsCompaction()){
+      fprintf(stderr, "ERROR: compaction needed before stream has grown enough.\n");
+      return -1;
+    }
+
+    r.add();
+
+    const unsigned int N = r.size();
+
+    if(r.needsCompaction() == false){
+      fprintf(stderr, "ERROR: compaction not needed after stream has grown over limit.\n");
+      return -1;
+    }
+
+    if(r.select(keep) == false || keep.size() != MAXROWS || r.size() != MAXROWS ||
+       ascending(keep, N) == false || keep[0] != N - MAXROWS){
+      fprintf(stderr, "ERROR: MAX_ROWS kept %d rows starting from %d.\n",
+	      (int)keep.size(), keep.size() ? keep[0] : 0);
+      return -1;
+    }
+
+    if(r.needsCompaction() || r.select(keep)){
+      fprintf(stderr, "ERROR: rows removed from compacted stream.\n");
+      return -1;
+    }
+
+    printf("MAX_ROWS ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE4: DECAYED_RESERVOIR policy keeps a sample of rows.\n");
+
+  {
+    const unsigned int MAXROWS = 200;
+    EEGRetention r;
+    std::vector<unsigned int> keep;
+
+    r.setPolicy(EEGRetention::DECAYED_RESERVOIR, MAXROWS, 0.0);
+    r.reset(1000);
+
+    for(unsigned int n=0;n<1000;n++)
+      r.add();
+
+    if(r.select(keep) == false || keep.size() != MAXROWS || r.size() != MAXROWS ||
+       ascending(keep, 2000) == false){
+      fprintf(stderr, "ERROR: DECAYED_RESERVOIR kept %d rows.\n", (int)keep.size());
+      return -1;
+    }
+
+    // without decay both halves of the stream are sampled
+    unsigned int old = 0;
+    for(const auto& k : keep)
+      if(k < 1000) old++;
+
+    if(old < MAXROWS/4 || old > 3*MAXROWS/4){
+      fprintf(stderr, "ERROR: DECAYED_RESERVOIR kept %d of %d old rows without decay.\n",
+	      old, MAXROWS);
+      return -1;
+    }
+
+    printf("DECAYED_RESERVOIR ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE5: DECAYED_RESERVOIR policy keeps less old rows.\n");
+
+  {
+    const unsigned int N = 1000;
+    const unsigned int MAXROWS = 200;
+    const double halfLife = 3600.0;
+    const std::string filename = "retention_test.retention";
+
+    // retention file with N rows 10 half-lifes old and N new rows
+    {
+      FILE* handle = fopen(filename.c_str(), "wb");
+      const char magic[8] = { 'R','Z','R','E','T','N','T','1' };
+      const unsigned int session = 0;
+      const unsigned long long rows = 2*N;
+      const double now = (double)time(0);
+
+      fwrite(magic, 1, sizeof(magic), handle);
+      fwrite(&session, sizeof(session), 1, handle);
+      fwrite(&rows, sizeof(rows), 1, handle);
+
+      for(unsigned int n=0;n<2*N;n++){
+	const double t = (n < N) ? now - 10.0*halfLife : now;
+	const float key = ((n % N) + 0.5f)/N;
+
+	fwrite(&t, sizeof(t), 1, handle);
+	fwrite(&session, sizeof(session), 1, handle);
+	fwrite(&key, sizeof(key), 1, handle);
+      }
+
+      fclose(handle);
+    }
+
+    EEGRetention r;
+    std::vector<unsigned int> keep;
+
+    r.setPolicy(EEGRetention::DECAYED_RESERVOIR, MAXROWS, halfLife);
+
+    if(r.load(filename) == false || r.size() != 2*N){
+      fprintf(stderr, "ERROR: cannot load retention file.\n");
+      return -1;
+    }
+
+    remove(filename.c_str());
+
+    if(r.select(keep) == false || keep.size() != MAXROWS){
+      fprintf(stderr, "ERROR: DECAYED_RESERVOIR kept %d rows.\n", (int)keep.size());
+      return -1;
+    }
+
+    unsigned int old = 0;
+    for(const auto& k : keep)
+      if(k < N) old++;
+
+    // weight of old rows is 2^-10
+    if(old > MAXROWS/20){
+      fprintf(stderr, "ERROR: DECAYED_RESERVOIR kept %d of %d old rows.\n", old, MAXROWS);
+      return -1;
+    }
+
+    printf("DECAYED_RESERVOIR decay ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE6: SESSION_STRATIFIED policy gives equal share to sessions.\n");
+
+  {
+    const unsigned int MAXROWS = 300;
+    EEGRetention r;
+    std::vector<unsigned int> keep;
+
+    r.setPolicy(EEGRetention::SESSION_STRATIFIED, MAXROWS, 0.0);
+
+    // sessions with 10, 500 and 90 rows
+    r.reset(10);
+
+    r.startSession();
+    for(unsigned int n=0;n<500;n++)
+      r.add();
+
+    r.startSession();
+    for(unsigned int n=0;n<90;n++)
+      r.add();
+
+    if(r.select(keep) == false || keep.size() != MAXROWS || r.size() != MAXROWS ||
+       ascending(keep, 600) == false){
+      fprintf(stderr, "ERROR: SESSION_STRATIFIED kept %d rows.\n", (int)keep.size());
+      return -1;
+    }
+
+    // small sessions keep all rows and the large session gets the rest
+    unsigned int counts[3] = { 0, 0, 0 };
+
+    for(const auto& k : keep){
+      if(k < 10) counts[0]++;
+      else if(k < 510) counts[1]++;
+      else counts[2]++;
+    }
+
+    if(counts[0] != 10 || counts[1] != 200 || counts[2] != 90){
+      fprintf(stderr, "ERROR: SESSION_STRATIFIED kept %d %d %d rows of sessions.\n",
+	      counts[0], counts[1], counts[2]);
+      return -1;
+    }
+
+    // two large sessions share rows equally
+    for(unsigned int n=0;n<400;n++)
+      r.add();
+
+    if(r.select(keep) == false || keep.size() != MAXROWS){
+      fprintf(stderr, "ERROR: SESSION_STRATIFIED kept %d rows.\n", (int)keep.size());
+      return -1;
+    }
+
+    counts[0] = counts[1] = counts[2] = 0;
+
+    for(const auto& k : keep){
+      if(k < 10) counts[0]++;
+      else if(k < 210) counts[1]++;
+      else counts[2]++;
+    }
+
+    if(counts[0] != 10 || counts[1] != 145 || counts[2] != 145){
+      fprintf(stderr, "ERROR: SESSION_STRATIFIED kept %d %d %d rows of sessions.\n",
+	      counts[0], counts[1], counts[2]);
+      return -1;
+    }
+
+    printf("SESSION_STRATIFIED ok.\n");
+    fflush(stdout);
+  }
+
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * testing sample ring buffer (overwriting, reader cursors and waiting)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include "SampleRing.h"
+
+using namespace whiteice::resonanz;
+
+
+int main(int argc, char** argv)
+{
+  typedef SampleRing::clock clock;
+
+  const unsigned int DIM = 3;
+  const unsigned int CAPACITY = 4;
+
+  printf("TESTCASE1: reading samples with cursor.\n");
+
+  {
+    SampleRing ring(DIM, CAPACITY);
+    unsigned long long cursor = ring.getCursor();
+    const auto t0 = clock::now();
+
+    if(ring.push(t0, std::vector<float>(DIM + 1, 0.0f))){
+      fprintf(stderr, "ERROR: sample with wrong dimension was accepted.\n");
+      return -1;
+    }
+
+    for(unsigned int n=0;n<3;n++)
+      ring.push(t0 + std::chrono::milliseconds(n), std::vector<float>(DIM, (float)n));
+
+    std::vector<clock::time_point> t;
+    std::vector< std::vector<float> > x;
+
+    if(ring.readSince(cursor, t, x) != 3 || cursor != 3 || t.size() != 3 || x.size() != 3){
+      fprintf(stderr, "ERROR: readSince() didn't return all samples.\n");
+      return -1;
+    }
+
+    for(unsigned int n=0;n<3;n++){
+      if(t[n] != t0 + std::chrono::milliseconds(n) || x[n] != std::vector<float>(DIM, (float)n)){
+	fprintf(stderr, "ERROR: sample %d is different from pushed sample.\n", n);
+	return -1;
+      }
+    }
+
+    // cursor is at head: nothing new to read
+    if(ring.readSince(cursor, t, x) != 0 || cursor != 3){
+      fprintf(stderr, "ERROR: readSince() returned already read samples.\n");
+      return -1;
+    }
+
+    printf("reading with cursor ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE2: overwritten samples are skipped.\n");
+
+  {
+    SampleRing ring(DIM, CAPACITY);
+    unsigned long long cursor = ring.getCursor();
+    const unsigned int N = 10;
+
+    for(unsigned int n=0;n<N;n++)
+      ring.push(clock::now(), std::vector<float>(DIM, (float)n));
+
+    std::vector<clock::time_point> t;
+    std::vector< std::vector<float> > x;
+
+    // only the latest CAPACITY samples are still in the ring
+    if(ring.readSince(cursor, t, x) != CAPACITY || cursor != N){
+      fprintf(stderr, "ERROR: readSince() returned %d samples (cursor %d).\n",
+	      (int)x.size(), (int)cursor);
+      return -1;
+    }
+
+    for(unsigned int i=0;i<CAPACITY;i++){
+      if(x[i][0] != (float)(N - CAPACITY + i)){
+	fprintf(stderr, "ERROR: wrong sample after overwrite (%f).\n", x[i][0]);
+	return -1;
+      }
+    }
+
+    printf("overwritten samples skipped.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE3: waiting for samples.\n");
+
+  {
+    SampleRing ring(DIM, CAPACITY);
+    const unsigned long long cursor = ring.getCursor();
+
+    const auto start = clock::now();
+
+    if(ring.waitForSample(cursor, start + std::chrono::milliseconds(20))){
+      fprintf(stderr, "ERROR: waitForSample() returned a sample that doesn't exist.\n");
+      return -1;
+    }
+
+    if(clock::now() - start < std::chrono::milliseconds(20)){
+      fprintf(stderr, "ERROR: waitForSample() returned before deadline.\n");
+      return -1;
+    }
+
+    std::thread producer([&ring](){
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	ring.push(clock::now(), std::vector<float>(DIM, 1.0f));
+      });
+
+    const bool ok = ring.waitForSample(cursor, clock::now() + std::chrono::seconds(5));
+
+    producer.join();
+
+    if(ok == false || ring.getCursor() != cursor + 1){
+      fprintf(stderr, "ERROR: waitForSample() didn't see pushed sample.\n");
+      return -1;
+    }
+
+    printf("waiting ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE4: concurrent reader gets only complete samples in order.\n");
+
+  {
+    SampleRing ring(DIM, CAPACITY);
+    const unsigned int N = 200000;
+
+    std::thread producer([&ring, N](){
+	for(unsigned int n=0;n<N;n++)
+	  ring.push(clock::now(), std::vector<float>(DIM, (float)n));
+      });
+
+    unsigned long long cursor = 0;
+    float previous = -1.0f;
+    bool ok = true;
+
+    while(cursor < N && ok){
+      std::vector<clock::time_point> t;
+      std::vector< std::vector<float> > x;
+
+      ring.readSince(cursor, t, x);
+
+      for(const auto& xi : x){
+	for(unsigned int i=1;i<DIM;i++)
+	  if(xi[i] != xi[0]) ok = false; // torn sample
+
+	if(xi[0] <= previous) ok = false;
+	previous = xi[0];
+      }
+    }
+
+    producer.join();
+
+    if(ok == false){
+      fprintf(stderr, "ERROR: reader got torn or out of order samples.\n");
+      return -1;
+    }
+
+    printf("concurrent reading ok.\n");
+    fflush(stdout);
+  }
+
+
+  return 0;
+}
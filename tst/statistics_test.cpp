@@ -0,0 +1,191 @@
+/*
+ * testing running (Welford) statistics against two-pass computation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include <string>
+#include "RunningStatistics.h"
+
+using namespace whiteice::resonanz;
+
+
+int main(int argc, char** argv)
+{
+  srand(time(0));
+
+  printf("TESTCASE1: mean and variance against two-pass computation.\n");
+
+  {
+    const unsigned int N = 10000;
+    const unsigned int DIM = 5;
+
+    RunningStatistics stats(DIM);
+    std::vector< std::vector<float> > data;
+
+    for(unsigned int n=0;n<N;n++){
+      std::vector<float> x(DIM);
+
+      // large offset compared to variance tests numerical stability
+      for(unsigned int i=0;i<DIM;i++)
+	x[i] = 1000.0f*i + (i+1)*((float)rand())/((float)RAND_MAX);
+
+      data.push_back(x);
+
+      if(stats.add(x) == false){
+	fprintf(stderr, "ERROR: RunningStatistics::add() FAILED.\n");
+	return -1;
+      }
+    }
+
+    if(stats.add(std::vector<float>(DIM+1)) || stats.count() != N){
+      fprintf(stderr, "ERROR: vector with wrong dimension was added.\n");
+      return -1;
+    }
+
+    for(unsigned int i=0;i<DIM;i++){
+      double mean = 0.0, var = 0.0;
+
+      for(unsigned int n=0;n<N;n++)
+	mean += data[n][i];
+      mean /= N;
+
+      for(unsigned int n=0;n<N;n++)
+	var += (data[n][i] - mean)*(data[n][i] - mean);
+      var /= (N - 1);
+
+      if(fabs(stats.mean(i) - mean) > 1e-6*(1.0 + fabs(mean)) ||
+	 fabs(stats.variance(i) - var) > 1e-4*var){
+	fprintf(stderr, "ERROR: statistics (%f %f) != two-pass statistics (%f %f)\n",
+		stats.mean(i), stats.variance(i), mean, var);
+	return -1;
+      }
+    }
+
+    printf("Welford statistics match two-pass statistics.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE2: changed() detects moved statistics.\n");
+
+  {
+    const unsigned int DIM = 2;
+
+    RunningStatistics stats(DIM, true), nocov(DIM, false);
+
+    if(stats.changed(0.1f) == false){
+      fprintf(stderr, "ERROR: statistics without reference are not changed.\n");
+      return -1;
+    }
+
+    // perfectly correlated values with zero mean and unit variance
+    for(unsigned int n=0;n<1000;n++){
+      const float s = (n & 1) ? 1.0f : -1.0f;
+      stats.add(std::vector<float>{ s, s });
+      nocov.add(std::vector<float>{ s, s });
+    }
+
+    stats.mark();
+    nocov.mark();
+
+    if(stats.changed(0.1f) || nocov.changed(0.1f)){
+      fprintf(stderr, "ERROR: statistics changed without new values.\n");
+      return -1;
+    }
+
+    // anticorrelated values: same mean and variance, different covariance
+    for(unsigned int n=0;n<1000;n++){
+      const float s = (n & 1) ? 1.0f : -1.0f;
+      stats.add(std::vector<float>{ s, -s });
+      nocov.add(std::vector<float>{ s, -s });
+    }
+
+    if(nocov.changed(0.1f)){
+      fprintf(stderr, "ERROR: mean and variance changed.\n");
+      return -1;
+    }
+
+    if(stats.changed(0.1f) == false){
+      fprintf(stderr, "ERROR: changed covariance was not detected.\n");
+      return -1;
+    }
+
+    // mean moves by more than tolerance*stdev
+    for(unsigned int n=0;n<1000;n++)
+      nocov.add(std::vector<float>{ 1.0f, 1.0f });
+
+    if(nocov.changed(0.1f) == false){
+      fprintf(stderr, "ERROR: changed mean was not detected.\n");
+      return -1;
+    }
+
+    printf("changed() ok.\n");
+    fflush(stdout);
+  }
+
+
+  printf("TESTCASE3: saving and loading statistics.\n");
+
+  {
+    std::map<std::string, RunningStatistics> stats, loaded;
+
+    stats["a"] = RunningStatistics(3, false);
+    stats["b"] = RunningStatistics(2, true);
+
+    for(unsigned int n=0;n<100;n++){
+      const float r = ((float)rand())/((float)RAND_MAX);
+      stats["a"].add(std::vector<float>{ r, 2*r, 3*r });
+      stats["b"].add(std::vector<float>{ r, -r });
+    }
+
+    stats["b"].mark();
+
+    const std::string filename = "statistics_test.stats";
+
+    if(RunningStatistics::save(filename, stats) == false ||
+       RunningStatistics::load(filename, loaded) == false){
+      fprintf(stderr, "ERROR: cannot save and load statistics.\n");
+      return -1;
+    }
+
+    remove(filename.c_str());
+
+    if(loaded.size() != 2 || loaded.count("a") == 0 || loaded.count("b") == 0){
+      fprintf(stderr, "ERROR: loaded statistics are missing.\n");
+      return -1;
+    }
+
+    for(auto& s : stats){
+      const RunningStatistics& l = loaded[s.first];
+
+      if(l.dimension() != s.second.dimension() || l.count() != s.second.count() ||
+	 l.hasCovariance() != s.second.hasCovariance()){
+	fprintf(stderr, "ERROR: loaded statistics are different.\n");
+	return -1;
+      }
+
+      for(unsigned int i=0;i<l.dimension();i++){
+	if(l.mean(i) != s.second.mean(i) || l.variance(i) != s.second.variance(i)){
+	  fprintf(stderr, "ERROR: loaded statistics are different.\n");
+	  return -1;
+	}
+      }
+    }
+
+    if(loaded["a"].changed(0.1f) == false || loaded["b"].changed(0.1f)){
+      fprintf(stderr, "ERROR: reference statistics were not loaded.\n");
+      return -1;
+    }
+
+    printf("saving and loading ok.\n");
+    fflush(stdout);
+  }
+
+
+  return 0;
+}